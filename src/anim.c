@@ -28,49 +28,46 @@ void AnimateTiles(void) {
         return;
     }
 
-    /* Scan the entire map for tiles with the ANIMBIT set */
-    for (y = 0; y < WORLD_Y; y++) {
-        for (x = 0; x < WORLD_X; x++) {
-            tilevalue = Map[y][x];
-
-            /* Only process tiles with the animation bit set */
-            if (tilevalue & ANIMBIT) {
-                tileflags = tilevalue & MASKBITS; /* Save the flags */
-                tilevalue &= LOMASK;              /* Extract base tile value */
-
-                /* Debug animation (once every 100 frames) */
-                if (debugCount == 0) {
-                    /* Check for known animation types to debug them */
-                    if (tilevalue >= TELEBASE && tilevalue <= TELELAST) {
-                        char debugMsg[256];
-                        wsprintf(debugMsg, "ANIMATION: Industrial smoke at (%d,%d) frame %d\n", 
-                                 x, y, tilevalue);
-                        OutputDebugString(debugMsg);
-                    } else if (tilevalue == NUCLEAR_SWIRL) {
-                        char debugMsg[256];
-                        wsprintf(debugMsg, "ANIMATION: Nuclear reactor at (%d,%d)\n", x, y);
-                        OutputDebugString(debugMsg);
-                    } else if (tilevalue >= RADAR0 && tilevalue <= RADAR7) {
-                        char debugMsg[256];
-                        wsprintf(debugMsg, "ANIMATION: Airport radar animation at (%d,%d)\n", x, y);
-                        OutputDebugString(debugMsg);
-                    } else if (tilevalue == FOOTBALLGAME1 || tilevalue == FOOTBALLGAME2) {
-                        char debugMsg[256];
-                        wsprintf(debugMsg, "ANIMATION: Stadium game at (%d,%d)\n", x, y);
-                        OutputDebugString(debugMsg);
-                    }
-                }
+    /* Visit only the tiles on the animation plane */
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(TilePlanes[TILE_PLANE_ANIM], &x, &y)) {
+        tilevalue = Map[y][x];
+        tileflags = tilevalue & MASKBITS; /* Save the flags */
+        tilevalue &= LOMASK;              /* Extract base tile value */
+
+        /* Debug animation (once every 100 frames) */
+        if (debugCount == 0) {
+            /* Check for known animation types to debug them */
+            if (tilevalue >= TELEBASE && tilevalue <= TELELAST) {
+                char debugMsg[256];
+                wsprintf(debugMsg, "ANIMATION: Industrial smoke at (%d,%d) frame %d\n", 
+                         x, y, tilevalue);
+                OutputDebugString(debugMsg);
+            } else if (tilevalue == NUCLEAR_SWIRL) {
+                char debugMsg[256];
+                wsprintf(debugMsg, "ANIMATION: Nuclear reactor at (%d,%d)\n", x, y);
+                OutputDebugString(debugMsg);
+            } else if (tilevalue >= RADAR0 && tilevalue <= RADAR7) {
+                char debugMsg[256];
+                wsprintf(debugMsg, "ANIMATION: Airport radar animation at (%d,%d)\n", x, y);
+                OutputDebugString(debugMsg);
+            } else if (tilevalue == FOOTBALLGAME1 || tilevalue == FOOTBALLGAME2) {
+                char debugMsg[256];
+                wsprintf(debugMsg, "ANIMATION: Stadium game at (%d,%d)\n", x, y);
+                OutputDebugString(debugMsg);
+            }
+        }
 
-                /* Look up the next animation frame */
-                tilevalue = aniTile[tilevalue];
+        /* Look up the next animation frame */
+        tilevalue = aniTile[tilevalue];
 
-                /* Reapply the flags */
-                tilevalue |= tileflags;
+        /* Reapply the flags */
+        tilevalue |= tileflags;
 
-                /* Update the map with the new tile */
-                Map[y][x] = tilevalue;
-            }
-        }
+        /* Update the map with the new tile */
+        SetTile(x, y, tilevalue);
+        x++;
     }
     
     /* Increment debug counter and wrap around */
@@ -118,16 +115,16 @@ void SetSmoke(int x, int y) {
                 /* Set the appropriate smoke tile with animation */
                 switch (i) {
                 case 0:
-                    Map[yy][xx] = COALSMOKE1 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT;
+                    SetTile(xx, yy, COALSMOKE1 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT);
                     break;
                 case 1:
-                    Map[yy][xx] = COALSMOKE2 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT;
+                    SetTile(xx, yy, COALSMOKE2 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT);
                     break;
                 case 2:
-                    Map[yy][xx] = COALSMOKE3 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT;
+                    SetTile(xx, yy, COALSMOKE3 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT);
                     break;
                 case 3:
-                    Map[yy][xx] = COALSMOKE4 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT;
+                    SetTile(xx, yy, COALSMOKE4 | ANIMBIT | CONDBIT | POWERBIT | BURNBIT);
                     break;
                 }
             }
@@ -187,7 +184,7 @@ static void DoIndustrialSmoke(int x, int y) {
                 }
 
                 /* Set the smoke animation */
-                Map[yy][xx] = smokeTile | ANIMBIT | CONDBIT | POWERBIT | BURNBIT;
+                SetTile(xx, yy, smokeTile | ANIMBIT | CONDBIT | POWERBIT | BURNBIT);
             }
         }
     }
@@ -216,11 +213,11 @@ static void DoStadiumAnimation(int x, int y) {
         /* Make sure the position is valid */
         if (centerX >= 0 && centerX < WORLD_X && centerY >= 0 && centerY < WORLD_Y) {
             /* Set up the football game animation */
-            Map[centerY][centerX] = FOOTBALLGAME1 | ANIMBIT | CONDBIT | BURNBIT;
+            SetTile(centerX, centerY, FOOTBALLGAME1 | ANIMBIT | CONDBIT | BURNBIT);
             
             /* Set up the second part of the football game animation */
             if (centerY+1 >= 0 && centerY+1 < WORLD_Y) {
-                Map[centerY+1][centerX] = FOOTBALLGAME2 | ANIMBIT | CONDBIT | BURNBIT;
+                SetTile(centerX, centerY+1, FOOTBALLGAME2 | ANIMBIT | CONDBIT | BURNBIT);
             }
         }
     }
@@ -236,14 +233,14 @@ static void DoStadiumAnimation(int x, int y) {
             
             /* If we find football game tiles, revert them */
             if (tileValue >= FOOTBALLGAME1 && tileValue <= FOOTBALLGAME1 + 16) {
-                Map[centerY][centerX] &= ~ANIMBIT;
+                SetTile(centerX, centerY, Map[centerY][centerX] & ~ANIMBIT);
             }
             
             if (centerY+1 >= 0 && centerY+1 < WORLD_Y) {
                 tileValue = Map[centerY+1][centerX] & LOMASK;
                 
                 if (tileValue >= FOOTBALLGAME2 && tileValue <= FOOTBALLGAME2 + 16) {
-                    Map[centerY+1][centerX] &= ~ANIMBIT;
+                    SetTile(centerX, centerY+1, Map[centerY+1][centerX] & ~ANIMBIT);
                 }
             }
         }
@@ -259,7 +256,7 @@ void UpdateFire(int x, int y) {
 
     /* Set fire tiles to animate */
     if ((Map[y][x] & LOMASK) >= FIREBASE && (Map[y][x] & LOMASK) <= (FIREBASE + 7)) {
-        Map[y][x] |= ANIMBIT;
+        SetTile(x, y, Map[y][x] | ANIMBIT);
     }
 }
 
@@ -280,7 +277,7 @@ void UpdateNuclearPower(int x, int y) {
 
         if (xx >= 0 && xx < WORLD_X && yy >= 0 && yy < WORLD_Y) {
             /* Set the nuclear swirl animation bit with appropriate flags */
-            Map[yy][xx] = NUCLEAR_SWIRL | ANIMBIT | CONDBIT | POWERBIT | BURNBIT;
+            SetTile(xx, yy, NUCLEAR_SWIRL | ANIMBIT | CONDBIT | POWERBIT | BURNBIT);
         }
     }
 }
@@ -302,7 +299,7 @@ void UpdateAirportRadar(int x, int y) {
 
         if (xx >= 0 && xx < WORLD_X && yy >= 0 && yy < WORLD_Y) {
             /* Set the radar animation bit with appropriate flags */
-            Map[yy][xx] = RADAR0 | ANIMBIT | CONDBIT | BURNBIT;
+            SetTile(xx, yy, RADAR0 | ANIMBIT | CONDBIT | BURNBIT);
         }
     }
 }
@@ -317,35 +314,36 @@ void UpdateSpecialAnimations(void) {
         return;
     }
 
-    /* Scan entire map for special animations */
-    for (y = 0; y < WORLD_Y; y++) {
-        for (x = 0; x < WORLD_X; x++) {
-            tileValue = Map[y][x] & LOMASK;
+    /* Every special animation belongs to a zone centre */
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(TilePlanes[TILE_PLANE_ZONE], &x, &y)) {
+        tileValue = Map[y][x] & LOMASK;
 
-            /* Add smoke to power plants */
-            if (tileValue == POWERPLANT && (Map[y][x] & ZONEBIT)) {
-                SetSmoke(x, y);
-            }
+        /* Add smoke to power plants */
+        if (tileValue == POWERPLANT) {
+            SetSmoke(x, y);
+        }
 
-            /* Add smoke to industrial buildings */
-            if (tileValue >= INDBASE && tileValue <= LASTIND && (Map[y][x] & ZONEBIT)) {
-                DoIndustrialSmoke(x, y);
-            }
+        /* Add smoke to industrial buildings */
+        if (tileValue >= INDBASE && tileValue <= LASTIND) {
+            DoIndustrialSmoke(x, y);
+        }
 
-            /* Animate nuclear plants */
-            if (tileValue == NUCLEAR && (Map[y][x] & ZONEBIT)) {
-                UpdateNuclearPower(x, y);
-            }
+        /* Animate nuclear plants */
+        if (tileValue == NUCLEAR) {
+            UpdateNuclearPower(x, y);
+        }
 
-            /* Animate airport radar */
-            if (tileValue == AIRPORT && (Map[y][x] & ZONEBIT)) {
-                UpdateAirportRadar(x, y);
-            }
-            
-            /* Animate stadium */
-            if (tileValue == STADIUM && (Map[y][x] & ZONEBIT)) {
-                DoStadiumAnimation(x, y);
-            }
+        /* Animate airport radar */
+        if (tileValue == AIRPORT) {
+            UpdateAirportRadar(x, y);
+        }
+
+        /* Animate stadium */
+        if (tileValue == STADIUM) {
+            DoStadiumAnimation(x, y);
         }
+        x++;
     }
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+/* autosave.c - Background autosave for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * Once a game month the simulation brings a shadow copy of the city up to
+ * date, copying only the chunks that changed since the previous autosave,
+ * and wakes a low-priority writer thread. The writer checksums and packs
+ * the copy, writes it to a temporary file and renames it over the autosave
+ * file, so a crash mid-write never leaves a damaged save behind. If the
+ * writer is still busy when the next month comes round, that month is
+ * skipped rather than holding up the simulation.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External variables */
+extern char progPathName[MAX_PATH];
+
+/* Shadow copy granularity - four map rows */
+#define AUTOSAVE_CHUNK (4 * WORLD_X * sizeof(short))
+
+#define AUTOSAVE_NAME "autosave." SAVE_EXTENSION
+#define AUTOSAVE_TEMP "autosave.tmp"
+
+int AutosaveEnabled = 1;
+
+static CityFile shadowCity;         /* Written by the simulation, read by the writer */
+static Byte packBuffer[PACKED_CITY_BOUND];
+
+static HANDLE hWriterThread = NULL;
+static HANDLE hWriteEvent = NULL;
+static volatile LONG writerBusy = 0;  /* Writer owns shadowCity */
+static volatile LONG writerQuit = 0;
+
+/* Pack the shadow copy and replace the autosave file with it */
+static int WriteAutosave(void) {
+    char tempPath[MAX_PATH];
+    char savePath[MAX_PATH];
+    unsigned long packedSize;
+    HANDLE hFile;
+    DWORD written;
+    BOOL ok;
+
+    wsprintf(tempPath, "%s\\%s", progPathName, AUTOSAVE_TEMP);
+    wsprintf(savePath, "%s\\%s", progPathName, AUTOSAVE_NAME);
+
+    PrepareCityFile(&shadowCity, 0);
+    packedSize = PackCityFile(&shadowCity, packBuffer, sizeof(packBuffer));
+    if (packedSize == 0) {
+        return 0;
+    }
+
+    hFile = CreateFile(tempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    ok = WriteFile(hFile, packBuffer, packedSize, &written, NULL) && written == packedSize;
+    if (ok) {
+        ok = FlushFileBuffers(hFile);
+    }
+    CloseHandle(hFile);
+
+    if (!ok) {
+        DeleteFile(tempPath);
+        return 0;
+    }
+
+    /* Swap the finished file in with a single rename */
+    if (!MoveFileEx(tempPath, savePath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFile(tempPath);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Writer thread - waits for a shadow copy and writes it out */
+static DWORD WINAPI AutosaveThreadProc(LPVOID param) {
+    while (WaitForSingleObject(hWriteEvent, INFINITE) == WAIT_OBJECT_0 && !writerQuit) {
+        if (!WriteAutosave()) {
+            addDebugLog("Autosave failed");
+        }
+        InterlockedExchange(&writerBusy, 0);
+    }
+
+    return 0;
+}
+
+/* Start the writer thread on first use */
+static int StartAutosaveThread(void) {
+    DWORD threadId;
+
+    if (hWriterThread != NULL) {
+        return 1;
+    }
+
+    hWriteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (hWriteEvent == NULL) {
+        return 0;
+    }
+
+    writerQuit = 0;
+    hWriterThread = CreateThread(NULL, 0, AutosaveThreadProc, NULL, 0, &threadId);
+    if (hWriterThread == NULL) {
+        CloseHandle(hWriteEvent);
+        hWriteEvent = NULL;
+        return 0;
+    }
+
+    SetThreadPriority(hWriterThread, THREAD_PRIORITY_LOWEST);
+    return 1;
+}
+
+/* Called by the simulation once a month. Updates the shadow copy and hands
+ * it to the writer thread; does nothing if the previous save is still being
+ * written. */
+void RequestAutosave(void) {
+    int chunks;
+
+    if (!AutosaveEnabled) {
+        return;
+    }
+    if (writerBusy) {
+        addDebugLog("Autosave skipped, previous save still writing");
+        return;
+    }
+
+    if (!StartAutosaveThread()) {
+        return;
+    }
+
+    /* The shadow starts zeroed, so the first request copies everything */
+    chunks = CaptureChangedCityState(&shadowCity.state, AUTOSAVE_CHUNK);
+
+    InterlockedExchange(&writerBusy, 1);
+    SetEvent(hWriteEvent);
+
+    addDebugLog("Autosave queued, %d chunks changed", chunks);
+}
+
+/* Let a write in progress finish and stop the writer thread */
+void StopAutosave(void) {
+    if (hWriterThread == NULL) {
+        return;
+    }
+
+    InterlockedExchange(&writerQuit, 1);
+    SetEvent(hWriteEvent);
+    WaitForSingleObject(hWriterThread, 5000);
+
+    CloseHandle(hWriterThread);
+    CloseHandle(hWriteEvent);
+    hWriterThread = NULL;
+    hWriteEvent = NULL;
+}
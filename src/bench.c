@@ -0,0 +1,422 @@
+/* bench.c - Simulation kernel benchmarks for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * "/bench" times each pass of the simulation on its own, without windows,
+ * so the cost of a change to one of them can be measured instead of
+ * guessed. Every kernel runs on each city in the cities folder and on
+ * three made-up worst cases: a map wired from edge to edge, a map paved
+ * with road and a map tiled with zones.
+ *
+ * A kernel is called BENCH_WARMUP times first, then timed for BENCH_REPS
+ * repetitions that each start from the same city. The report gives the
+ * median and fastest time per call, the spread between repetitions, the
+ * map tiles covered per nanosecond and the heap blocks the kernel left
+ * allocated.
+ */
+
+#include "sim.h"
+#include "tools.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External functions - defined in main.c */
+extern void ForceFullCensus(void);
+
+/* External variables */
+extern char progPathName[MAX_PATH];
+
+#define BENCH_SEED 12345UL
+#define BENCH_SETTLE_STEPS (16 * 4) /* Four game months before timing */
+#define BENCH_WARMUP 3              /* Untimed calls before timing */
+#define BENCH_REPS 25               /* Timed repetitions */
+#define BENCH_MIN_NS 2000000.0      /* Shortest repetition: 2 ms */
+#define BENCH_MAX_CALLS 1000        /* Most calls in one repetition */
+#define BENCH_MAX_ZONES (WORLD_X * WORLD_Y / 9)
+
+#define BENCH_TILES ((double)WORLD_X * (double)WORLD_Y)
+
+/* A kernel and how to call it once */
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} BenchKernel;
+
+static void BenchPowerScan(void);
+static void BenchMapScan(void);
+static void BenchMakeTraffic(void);
+static void BenchPTLScan(void);
+static void BenchCrimeScan(void);
+static void BenchFireAnalysis(void);
+
+static const BenchKernel BenchKernels[] = {
+    { "DoPowerScan", BenchPowerScan },
+    { "MapScan/DoZone", BenchMapScan },
+    { "MakeTraffic (every zone)", BenchMakeTraffic },
+    { "DecTrafficMap", DecTrafficMap },
+    { "CalcTrafficAverage", CalcTrafficAverage },
+    { "PTLScan", BenchPTLScan },
+    { "CrimeScan", BenchCrimeScan },
+    { "PopDenScan", PopDenScan },
+    { "FireAnalysis", BenchFireAnalysis },
+    { "AnimateTiles", AnimateTiles },
+    { "UpdateSpecialAnimations", UpdateSpecialAnimations },
+    { "TakeCensus", TakeCensus },
+    { "CityEvaluation", CityEvaluation }
+};
+
+#define BENCH_KERNEL_COUNT ((int)(sizeof(BenchKernels) / sizeof(BenchKernels[0])))
+
+static CityState freshState;    /* The game as it was before the first fixture */
+static CityState fixtureState;  /* City every repetition starts from */
+static double timerTicksPerNs;
+static double repTimes[BENCH_REPS];
+
+/* Zone centres in the fixture, for MakeTraffic */
+static int zoneCount;
+static short zoneX[BENCH_MAX_ZONES];
+static short zoneY[BENCH_MAX_ZONES];
+static short zoneType[BENCH_MAX_ZONES];
+
+/* A full power scan, even though the map has not changed since the last */
+static void BenchPowerScan(void) {
+    PowerScanNeeded = 1;
+    DoPowerScan();
+}
+
+/* A full pollution and land value scan, not just the changed chunks */
+static void BenchPTLScan(void) {
+    LandScanFull = 1;
+    PTLScan();
+}
+
+/* A crime scan that spreads police coverage again */
+static void BenchCrimeScan(void) {
+    CoverageNeeded = COVER_ALL;
+    CrimeScan();
+}
+
+/* A fire scan that spreads fire station coverage again */
+static void BenchFireAnalysis(void) {
+    CoverageNeeded = COVER_ALL;
+    FireAnalysis();
+}
+
+/* The whole map, as the simulation scans it over eight phases */
+static void BenchMapScan(void) {
+    MapScan(0, WORLD_X, 0, WORLD_Y);
+}
+
+/* One trip from every zone that can make one */
+static void BenchMakeTraffic(void) {
+    int i;
+
+    for (i = 0; i < zoneCount; i++) {
+        SMapX = zoneX[i];
+        SMapY = zoneY[i];
+        MakeTraffic(zoneType[i]);
+    }
+}
+
+/* Timer reading in ticks */
+static double ReadTimer(void) {
+    LARGE_INTEGER t;
+
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart;
+}
+
+/* Heap blocks in use */
+static long CountHeapBlocks(void) {
+    _HEAPINFO info;
+    long used;
+
+    used = 0;
+    info._pentry = NULL;
+    while (_heapwalk(&info) == _HEAPOK) {
+        if (info._useflag == _USEDENTRY) {
+            used++;
+        }
+    }
+    return used;
+}
+
+static int CompareTimes(const void *a, const void *b) {
+    double da;
+    double db;
+
+    da = *(const double *)a;
+    db = *(const double *)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+/* Note the zone centres MakeTraffic can start from */
+static void FindZones(void) {
+    int x, y;
+    int tile;
+
+    zoneCount = 0;
+    for (y = 0; y < WORLD_Y; y++) {
+        for (x = 0; x < WORLD_X; x++) {
+            if (!(Map[y][x] & ZONEBIT) || zoneCount >= BENCH_MAX_ZONES) {
+                continue;
+            }
+            tile = Map[y][x] & LOMASK;
+            if (tile >= RESBASE && tile < COMBASE) {
+                zoneType[zoneCount] = 0;
+            } else if (tile >= COMBASE && tile < INDBASE) {
+                zoneType[zoneCount] = 1;
+            } else if (tile >= INDBASE && tile <= LASTIND) {
+                zoneType[zoneCount] = 2;
+            } else {
+                continue;
+            }
+            zoneX[zoneCount] = (short)x;
+            zoneY[zoneCount] = (short)y;
+            zoneCount++;
+        }
+    }
+}
+
+/* Let the loaded city run for a while so every overlay holds real data,
+ * then keep it as the fixture */
+static void SettleFixture(void) {
+    int i;
+
+    RandomState = BENCH_SEED;
+    for (i = 0; i < BENCH_SETTLE_STEPS; i++) {
+        SimStep();
+    }
+    CaptureCityState(&fixtureState);
+    FindZones();
+}
+
+/* Start a made-up city on an empty map with funds for anything */
+static void ClearFixture(void) {
+    RestoreCityState(&freshState);
+    memset(Map, 0, sizeof(Map));
+    RebuildTilePlanes();
+    memset(ResHis, 0, sizeof(ResHis));
+    memset(ComHis, 0, sizeof(ComHis));
+    memset(IndHis, 0, sizeof(IndHis));
+    memset(CrimeHis, 0, sizeof(CrimeHis));
+    memset(PollutionHis, 0, sizeof(PollutionHis));
+    memset(MoneyHis, 0, sizeof(MoneyHis));
+    memset(MiscHis, 0, sizeof(MiscHis));
+    memset(ResLongHis, 0, sizeof(ResLongHis));
+    memset(ComLongHis, 0, sizeof(ComLongHis));
+    memset(IndLongHis, 0, sizeof(IndLongHis));
+    memset(CrimeLongHis, 0, sizeof(CrimeLongHis));
+    memset(PollutionLongHis, 0, sizeof(PollutionLongHis));
+    memset(MoneyLongHis, 0, sizeof(MoneyLongHis));
+    TotalFunds = 100000000L;
+}
+
+/* Nuclear plants in two rows, enough to power most of the map */
+static void PlacePlants(void) {
+    int x;
+
+    SelectTool(nuclearState);
+    for (x = 10; x < WORLD_X - 4; x += 24) {
+        ApplyTool(x, WORLD_Y / 4);
+        ApplyTool(x, WORLD_Y * 3 / 4);
+    }
+}
+
+/* Fill every empty tile using the current tool */
+static void FillEmpty(void) {
+    int x, y;
+
+    for (y = 0; y < WORLD_Y; y++) {
+        for (x = 0; x < WORLD_X; x++) {
+            if ((Map[y][x] & LOMASK) == DIRT) {
+                ApplyTool(x, y);
+            }
+        }
+    }
+}
+
+/* Power plants with wire on every free tile */
+static void BuildWiredGrid(void) {
+    ClearFixture();
+    PlacePlants();
+    SelectTool(wireState);
+    FillEmpty();
+}
+
+/* Road on every tile */
+static void BuildRoadMap(void) {
+    ClearFixture();
+    SelectTool(roadState);
+    FillEmpty();
+}
+
+/* Power plants with residential, commercial and industrial zones in turn
+ * on every 3x3 block that is free */
+static void BuildZoneMap(void) {
+    int x, y;
+    int n;
+
+    ClearFixture();
+    PlacePlants();
+
+    n = 0;
+    for (y = 1; y < WORLD_Y - 1; y += 3) {
+        for (x = 1; x < WORLD_X - 1; x += 3) {
+            SelectTool(residentialState + n % 3);
+            if (ApplyTool(x, y) == TOOLRESULT_OK) {
+                n++;
+            }
+        }
+    }
+}
+
+/* Start a made-up city the way an original city file is started */
+static void StartSyntheticFixture(void (*build)(void)) {
+    build();
+    ForceFullCensus();
+    DoSimInit();
+    ForceFullCensus();
+}
+
+/* Time every kernel on the current fixture and report the results */
+static void BenchFixture(FILE *report, const char *name) {
+    const BenchKernel *k;
+    double start;
+    double once;
+    double median;
+    long calls;
+    long blocks;
+    long call;
+    int rep;
+    int i;
+
+    fprintf(report, "\n%s (%d zones)\n", name, zoneCount);
+
+    for (i = 0; i < BENCH_KERNEL_COUNT; i++) {
+        k = &BenchKernels[i];
+
+        /* Warm the caches and settle any first-call work */
+        RestoreCityState(&fixtureState);
+        for (call = 0; call < BENCH_WARMUP; call++) {
+            k->run();
+        }
+
+        /* Enough calls per repetition to rise well above timer resolution */
+        start = ReadTimer();
+        k->run();
+        once = (ReadTimer() - start) / timerTicksPerNs;
+        calls = once > 0.0 ? (long)(BENCH_MIN_NS / once) : BENCH_MAX_CALLS;
+        if (calls < 1) {
+            calls = 1;
+        } else if (calls > BENCH_MAX_CALLS) {
+            calls = BENCH_MAX_CALLS;
+        }
+
+        blocks = CountHeapBlocks();
+        for (rep = 0; rep < BENCH_REPS; rep++) {
+            RestoreCityState(&fixtureState);
+            start = ReadTimer();
+            for (call = 0; call < calls; call++) {
+                k->run();
+            }
+            repTimes[rep] = (ReadTimer() - start) / timerTicksPerNs / (double)calls;
+        }
+        blocks = CountHeapBlocks() - blocks;
+
+        qsort(repTimes, BENCH_REPS, sizeof(double), CompareTimes);
+        median = repTimes[BENCH_REPS / 2];
+
+        fprintf(report, "  %-26s %12.0f %12.0f %7.1f%% %9.3f %6ld %+5ld\n", k->name, median,
+                repTimes[0],
+                median > 0.0 ? (repTimes[BENCH_REPS * 3 / 4] - repTimes[BENCH_REPS / 4]) * 100.0 /
+                                   median
+                             : 0.0,
+                median > 0.0 ? BENCH_TILES / median : 0.0, calls, blocks);
+    }
+}
+
+/* Run the benchmarks without windows and write bench.log next to the
+ * program. Returns 1 if at least one fixture was timed. */
+int RunBenchmarks(void) {
+    char pattern[MAX_PATH];
+    char path[MAX_PATH];
+    char name[MAX_PATH];
+    char *dot;
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    LARGE_INTEGER freq;
+    FILE *report;
+    int fixtures;
+
+    if (!QueryPerformanceFrequency(&freq) || freq.QuadPart == 0) {
+        return 0;
+    }
+    timerTicksPerNs = (double)freq.QuadPart / 1000000000.0;
+
+    wsprintf(path, "%s\\bench.log", progPathName);
+    report = fopen(path, "w");
+    if (report == NULL) {
+        return 0;
+    }
+
+    /* Nothing but the kernels may touch the city */
+    AutosaveEnabled = 0;
+    CaptureCityState(&freshState);
+
+    fprintf(report, "Kernel benchmarks: %d repetitions after %d warm-up calls, %.0f timer ticks/s\n",
+            BENCH_REPS, BENCH_WARMUP, (double)freq.QuadPart);
+    fprintf(report, "Times are ns per call; spread is the interquartile range; heap is the\n");
+    fprintf(report, "change in heap blocks in use over all repetitions\n\n");
+    fprintf(report, "  %-26s %12s %12s %8s %9s %6s %5s\n", "kernel", "median", "fastest",
+            "spread", "tiles/ns", "calls", "heap");
+
+    fixtures = 0;
+
+    StartSyntheticFixture(BuildWiredGrid);
+    SettleFixture();
+    BenchFixture(report, "synthetic: wired grid");
+    fixtures++;
+
+    StartSyntheticFixture(BuildRoadMap);
+    SettleFixture();
+    BenchFixture(report, "synthetic: all road");
+    fixtures++;
+
+    StartSyntheticFixture(BuildZoneMap);
+    SettleFixture();
+    BenchFixture(report, "synthetic: all zones");
+    fixtures++;
+
+    wsprintf(pattern, "%s\\cities\\*.cty", progPathName);
+    hFind = FindFirstFile(pattern, &fd);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            wsprintf(path, "%s\\cities\\%s", progPathName, fd.cFileName);
+            lstrcpy(name, fd.cFileName);
+            dot = strrchr(name, '.');
+            if (dot) {
+                *dot = '\0';
+            }
+
+            if (!StartHeadlessCity(path, &freshState)) {
+                fprintf(report, "\n%s: failed to load\n", name);
+                continue;
+            }
+            SettleFixture();
+            BenchFixture(report, name);
+            fixtures++;
+        } while (FindNextFile(hFind, &fd));
+        FindClose(hFind);
+    }
+
+    fclose(report);
+    return fixtures > 0;
+}
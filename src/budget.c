@@ -287,6 +287,7 @@ void SetRoadPercent(float percent) {
     }
 
     RoadPercent = percent;
+    RecordBudgetCommand(BUDGET_ROAD, percent);
     DoBudget();
 }
 
@@ -299,6 +300,7 @@ void SetPolicePercent(float percent) {
     }
 
     PolicePercent = percent;
+    RecordBudgetCommand(BUDGET_POLICE, percent);
     DoBudget();
 }
 
@@ -311,5 +313,6 @@ void SetFirePercent(float percent) {
     }
 
     FirePercent = percent;
+    RecordBudgetCommand(BUDGET_FIRE, percent);
     DoBudget();
 }
\ No newline at end of file
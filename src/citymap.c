@@ -0,0 +1,278 @@
+/* citymap.c - Memory-mapped city file loading for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * City files are mapped read-only and used in place. A native file is
+ * validated and read straight out of the view. An original big-endian .cty
+ * file is converted once and the native copy is kept in the cache
+ * directory, so loading the same city again is a single mapping. Packed
+ * native files, as written by autosave, are expanded into memory.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External functions - defined in main.c */
+extern void ForceFullCensus(void);
+
+/* External variables */
+extern char progPathName[MAX_PATH];
+extern short ScenarioID; /* Defined in scenarios.c */
+
+/* Cache directory for converted cities, relative to the program */
+#define CITY_CACHE_DIR "cache"
+
+/* In-memory copy for converted and packed cities */
+static CityFile convertedCity;
+
+/* Map a file read-only. Returns 1 on success; the view stays valid until
+ * UnmapCityFile(). */
+int MapCityFile(const char *filename, MappedFile *mf) {
+    mf->hFile = INVALID_HANDLE_VALUE;
+    mf->hMapping = NULL;
+    mf->data = NULL;
+    mf->size = 0;
+
+    mf->hFile = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mf->hFile == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    mf->size = GetFileSize(mf->hFile, NULL);
+    if (mf->size == 0 || mf->size == 0xFFFFFFFF) {
+        UnmapCityFile(mf);
+        return 0;
+    }
+
+    mf->hMapping = CreateFileMapping(mf->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mf->hMapping == NULL) {
+        UnmapCityFile(mf);
+        return 0;
+    }
+
+    mf->data = (const Byte *)MapViewOfFile(mf->hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (mf->data == NULL) {
+        UnmapCityFile(mf);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Release a mapping made by MapCityFile. Safe to call on a failed or
+ * already released mapping. */
+void UnmapCityFile(MappedFile *mf) {
+    if (mf->data) {
+        UnmapViewOfFile((LPVOID)mf->data);
+        mf->data = NULL;
+    }
+    if (mf->hMapping) {
+        CloseHandle(mf->hMapping);
+        mf->hMapping = NULL;
+    }
+    if (mf->hFile != INVALID_HANDLE_VALUE && mf->hFile != NULL) {
+        CloseHandle(mf->hFile);
+    }
+    mf->hFile = INVALID_HANDLE_VALUE;
+    mf->size = 0;
+}
+
+/* Read a big-endian short from an original city file */
+#define BE_SHORT(p) ((short)(((p)[0] << 8) | (p)[1]))
+
+/* Convert an original city file image into a native state. Only the map
+ * and history are filled in; the caller runs the census for the rest. */
+int ConvertLegacyCity(const Byte *data, unsigned long size, CityState *state) {
+    const Byte *p;
+    int i;
+    int x, y;
+
+    if (size != LEGACY_CITY_SIZE) {
+        return 0;
+    }
+
+    memset(state, 0, sizeof(CityState));
+    p = data;
+
+    /* Seven history arrays in a fixed order */
+    for (i = 0; i < HISTLEN / 2; i++, p += 2) {
+        state->resHis[i] = BE_SHORT(p);
+    }
+    for (i = 0; i < HISTLEN / 2; i++, p += 2) {
+        state->comHis[i] = BE_SHORT(p);
+    }
+    for (i = 0; i < HISTLEN / 2; i++, p += 2) {
+        state->indHis[i] = BE_SHORT(p);
+    }
+    for (i = 0; i < HISTLEN / 2; i++, p += 2) {
+        state->crimeHis[i] = BE_SHORT(p);
+    }
+    for (i = 0; i < HISTLEN / 2; i++, p += 2) {
+        state->pollutionHis[i] = BE_SHORT(p);
+    }
+    for (i = 0; i < HISTLEN / 2; i++, p += 2) {
+        state->moneyHis[i] = BE_SHORT(p);
+    }
+    for (i = 0; i < MISCHISTLEN / 2; i++, p += 2) {
+        state->miscHis[i] = BE_SHORT(p);
+    }
+
+    /* Original Micropolis stores the map column by column */
+    for (x = 0; x < WORLD_X; x++) {
+        for (y = 0; y < WORLD_Y; y++, p += 2) {
+            state->map[y][x] = BE_SHORT(p);
+        }
+    }
+
+    return 1;
+}
+
+/* Build the cache file name for a city. The full path is hashed into the
+ * name so that cities with the same name in different folders differ. */
+static void GetCityCachePath(const char *filename, char *cachePath) {
+    const char *baseName;
+    char name[MAX_PATH];
+    char *dot;
+
+    baseName = filename;
+    if (strrchr(baseName, '\\')) {
+        baseName = strrchr(baseName, '\\') + 1;
+    }
+    if (strrchr(baseName, '/')) {
+        baseName = strrchr(baseName, '/') + 1;
+    }
+
+    lstrcpyn(name, baseName, MAX_PATH - 32);
+    dot = strrchr(name, '.');
+    if (dot) {
+        *dot = '\0';
+    }
+
+    wsprintf(cachePath, "%s\\%s\\%s-%08lx.%s", progPathName, CITY_CACHE_DIR, name,
+             CityChecksum(filename, lstrlen(filename)), SAVE_EXTENSION);
+}
+
+/* Get the last write time of a file. Returns 0 if it does not exist. */
+static int GetWriteTime(const char *filename, FILETIME *ft) {
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+
+    hFind = FindFirstFile(filename, &fd);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    FindClose(hFind);
+
+    *ft = fd.ftLastWriteTime;
+    return 1;
+}
+
+/* Open a city file as a native image. Native files are viewed in place.
+ * Original city files are served from a cached native copy, which is
+ * created or refreshed when missing or older than the original. Returns
+ * NULL on failure; otherwise UnmapCityFile(mf) releases the view. */
+const CityFile *OpenCityView(const char *filename, MappedFile *mf) {
+    char cachePath[MAX_PATH];
+    char cacheDir[MAX_PATH];
+    FILETIME srcTime;
+    FILETIME cacheTime;
+    int converted;
+
+    if (!MapCityFile(filename, mf)) {
+        return NULL;
+    }
+
+    /* Native file: use the mapping as it is */
+    if (mf->size >= sizeof(SaveHeader) && memcmp(mf->data, SAVE_MAGIC, 4) == 0) {
+        /* Packed files (autosaves) have to be expanded into memory */
+        if (((const SaveHeader *)mf->data)->flags & SAVE_FLAG_PACKED) {
+            converted = UnpackCityFile(mf->data, mf->size, &convertedCity);
+            UnmapCityFile(mf);
+            return converted ? &convertedCity : NULL;
+        }
+        if (!CheckCityFile((const CityFile *)mf->data, mf->size)) {
+            UnmapCityFile(mf);
+            return NULL;
+        }
+        return (const CityFile *)mf->data;
+    }
+
+    if (mf->size != LEGACY_CITY_SIZE) {
+        UnmapCityFile(mf);
+        return NULL;
+    }
+
+    /* Original city file: prefer a cached copy that is at least as new */
+    GetCityCachePath(filename, cachePath);
+    if (GetWriteTime(filename, &srcTime) && GetWriteTime(cachePath, &cacheTime) &&
+        CompareFileTime(&cacheTime, &srcTime) >= 0) {
+        MappedFile cache;
+
+        if (MapCityFile(cachePath, &cache)) {
+            if (CheckCityFile((const CityFile *)cache.data, cache.size)) {
+                UnmapCityFile(mf);
+                *mf = cache;
+                return (const CityFile *)mf->data;
+            }
+            UnmapCityFile(&cache);
+        }
+    }
+
+    /* Convert once and keep the result for next time */
+    converted = ConvertLegacyCity(mf->data, mf->size, &convertedCity.state);
+    UnmapCityFile(mf);
+    if (!converted) {
+        return NULL;
+    }
+
+    PrepareCityFile(&convertedCity, SAVE_FLAG_IMPORTED);
+
+    wsprintf(cacheDir, "%s\\%s", progPathName, CITY_CACHE_DIR);
+    CreateDirectory(cacheDir, NULL);
+    if (WriteCityFile(cachePath, &convertedCity)) {
+        addDebugLog("Cached converted city: %s", cachePath);
+    }
+
+    /* No mapping to release; the converted copy is served from memory */
+    return &convertedCity;
+}
+
+/* Load a city without windows and start it the way loadCity() does. An
+ * original city file only brings its map and history, so the rest of the
+ * game is first reset to the given state. Returns 0 if the file cannot be
+ * read. */
+int StartHeadlessCity(const char *filename, const CityState *fresh) {
+    MappedFile mf;
+    const CityFile *file;
+
+    file = OpenCityView(filename, &mf);
+    if (file == NULL) {
+        return 0;
+    }
+
+    RestoreCityState(fresh);
+    ScenarioID = 0;
+    DisasterEvent = 0;
+    DisasterWait = 0;
+
+    if (file->header.flags & SAVE_FLAG_IMPORTED) {
+        RestoreImportedCity(&file->state);
+        UnmapCityFile(&mf);
+        ForceFullCensus();
+        DoSimInit();
+        ForceFullCensus();
+    } else {
+        RestoreCityState(&file->state);
+        UnmapCityFile(&mf);
+    }
+
+    return 1;
+}
@@ -5,6 +5,7 @@
 #include "sim.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <windows.h>
 
 /* External log functions */
@@ -51,7 +52,7 @@ void doEarthquake(void) {
     addGameLog("DISASTER: EARTHQUAKE!!!");
     addGameLog("Epicenter at coordinates %d,%d", epicenterX, epicenterY);
     addDebugLog("Earthquake: Magnitude %d, Duration %d", (time / 100), time);
-    MessageBox(hwndMain, buf, "Disaster", MB_ICONEXCLAMATION | MB_OK);
+    ShowSimMessage(buf, "Disaster");
 
     for (z = 0; z < time; z++) {
         /* Get random coordinates but ensure they are within bounds */
@@ -69,10 +70,10 @@ void doEarthquake(void) {
         if ((tileValue >= RESBASE) && (tileValue <= LOCAL_LASTZONE) && !(tile & ZONEBIT)) {
             if (z & 0x3) {
                 /* Create rubble (every 4th iteration) */
-                Map[y][x] = (RUBBLE + BULLBIT) + (SimRandom(4));
+                SetTile(x, y, (RUBBLE + BULLBIT) + (SimRandom(4)));
             } else {
                 /* Create fire */
-                Map[y][x] = (FIRE + ANIMBIT) + (SimRandom(8));
+                SetTile(x, y, (FIRE + ANIMBIT) + (SimRandom(8)));
             }
         }
     }
@@ -92,7 +93,7 @@ void makeExplosion(int x, int y) {
     }
 
     /* Create fire at explosion center */
-    Map[y][x] = (FIRE + ANIMBIT) + (SimRandom(8));
+    SetTile(x, y, (FIRE + ANIMBIT) + (SimRandom(8)));
 
     /* Create fire in surrounding tiles (N, E, S, W) */
     for (dir = 0; dir < 4; dir++) {
@@ -103,7 +104,7 @@ void makeExplosion(int x, int y) {
         if (tx >= 0 && tx < WORLD_X && ty >= 0 && ty < WORLD_Y) {
             /* Only set fire if not a zone center */
             if (!(Map[ty][tx] & ZONEBIT)) {
-                Map[ty][tx] = (FIRE + ANIMBIT) + (SimRandom(8));
+                SetTile(tx, ty, (FIRE + ANIMBIT) + (SimRandom(8)));
             }
         }
     }
@@ -115,7 +116,7 @@ void makeExplosion(int x, int y) {
     addGameLog("DISASTER: Explosion at %d,%d!", x, y);
     addDebugLog("Explosion created at coordinates %d,%d", x, y);
 
-    MessageBox(hwndMain, buf, "Disaster", MB_ICONEXCLAMATION | MB_OK);
+    ShowSimMessage(buf, "Disaster");
 
     /* Force redraw */
     InvalidateRect(hwndMain, NULL, FALSE);
@@ -131,7 +132,7 @@ void makeFire(int x, int y) {
     }
 
     /* Create fire tile with animation and random frame */
-    Map[y][x] = (FIRE + ANIMBIT) + (SimRandom(8));
+    SetTile(x, y, (FIRE + ANIMBIT) + (SimRandom(8)));
 
     /* Notify user */
     wsprintf(buf, "Fire reported at %d,%d!", x, y);
@@ -140,60 +141,96 @@ void makeFire(int x, int y) {
     addGameLog("DISASTER: Fire reported at %d,%d!", x, y);
     addDebugLog("Fire created at coordinates %d,%d", x, y);
 
-    MessageBox(hwndMain, buf, "Disaster", MB_ICONEXCLAMATION | MB_OK);
+    ShowSimMessage(buf, "Disaster");
 
     /* Force redraw */
     InvalidateRect(hwndMain, NULL, FALSE);
 }
 
-/* Check for and spread fires - called from simulation loop */
-void spreadFire(void) {
-    int x, y, dir, tx, ty;
-    int i;
-    short tileValue;
-
-    /* Process a limited number of random locations */
-    for (i = 0; i < 20; i++) {
-        /* Pick a random position */
-        x = SimRandom(WORLD_X);
-        y = SimRandom(WORLD_Y);
+/* Fire spread. Each call visits every tile burning when it starts: a
+ * burnable neighbour catches one time in FIRE_SPREAD_CHANCE, and the fire
+ * itself burns out sooner the better the fire coverage there. */
+#define FIRE_SPREAD_CHANCE 8
+
+/* A zone centre has caught fire: the rest of the zone is left as wreckage
+ * that can be bulldozed, as in the original FireZone */
+static void FireZone(int x, int y, short z) {
+    int dx, dy, tx, ty;
+    int size;
+
+    z = z & LOMASK;
+    if (z < PORTBASE) {
+        size = 2;
+    } else if (z == AIRPORT) {
+        size = 5;
+    } else {
+        size = 4;
+    }
 
-        /* Skip if out of bounds */
-        if (x < 0 || x >= WORLD_X || y < 0 || y >= WORLD_Y) {
-            continue;
+    for (dx = -1; dx < size; dx++) {
+        for (dy = -1; dy < size; dy++) {
+            tx = x + dx;
+            ty = y + dy;
+            if (tx < 0 || tx >= WORLD_X || ty < 0 || ty >= WORLD_Y) {
+                continue;
+            }
+            if ((Map[ty][tx] & LOMASK) >= ROADBASE) {
+                SetTile(tx, ty, Map[ty][tx] | BULLBIT);
+            }
         }
+    }
+}
 
-        tileValue = Map[y][x] & LOMASK;
-
-        /* Check if it's a fire tile */
-        if (tileValue >= FIRE && tileValue < (FIRE + 8)) {
-            /* It's a fire! Chance to spread to adjacent tiles */
-            if (SimRandom(10) < 3) { /* 30% chance to spread */
-                /* Log fire spreading only occasionally to avoid spam */
-                if (SimRandom(20) == 0) {
-                    addDebugLog("Fire spreading at %d,%d", x, y);
-                }
-                /* Pick a random direction */
-                dir = SimRandom(4);
-                tx = x + xDelta[dir];
-                ty = y + yDelta[dir];
-
-                /* Check if the target tile is in bounds */
-                if (tx >= 0 && tx < WORLD_X && ty >= 0 && ty < WORLD_Y) {
-                    /* Only spread to burnable tiles */
-                    if (Map[ty][tx] & BURNBIT) {
-                        /* Create a fire with animation */
-                        Map[ty][tx] = (FIRE + ANIMBIT) + (SimRandom(8));
+/* Check for and spread fires - called from simulation loop */
+void spreadFire(void) {
+    static BitPlane burning;    /* The fire plane as the call started */
+    int x, y, dir, tx, ty;
+    int rate;
+    short z;
+
+    /* Fires lit below wait for the next call */
+    memcpy(burning, TilePlanes[TILE_PLANE_FIRE], sizeof(burning));
+
+    /* Catch up with any station built or lost since the last scan */
+    FireAnalysis();
+
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(burning, &x, &y)) {
+        /* Spread to burnable neighbours */
+        for (dir = 0; dir < 4; dir++) {
+            tx = x + xDelta[dir];
+            ty = y + yDelta[dir];
+
+            if (tx >= 0 && tx < WORLD_X && ty >= 0 && ty < WORLD_Y) {
+                z = Map[ty][tx];
+                if ((z & BURNBIT) && SimRandom(FIRE_SPREAD_CHANCE) == 0) {
+                    if (z & ZONEBIT) {
+                        FireZone(tx, ty, z);
                     }
+                    SetTile(tx, ty, (FIRE + ANIMBIT) + (SimRandom(8)));
                 }
             }
+        }
 
-            /* Small chance for fire to burn out */
-            if (SimRandom(10) == 0) { /* 10% chance to burn out */
-                /* Convert to rubble */
-                Map[y][x] = RUBBLE + BULLBIT + (SimRandom(4));
+        /* Fire coverage puts fires out sooner */
+        rate = 10;
+        z = FireCover[y >> 1][x >> 1];
+        if (z) {
+            rate = 3;
+            if (z > 20) {
+                rate = 2;
+            }
+            if (z > 100) {
+                rate = 1;
             }
         }
+
+        /* Burn out to rubble */
+        if (SimRandom(rate + 1) == 0) {
+            SetTile(x, y, RUBBLE + BULLBIT + (SimRandom(4)));
+        }
+        x++;
     }
 }
 
@@ -223,7 +260,7 @@ void makeMonster(void) {
             /* Only place monster on non-dirt tiles */
             if (tile != 0) {
                 /* Create fire at monster's starting position */
-                Map[y][x] = (FIRE + ANIMBIT) + (SimRandom(8));
+                SetTile(x, y, (FIRE + ANIMBIT) + (SimRandom(8)));
                 found = 1;
 
                 /* Monster moves randomly destroying things */
@@ -258,7 +295,7 @@ void makeMonster(void) {
                     if (tx >= 0 && tx < WORLD_X && ty >= 0 && ty < WORLD_Y) {
                         x = tx;
                         y = ty;
-                        Map[y][x] = (FIRE + ANIMBIT) + (SimRandom(8));
+                        SetTile(x, y, (FIRE + ANIMBIT) + (SimRandom(8)));
                     }
                 }
             }
@@ -270,7 +307,7 @@ void makeMonster(void) {
     {
         char buf[256];
         wsprintf(buf, "Monster attack reported in the city!");
-        MessageBox(hwndMain, buf, "Disaster", MB_ICONEXCLAMATION | MB_OK);
+        ShowSimMessage(buf, "Disaster");
     }
 
     /* Force redraw */
@@ -314,12 +351,12 @@ void makeFlood(void) {
                             ((Map[yy][xx] & BULLBIT) && (Map[yy][xx] & BURNBIT))) {
 
                             /* Create initial flood tile */
-                            Map[yy][xx] = FLOOD;
+                            SetTile(xx, yy, FLOOD);
                             waterFound = 1;
 
                             /* Notify user */
                             wsprintf(buf, "Flooding reported at %d,%d!", xx, yy);
-                            MessageBox(hwndMain, buf, "Disaster", MB_ICONEXCLAMATION | MB_OK);
+                            ShowSimMessage(buf, "Disaster");
 
                             /* Start spreading the flood - limit to 100 iterations */
                             for (i = 0; i < 100; i++) {
@@ -332,7 +369,7 @@ void makeFlood(void) {
                                     if (tx >= 0 && tx < WORLD_X && ty >= 0 && ty < WORLD_Y) {
                                         if (Map[ty][tx] == DIRT ||
                                             ((Map[ty][tx] & BULLBIT) && (Map[ty][tx] & BURNBIT))) {
-                                            Map[ty][tx] = FLOOD;
+                                            SetTile(tx, ty, FLOOD);
                                         }
                                     }
                                 }
@@ -344,7 +381,7 @@ void makeFlood(void) {
                                 if (tx >= 0 && tx < WORLD_X && ty >= 0 && ty < WORLD_Y) {
                                     if (Map[ty][tx] == DIRT ||
                                         ((Map[ty][tx] & BULLBIT) && (Map[ty][tx] & BURNBIT))) {
-                                        Map[ty][tx] = FLOOD;
+                                        SetTile(tx, ty, FLOOD);
                                     }
                                 }
                             }
@@ -386,7 +423,7 @@ void makeMeltdown(void) {
                     "Nuclear meltdown at coordinates %d,%d, spreading radiation in 20x20 area", x,
                     y);
 
-                MessageBox(hwndMain, buf, "Disaster", MB_ICONEXCLAMATION | MB_OK);
+                ShowSimMessage(buf, "Disaster");
 
                 /* Create radiation in a 20x20 area around the plant */
                 for (i = 0; i < 40; i++) {
@@ -397,13 +434,13 @@ void makeMeltdown(void) {
                     /* Ensure positions are within bounds */
                     if (tx >= 0 && tx < WORLD_X && ty >= 0 && ty < WORLD_Y) {
                         /* Add radiation tiles */
-                        Map[ty][tx] = RADTILE;
+                        SetTile(tx, ty, RADTILE);
                     }
                 }
 
                 /* Create fire at power plant location */
                 if (x >= 0 && x < WORLD_X && y >= 0 && y < WORLD_Y) {
-                    Map[y][x] = (FIRE + ANIMBIT) + (SimRandom(8));
+                    SetTile(x, y, (FIRE + ANIMBIT) + (SimRandom(8)));
                 }
 
                 found = 1;
@@ -492,23 +492,21 @@ void CountSpecialTiles(void) {
     CoalPop = 0;
     NuclearPop = 0;
 
-    /* Scan the map for special tiles */
-    for (x = 0; x < WORLD_X; x++) {
-        for (y = 0; y < WORLD_Y; y++) {
-            tile = Map[y][x] & LOMASK;
-
-            /* Check for zone centers */
-            if (Map[y][x] & ZONEBIT) {
-                /* Check tile types */
-                if (tile == HOSPITAL) {
-                    HospPop++;
-                } else if (tile == POWERPLANT) {
-                    CoalPop++;
-                } else if (tile == NUCLEAR) {
-                    NuclearPop++;
-                }
-            }
+    /* Scan the zone centres for special tiles */
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(TilePlanes[TILE_PLANE_ZONE], &x, &y)) {
+        tile = Map[y][x] & LOMASK;
+
+        /* Check tile types */
+        if (tile == HOSPITAL) {
+            HospPop++;
+        } else if (tile == POWERPLANT) {
+            CoalPop++;
+        } else if (tile == NUCLEAR) {
+            NuclearPop++;
         }
+        x++;
     }
 }
 
@@ -0,0 +1,391 @@
+/* golden.c - Golden-state regression check for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * Runs every city in the cities folder for a fixed number of simulation
+ * steps from a fixed seed and hashes the city after every step: each map
+ * row and column, every overlay, the history, the saved scalars and the
+ * census counts. "/golden record" stores the hashes in the golden folder;
+ * "/golden" compares a run against them and reports the first step that
+ * differs, which parts of the city differ and, for the map, the first
+ * differing tile. Run it before and after changing how the simulation
+ * works internally to show that it still behaves the same. Each step also
+ * checks the tile flag planes against the map. After the cities, a fire
+ * lit in a forest must spread within a few cycles.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External variables */
+extern char progPathName[MAX_PATH];
+
+#define GOLDEN_MAGIC "MNTG"
+#define GOLDEN_VERSION 1
+#define GOLDEN_DIR "golden"
+#define GOLDEN_SEED 12345UL
+#define GOLDEN_STEPS (16 * 12 * 2) /* Two game years */
+
+/* The fire check: a line of fire across a forest, and how many cycles it
+   gets to reach tiles that were not lit */
+#define FIRE_CHECK_LENGTH 9
+#define FIRE_CHECK_CYCLES 16
+
+/* Parts of the city hashed after each step, besides map rows and columns */
+typedef struct {
+    const char *name;
+    size_t offset;
+    size_t size;
+} GoldenPart;
+
+static const GoldenPart GoldenParts[] = {
+    { "power map", offsetof(CityState, powerMap), sizeof(PowerMap) },
+    { "population density", offsetof(CityState, popDensity), sizeof(PopDensity) },
+    { "traffic density", offsetof(CityState, trfDensity), sizeof(TrfDensity) },
+    { "pollution", offsetof(CityState, pollutionMem), sizeof(PollutionMem) },
+    { "land value", offsetof(CityState, landValueMem), sizeof(LandValueMem) },
+    { "crime", offsetof(CityState, crimeMem), sizeof(CrimeMem) },
+    { "terrain", offsetof(CityState, terrainMem), sizeof(TerrainMem) },
+    { "fire station map", offsetof(CityState, fireStMap), sizeof(FireStMap) },
+    { "fire coverage", offsetof(CityState, fireRate), sizeof(FireRate) },
+    { "police station map", offsetof(CityState, policeMap), sizeof(PoliceMap) },
+    { "police coverage", offsetof(CityState, policeMapEffect), sizeof(PoliceMapEffect) },
+    { "commercial rate", offsetof(CityState, comRate), sizeof(ComRate) },
+    { "history", offsetof(CityState, resHis), offsetof(CityState, cityTime) -
+                                                  offsetof(CityState, resHis) },
+    { "scalar state", offsetof(CityState, cityTime), sizeof(CityState) - offsetof(CityState, cityTime) }
+};
+
+#define GOLDEN_PART_COUNT ((int)(sizeof(GoldenParts) / sizeof(GoldenParts[0])))
+
+/* Hash layout for one step: map rows, map columns, parts, census */
+#define HASH_ROWS 0
+#define HASH_COLS (HASH_ROWS + WORLD_Y)
+#define HASH_PARTS (HASH_COLS + WORLD_X)
+#define HASH_CENSUS (HASH_PARTS + GOLDEN_PART_COUNT)
+#define HASHES_PER_STEP (HASH_CENSUS + 1)
+
+typedef struct {
+    char magic[4];              /* GOLDEN_MAGIC */
+    unsigned short version;     /* GOLDEN_VERSION */
+    unsigned short hashesPerStep;
+    unsigned long steps;
+    unsigned long seed;
+} GoldenHeader;
+
+static CityState goldenState;
+static CityState startState;     /* The game as it was before the first city */
+static unsigned long stepHashes[HASHES_PER_STEP];
+static unsigned long goldenHashes[GOLDEN_STEPS][HASHES_PER_STEP];
+
+/* FNV-1a offset basis and prime */
+#define FNV_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+
+/* Continue an FNV-1a hash over a block of bytes */
+static unsigned long HashBytes(unsigned long h, const void *data, size_t size) {
+    const Byte *p;
+
+    p = (const Byte *)data;
+    while (size-- > 0) {
+        h = ((h ^ *p++) * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+    return h;
+}
+
+/* Hash the running city into stepHashes */
+static void HashCity(void) {
+    int x, y;
+    int i;
+    int census[20];
+
+    CaptureCityState(&goldenState);
+
+    for (y = 0; y < WORLD_Y; y++) {
+        stepHashes[HASH_ROWS + y] = HashBytes(FNV_BASIS, goldenState.map[y], sizeof(Map[0]));
+    }
+    for (x = 0; x < WORLD_X; x++) {
+        stepHashes[HASH_COLS + x] = FNV_BASIS;
+    }
+    for (y = 0; y < WORLD_Y; y++) {
+        for (x = 0; x < WORLD_X; x++) {
+            stepHashes[HASH_COLS + x] =
+                HashBytes(stepHashes[HASH_COLS + x], &goldenState.map[y][x], sizeof(short));
+        }
+    }
+
+    for (i = 0; i < GOLDEN_PART_COUNT; i++) {
+        stepHashes[HASH_PARTS + i] = HashBytes(
+            FNV_BASIS, (const Byte *)&goldenState + GoldenParts[i].offset, GoldenParts[i].size);
+    }
+
+    /* Counts the scanners build up that are not part of a save */
+    census[0] = PwrdZCnt;
+    census[1] = UnpwrdZCnt;
+    census[2] = RoadTotal;
+    census[3] = RailTotal;
+    census[4] = FirePop;
+    census[5] = PolicePop;
+    census[6] = StadiumPop;
+    census[7] = PortPop;
+    census[8] = APortPop;
+    census[9] = NuclearPop;
+    census[10] = RoadEffect;
+    census[11] = PoliceEffect;
+    census[12] = FireEffect;
+    census[13] = TrafficAverage;
+    census[14] = PollutionAverage;
+    census[15] = CrimeAverage;
+    census[16] = LVAverage;
+    census[17] = ResCap;
+    census[18] = ComCap;
+    census[19] = IndCap;
+    stepHashes[HASH_CENSUS] = HashBytes(FNV_BASIS, census, sizeof(census));
+}
+
+/* Describe the differences between stepHashes and a golden step */
+static void ReportDifference(FILE *report, const char *name, int step,
+                             const unsigned long *golden) {
+    int x, y;
+    int rows, cols;
+    int firstX, firstY;
+    int i;
+
+    fprintf(report, "%s: FAIL at step %d (month %ld, phase %d)\n", name, step + 1,
+            CityTime, Fcycle & 15);
+
+    rows = 0;
+    cols = 0;
+    firstX = -1;
+    firstY = -1;
+    for (y = 0; y < WORLD_Y; y++) {
+        if (stepHashes[HASH_ROWS + y] != golden[HASH_ROWS + y]) {
+            if (rows++ == 0) {
+                firstY = y;
+            }
+        }
+    }
+    for (x = 0; x < WORLD_X; x++) {
+        if (stepHashes[HASH_COLS + x] != golden[HASH_COLS + x]) {
+            if (cols++ == 0) {
+                firstX = x;
+            }
+        }
+    }
+    /* The hashes only say which rows and columns changed, so the first tile
+       is where the first of each cross; it is exact when only one row or only
+       one column differs */
+    if (rows > 0 && cols > 0) {
+        fprintf(report, "  map: first differing tile (%d, %d), now %04x\n", firstX, firstY,
+                Map[firstY][firstX] & 0xFFFF);
+        if (rows > 1 || cols > 1) {
+            fprintf(report, "  map: %d rows and %d columns differ\n", rows, cols);
+        }
+    }
+
+    for (i = 0; i < GOLDEN_PART_COUNT; i++) {
+        if (stepHashes[HASH_PARTS + i] != golden[HASH_PARTS + i]) {
+            fprintf(report, "  %s differs\n", GoldenParts[i].name);
+        }
+    }
+    if (stepHashes[HASH_CENSUS] != golden[HASH_CENSUS]) {
+        fprintf(report, "  census counts differ\n");
+    }
+}
+
+/* Run one city and record or check its hashes. Returns 1 on success. */
+static int RunGoldenCity(const char *path, const char *name, int record, FILE *report) {
+    char goldenPath[MAX_PATH];
+    GoldenHeader header;
+    FILE *f;
+    int step;
+    int ok;
+
+    wsprintf(goldenPath, "%s\\%s\\%s.gld", progPathName, GOLDEN_DIR, name);
+
+    if (!record) {
+        f = fopen(goldenPath, "rb");
+        if (f == NULL) {
+            fprintf(report, "%s: no golden hashes, run /golden record first\n", name);
+            return 0;
+        }
+        ok = fread(&header, sizeof(header), 1, f) == 1 &&
+             memcmp(header.magic, GOLDEN_MAGIC, 4) == 0 && header.version == GOLDEN_VERSION &&
+             header.hashesPerStep == HASHES_PER_STEP && header.steps == GOLDEN_STEPS &&
+             header.seed == GOLDEN_SEED &&
+             fread(goldenHashes, sizeof(goldenHashes), 1, f) == 1;
+        fclose(f);
+        if (!ok) {
+            fprintf(report, "%s: golden hashes are from a different version\n", name);
+            return 0;
+        }
+    }
+
+    /* Every city starts over from the same game, so the cities run the same
+       in any order. The city-wide averages are not part of a save, but
+       loading an original city takes a census that reads them. */
+    TrafficAverage = 0;
+    PollutionAverage = 0;
+    CrimeAverage = 0;
+    LVAverage = 0;
+    if (!StartHeadlessCity(path, &startState)) {
+        fprintf(report, "%s: failed to load\n", name);
+        return 0;
+    }
+    RandomState = GOLDEN_SEED;
+
+    for (step = 0; step < GOLDEN_STEPS; step++) {
+        SimStep();
+        HashCity();
+
+        /* The tile planes must say what the map says after every step */
+        if (CheckTilePlanes() != 0) {
+            fprintf(report, "%s: step %d: tile planes differ from the map\n", name, step + 1);
+            return 0;
+        }
+
+        if (record) {
+            memcpy(goldenHashes[step], stepHashes, sizeof(stepHashes));
+        } else if (memcmp(goldenHashes[step], stepHashes, sizeof(stepHashes)) != 0) {
+            ReportDifference(report, name, step, goldenHashes[step]);
+            return 0;
+        }
+    }
+
+    if (!record) {
+        fprintf(report, "%s: ok\n", name);
+        return 1;
+    }
+
+    memcpy(header.magic, GOLDEN_MAGIC, 4);
+    header.version = GOLDEN_VERSION;
+    header.hashesPerStep = HASHES_PER_STEP;
+    header.steps = GOLDEN_STEPS;
+    header.seed = GOLDEN_SEED;
+
+    f = fopen(goldenPath, "wb");
+    ok = f != NULL && fwrite(&header, sizeof(header), 1, f) == 1 &&
+         fwrite(goldenHashes, sizeof(goldenHashes), 1, f) == 1;
+    if (f != NULL) {
+        fclose(f);
+    }
+    fprintf(report, "%s: %s\n", name, ok ? "recorded" : "failed to write golden hashes");
+    return ok;
+}
+
+/* Light a line of fire across a forest with no fire stations and run the
+ * simulation. Returns 1 if the fire reached tiles beside the line. */
+static int RunFireCheck(FILE *report) {
+    int x, y;
+    int x0, y0;
+    int step;
+    int caught;
+    short tile;
+
+    RestoreCityState(&startState);
+    for (y = 0; y < WORLD_Y; y++) {
+        for (x = 0; x < WORLD_X; x++) {
+            SetTile(x, y, WOODS | BULLBIT | BURNBIT);
+        }
+    }
+    RandomState = GOLDEN_SEED;
+
+    x0 = (WORLD_X - FIRE_CHECK_LENGTH) / 2;
+    y0 = WORLD_Y / 2;
+    for (x = x0; x < x0 + FIRE_CHECK_LENGTH; x++) {
+        SetTile(x, y0, FIRE + ANIMBIT);
+    }
+
+    for (step = 0; step < FIRE_CHECK_CYCLES * 16; step++) {
+        SimStep();
+    }
+
+    /* Count the tiles near the line, but not on it, that are burning or
+       have burnt out */
+    caught = 0;
+    for (y = y0 - FIRE_CHECK_CYCLES; y <= y0 + FIRE_CHECK_CYCLES; y++) {
+        for (x = x0 - FIRE_CHECK_CYCLES; x < x0 + FIRE_CHECK_LENGTH + FIRE_CHECK_CYCLES; x++) {
+            if (y == y0 && x >= x0 && x < x0 + FIRE_CHECK_LENGTH) {
+                continue;
+            }
+            tile = Map[y][x] & LOMASK;
+            if ((tile >= FIREBASE && tile <= LASTFIRE) || (tile >= RUBBLE && tile < RUBBLE + 4)) {
+                caught++;
+            }
+        }
+    }
+
+    if (caught == 0) {
+        fprintf(report, "fire spread: FAIL, no tile caught in %d cycles\n", FIRE_CHECK_CYCLES);
+        return 0;
+    }
+    fprintf(report, "fire spread: ok, %d tiles caught in %d cycles\n", caught, FIRE_CHECK_CYCLES);
+    return 1;
+}
+
+/* Run every city in the cities folder without windows, recording golden
+ * hashes or checking against them. Writes golden\golden.log. Returns 1 if
+ * every city passed. */
+int RunGoldenCheck(int record) {
+    char pattern[MAX_PATH];
+    char path[MAX_PATH];
+    char name[MAX_PATH];
+    char *dot;
+    WIN32_FIND_DATA fd;
+    HANDLE hFind;
+    FILE *report;
+    int cities;
+    int failed;
+
+    wsprintf(path, "%s\\%s", progPathName, GOLDEN_DIR);
+    CreateDirectory(path, NULL);
+
+    wsprintf(path, "%s\\%s\\golden.log", progPathName, GOLDEN_DIR);
+    report = fopen(path, "w");
+    if (report == NULL) {
+        return 0;
+    }
+
+    /* Nothing but the simulation itself may touch the city */
+    AutosaveEnabled = 0;
+    CaptureCityState(&startState);
+
+    cities = 0;
+    failed = 0;
+
+    wsprintf(pattern, "%s\\cities\\*.cty", progPathName);
+    hFind = FindFirstFile(pattern, &fd);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            wsprintf(path, "%s\\cities\\%s", progPathName, fd.cFileName);
+            lstrcpy(name, fd.cFileName);
+            dot = strrchr(name, '.');
+            if (dot) {
+                *dot = '\0';
+            }
+
+            cities++;
+            if (!RunGoldenCity(path, name, record, report)) {
+                failed++;
+            }
+        } while (FindNextFile(hFind, &fd));
+        FindClose(hFind);
+    }
+
+    if (!RunFireCheck(report)) {
+        failed++;
+    }
+
+    fprintf(report, "%d cities, %d steps each, %d failed\n", cities, GOLDEN_STEPS, failed);
+    fclose(report);
+
+    return cities > 0 && failed == 0;
+}
@@ -0,0 +1,311 @@
+/* heatmap.c - Overlay heatmap export for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * Writes the overlay maps the scanners build (population, traffic,
+ * pollution, land value, crime, police and fire coverage, commercial rate)
+ * so they can be studied outside the game. A raw stack is a HeatmapHeader,
+ * one HeatmapLayer per chosen overlay, then each overlay's memory exactly
+ * as the simulation holds it, written straight from the arrays. A PGM
+ * export writes one 8-bit greyscale image per overlay. Exports can be
+ * taken on demand or every few game months while the city runs.
+ *
+ * The quarter-size overlays are indexed [x][y] by the scanners, so their
+ * memory is column by column. A raw stack marks them HEATMAP_COLUMNS and
+ * leaves them as they are; a PGM export turns them the right way round.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External variables */
+extern char progPathName[MAX_PATH];
+
+#define HEATMAP_MAGIC "MNTH"
+#define HEATMAP_VERSION 1
+#define HEATMAP_DIR "heatmaps"
+
+/* HeatmapLayer flags */
+#define HEATMAP_COLUMNS 1        /* Memory holds columns of height cells */
+#define HEATMAP_SIGNED 2         /* Cells are signed */
+
+typedef struct {
+    const char *name;
+    const void *data;
+    int width;                   /* Cells across the map */
+    int height;                  /* Cells down the map */
+    int cellBytes;
+    int scale;                   /* Tiles per cell along each side */
+    int flags;
+} HeatmapSource;
+
+static const HeatmapSource HeatmapSources[HEATMAP_LAYERS] = {
+    { "population", PopDensity, WORLD_X / 2, WORLD_Y / 2, 1, 2, 0 },
+    { "traffic", TrfDensity, WORLD_X / 2, WORLD_Y / 2, 1, 2, 0 },
+    { "pollution", PollutionMem, WORLD_X / 2, WORLD_Y / 2, 1, 2, 0 },
+    { "landvalue", LandValueMem, WORLD_X / 2, WORLD_Y / 2, 1, 2, 0 },
+    { "crime", CrimeMem, WORLD_X / 2, WORLD_Y / 2, 1, 2, 0 },
+    { "police", PoliceMapEffect, WORLD_X / 4, WORLD_Y / 4, 1, 4, HEATMAP_COLUMNS },
+    { "fire", FireRate, WORLD_X / 4, WORLD_Y / 4, 1, 4, HEATMAP_COLUMNS },
+    { "comrate", ComRate, WORLD_X / 4, WORLD_Y / 4, sizeof(short), 4,
+      HEATMAP_COLUMNS | HEATMAP_SIGNED }
+};
+
+typedef struct {
+    char magic[4];               /* HEATMAP_MAGIC */
+    unsigned short version;      /* HEATMAP_VERSION */
+    unsigned short layers;       /* HeatmapLayer entries that follow */
+    long cityTime;               /* Month the overlays were taken */
+} HeatmapHeader;
+
+typedef struct {
+    char name[12];               /* NUL-padded overlay name */
+    unsigned short width;
+    unsigned short height;
+    unsigned char cellBytes;
+    unsigned char scale;
+    unsigned short flags;        /* HEATMAP_COLUMNS, HEATMAP_SIGNED */
+} HeatmapLayer;
+
+/* Overlays taken every few months while the city runs */
+static char seriesFolder[MAX_PATH];
+static unsigned int seriesLayers = 0;
+static int seriesFormat = HEATMAP_RAW;
+static int seriesMonths = 0;
+static int seriesCount = 0;
+
+static CityState batchStart;     /* The game as it was before a batch run */
+
+/* Write a block to a file. Returns 1 on success. */
+static int WriteBlock(HANDLE hFile, const void *data, DWORD size) {
+    DWORD written;
+
+    return WriteFile(hFile, data, size, &written, NULL) && written == size;
+}
+
+/* Write all the chosen overlays to one file after a header */
+static int WriteRawStack(const char *filename, unsigned int layers) {
+    HeatmapHeader header;
+    HeatmapLayer layer;
+    const HeatmapSource *src;
+    HANDLE hFile;
+    int count;
+    int ok;
+    int i;
+
+    count = 0;
+    for (i = 0; i < HEATMAP_LAYERS; i++) {
+        if (layers & (1 << i)) {
+            count++;
+        }
+    }
+
+    hFile = CreateFile(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    memcpy(header.magic, HEATMAP_MAGIC, 4);
+    header.version = HEATMAP_VERSION;
+    header.layers = (unsigned short)count;
+    header.cityTime = CityTime;
+    ok = WriteBlock(hFile, &header, sizeof(header));
+
+    for (i = 0; ok && i < HEATMAP_LAYERS; i++) {
+        if (!(layers & (1 << i))) {
+            continue;
+        }
+        src = &HeatmapSources[i];
+        memset(&layer, 0, sizeof(layer));
+        strncpy(layer.name, src->name, sizeof(layer.name));
+        layer.width = (unsigned short)src->width;
+        layer.height = (unsigned short)src->height;
+        layer.cellBytes = (unsigned char)src->cellBytes;
+        layer.scale = (unsigned char)src->scale;
+        layer.flags = (unsigned short)src->flags;
+        ok = WriteBlock(hFile, &layer, sizeof(layer));
+    }
+
+    for (i = 0; ok && i < HEATMAP_LAYERS; i++) {
+        if (layers & (1 << i)) {
+            src = &HeatmapSources[i];
+            ok = WriteBlock(hFile, src->data,
+                            (DWORD)(src->width * src->height * src->cellBytes));
+        }
+    }
+
+    CloseHandle(hFile);
+    return ok;
+}
+
+/* Write one overlay as an 8-bit greyscale PGM image */
+static int WritePGM(const char *filename, const HeatmapSource *src) {
+    Byte line[WORLD_X / 2];
+    char header[32];
+    HANDLE hFile;
+    int value;
+    int ok;
+    int x, y;
+
+    hFile = CreateFile(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    wsprintf(header, "P5\n%d %d\n255\n", src->width, src->height);
+    ok = WriteBlock(hFile, header, (DWORD)lstrlen(header));
+
+    if (!(src->flags & HEATMAP_COLUMNS) && src->cellBytes == 1) {
+        /* Already rows of bytes */
+        if (ok) {
+            ok = WriteBlock(hFile, src->data, (DWORD)(src->width * src->height));
+        }
+    } else {
+        for (y = 0; ok && y < src->height; y++) {
+            for (x = 0; x < src->width; x++) {
+                if (src->cellBytes == 1) {
+                    value = ((const Byte *)src->data)[x * src->height + y];
+                } else {
+                    value = ((const short *)src->data)[x * src->height + y];
+                }
+                line[x] = (Byte)(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+            ok = WriteBlock(hFile, line, (DWORD)src->width);
+        }
+    }
+
+    CloseHandle(hFile);
+    return ok;
+}
+
+/* Export overlays now. With HEATMAP_RAW the chosen layers go into one file;
+ * with HEATMAP_PGM each goes to <filename without extension>_<layer>.pgm.
+ * Caller must hold the simulation lock. Returns 1 on success. */
+int ExportHeatmaps(const char *filename, unsigned int layers, int format) {
+    char base[MAX_PATH];
+    char path[MAX_PATH];
+    char *dot;
+    int ok;
+    int i;
+
+    layers &= HEATMAP_ALL_LAYERS;
+    if (layers == 0) {
+        return 0;
+    }
+
+    if (format == HEATMAP_RAW) {
+        return WriteRawStack(filename, layers);
+    }
+
+    lstrcpyn(base, filename, MAX_PATH - 16);
+    dot = strrchr(base, '.');
+    if (dot && !strchr(dot, '\\')) {
+        *dot = '\0';
+    }
+
+    ok = 1;
+    for (i = 0; ok && i < HEATMAP_LAYERS; i++) {
+        if (layers & (1 << i)) {
+            wsprintf(path, "%s_%s.pgm", base, HeatmapSources[i].name);
+            ok = WritePGM(path, &HeatmapSources[i]);
+        }
+    }
+    return ok;
+}
+
+/* Export overlays into a folder every few game months, starting with the
+ * next month. Caller must hold the simulation lock. */
+int StartHeatmapSeries(const char *folder, unsigned int layers, int format, int months) {
+    StopHeatmapSeries();
+
+    if ((layers & HEATMAP_ALL_LAYERS) == 0 || months <= 0) {
+        return 0;
+    }
+
+    CreateDirectory(folder, NULL);
+    lstrcpyn(seriesFolder, folder, MAX_PATH - 16);
+    seriesLayers = layers & HEATMAP_ALL_LAYERS;
+    seriesFormat = format;
+    seriesMonths = months;
+    seriesCount = 0;
+    return 1;
+}
+
+/* Stop exporting overlays */
+void StopHeatmapSeries(void) {
+    if (seriesMonths > 0) {
+        addDebugLog("Heatmap series: %d exports to %s", seriesCount, seriesFolder);
+    }
+    seriesMonths = 0;
+}
+
+/* Called by the simulation at the start of each month */
+void RecordHeatmaps(void) {
+    char path[MAX_PATH];
+
+    if (seriesMonths <= 0 || CityTime % seriesMonths != 0) {
+        return;
+    }
+
+    wsprintf(path, "%s\\m%06d.%s", seriesFolder, CityTime,
+             seriesFormat == HEATMAP_RAW ? HEATMAP_EXTENSION : "pgm");
+    if (ExportHeatmaps(path, seriesLayers, seriesFormat)) {
+        seriesCount++;
+    } else {
+        addDebugLog("Heatmap export failed: %s", path);
+        StopHeatmapSeries();
+    }
+}
+
+/* Run a city for a number of game years without windows, writing a raw
+ * stack of every overlay each few months to heatmaps\<city>. Returns 1
+ * on success. */
+int RunHeatmapBatch(const char *filename, int years, int months) {
+    char folder[MAX_PATH];
+    const char *base;
+    const char *p;
+    char *dot;
+    long steps;
+    long i;
+    int ok;
+
+    base = filename;
+    for (p = filename; *p; p++) {
+        if (*p == '\\' || *p == '/' || *p == ':') {
+            base = p + 1;
+        }
+    }
+    wsprintf(folder, "%s\\%s", progPathName, HEATMAP_DIR);
+    CreateDirectory(folder, NULL);
+    wsprintf(folder, "%s\\%s\\%s", progPathName, HEATMAP_DIR, base);
+    dot = strrchr(folder, '.');
+    if (dot && dot > strrchr(folder, '\\')) {
+        *dot = '\0';
+    }
+
+    AutosaveEnabled = 0;
+    CaptureCityState(&batchStart);
+    if (!StartHeadlessCity(filename, &batchStart) ||
+        !StartHeatmapSeries(folder, HEATMAP_ALL_LAYERS, HEATMAP_RAW, months)) {
+        return 0;
+    }
+
+    steps = (long)years * 12L * 16L;
+    for (i = 0; i < steps && seriesMonths > 0; i++) {
+        SimStep();
+    }
+
+    /* A failed export stops the series */
+    ok = seriesMonths > 0 && seriesCount > 0;
+    StopHeatmapSeries();
+    return ok;
+}
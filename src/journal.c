@@ -0,0 +1,327 @@
+/* journal.c - Rewind journal for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * Once a game month the simulation records its state in the journal. Every
+ * JOURNAL_KEY_MONTHS months the entry is a keyframe, a packed copy of the
+ * whole city; in between it is a delta against the month before, holding
+ * only the bytes of the city state that changed. Rewinding to a month
+ * unpacks the keyframe at or before it and replays the deltas up to it.
+ * The oldest year is dropped when the journal exceeds its entry or memory
+ * limit.
+ *
+ * A delta is a sequence of (skip, length, bytes) records with skip and
+ * length stored as 7-bit variable-length integers, so the map tiles and
+ * scalars that did not change cost nothing.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* Keyframe interval and limits */
+#define JOURNAL_KEY_MONTHS 12                    /* One keyframe per game year */
+#define JOURNAL_YEARS 50                         /* Longest history kept */
+#define JOURNAL_MAX_ENTRIES (JOURNAL_YEARS * 12) /* One entry per month */
+#define JOURNAL_MAX_BYTES (32L * 1024L * 1024L)  /* Memory cap for entry data */
+
+/* Unchanged runs shorter than this are folded into the surrounding literal */
+#define DELTA_MIN_SKIP 8
+
+/* Largest delta: one record header per DELTA_MIN_SKIP bytes at worst */
+#define DELTA_BOUND (sizeof(CityState) + sizeof(CityState) / DELTA_MIN_SKIP + 16)
+
+typedef struct {
+    long cityTime;       /* Month the entry was recorded */
+    int keyframe;        /* 1 for a packed CityFile, 0 for a delta */
+    unsigned long size;  /* Bytes in data */
+    Byte *data;
+} JournalEntry;
+
+static JournalEntry Journal[JOURNAL_MAX_ENTRIES];
+static int journalHead = 0;      /* Oldest entry */
+static int journalCount = 0;
+static long journalBytes = 0;    /* Sum of entry sizes */
+static int monthsSinceKey = 0;
+
+/* Two state buffers: the last recorded month and the one being recorded */
+static CityState stateBuffers[2];
+static CityState *lastState = &stateBuffers[0];
+static CityState *curState = &stateBuffers[1];
+
+static CityFile journalFile;     /* Keyframe pack/unpack buffer */
+static Byte journalBuffer[PACKED_CITY_BOUND > DELTA_BOUND ? PACKED_CITY_BOUND : DELTA_BOUND];
+
+/* Index of the n-th oldest entry */
+#define JOURNAL_AT(n) (&Journal[(journalHead + (n)) % JOURNAL_MAX_ENTRIES])
+
+/* Write an unsigned value as a 7-bit variable-length integer */
+Byte *PutVarint(Byte *p, unsigned long v) {
+    while (v >= 0x80) {
+        *p++ = (Byte)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (Byte)v;
+    return p;
+}
+
+/* Read a 7-bit variable-length integer. Returns NULL past end. */
+const Byte *GetVarint(const Byte *p, const Byte *end, unsigned long *v) {
+    int shift;
+
+    *v = 0;
+    for (shift = 0; p < end && shift < 32; shift += 7) {
+        *v |= (unsigned long)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* Encode the bytes that differ between two states. Returns the delta size. */
+static unsigned long EncodeDelta(const CityState *from, const CityState *to, Byte *out) {
+    const Byte *a;
+    const Byte *b;
+    unsigned long size;
+    unsigned long pos;
+    unsigned long start;
+    unsigned long last;
+    unsigned long gap;
+    Byte *p;
+
+    a = (const Byte *)from;
+    b = (const Byte *)to;
+    size = sizeof(CityState);
+    p = out;
+    last = 0;
+    pos = 0;
+
+    while (pos < size) {
+        /* Find the next changed byte */
+        while (pos < size && a[pos] == b[pos]) {
+            pos++;
+        }
+        if (pos == size) {
+            break;
+        }
+
+        /* Extend the literal until DELTA_MIN_SKIP bytes in a row match */
+        start = pos;
+        gap = 0;
+        while (pos < size && gap < DELTA_MIN_SKIP) {
+            gap = (a[pos] == b[pos]) ? gap + 1 : 0;
+            pos++;
+        }
+        pos -= gap;
+
+        p = PutVarint(p, start - last);
+        p = PutVarint(p, pos - start);
+        memcpy(p, b + start, pos - start);
+        p += pos - start;
+        last = pos;
+    }
+
+    return (unsigned long)(p - out);
+}
+
+/* Apply a delta to a state. Returns 0 if the delta is damaged. */
+static int ApplyDelta(CityState *state, const Byte *data, unsigned long size) {
+    const Byte *p;
+    const Byte *end;
+    unsigned long pos;
+    unsigned long skip;
+    unsigned long len;
+
+    p = data;
+    end = data + size;
+    pos = 0;
+
+    while (p < end) {
+        p = GetVarint(p, end, &skip);
+        if (p == NULL) {
+            return 0;
+        }
+        p = GetVarint(p, end, &len);
+        if (p == NULL) {
+            return 0;
+        }
+
+        pos += skip;
+        if (pos + len > sizeof(CityState) || (unsigned long)(end - p) < len) {
+            return 0;
+        }
+
+        memcpy((Byte *)state + pos, p, len);
+        p += len;
+        pos += len;
+    }
+
+    return 1;
+}
+
+/* Pack a state as a keyframe into journalBuffer. Returns the size. */
+static unsigned long PackKeyframe(const CityState *state) {
+    memcpy(&journalFile.state, state, sizeof(CityState));
+    PrepareCityFile(&journalFile, 0);
+    return PackCityFile(&journalFile, journalBuffer, sizeof(journalBuffer));
+}
+
+/* Drop the newest entry */
+static void DropNewestEntry(void) {
+    JournalEntry *e;
+
+    e = JOURNAL_AT(journalCount - 1);
+    journalBytes -= (long)e->size;
+    free(e->data);
+    e->data = NULL;
+    journalCount--;
+}
+
+/* Drop the oldest keyframe and the deltas that depend on it */
+static void DropOldestYear(void) {
+    JournalEntry *e;
+
+    do {
+        e = JOURNAL_AT(0);
+        journalBytes -= (long)e->size;
+        free(e->data);
+        e->data = NULL;
+        journalHead = (journalHead + 1) % JOURNAL_MAX_ENTRIES;
+        journalCount--;
+    } while (journalCount > 0 && !JOURNAL_AT(0)->keyframe);
+}
+
+/* Discard the whole journal, e.g. when a different city is loaded */
+void ResetJournal(void) {
+    while (journalCount > 0) {
+        DropNewestEntry();
+    }
+    journalHead = 0;
+    journalBytes = 0;
+    monthsSinceKey = 0;
+}
+
+/* Record the current month. Called by the simulation at the start of each
+ * month, with the simulation lock held. */
+void RecordJournal(void) {
+    JournalEntry *e;
+    unsigned long size;
+    int keyframe;
+    CityState *swap;
+
+    CaptureCityState(curState);
+
+    /* Time went backwards: the city was replaced, so start over */
+    if (journalCount > 0 && JOURNAL_AT(journalCount - 1)->cityTime >= curState->cityTime) {
+        ResetJournal();
+    }
+
+    keyframe = journalCount == 0 || monthsSinceKey >= JOURNAL_KEY_MONTHS - 1;
+
+    if (keyframe) {
+        size = PackKeyframe(curState);
+    } else {
+        size = EncodeDelta(lastState, curState, journalBuffer);
+    }
+
+    /* Make room */
+    while (journalCount > 0 &&
+           (journalCount >= JOURNAL_MAX_ENTRIES || journalBytes + (long)size > JOURNAL_MAX_BYTES)) {
+        DropOldestYear();
+    }
+    if (journalCount == 0 && !keyframe) {
+        /* The only keyframe went; start again from this month */
+        keyframe = 1;
+        size = PackKeyframe(curState);
+    }
+
+    if (size == 0 && keyframe) {
+        addDebugLog("Journal: failed to pack keyframe");
+        return;
+    }
+
+    e = JOURNAL_AT(journalCount);
+    e->data = (Byte *)malloc(size > 0 ? size : 1);
+    if (e->data == NULL) {
+        addDebugLog("Journal: out of memory");
+        return;
+    }
+    memcpy(e->data, journalBuffer, size);
+    e->size = size;
+    e->cityTime = curState->cityTime;
+    e->keyframe = keyframe;
+
+    journalCount++;
+    journalBytes += (long)size;
+    monthsSinceKey = keyframe ? 0 : monthsSinceKey + 1;
+
+    swap = lastState;
+    lastState = curState;
+    curState = swap;
+}
+
+/* Get the first and last months held in the journal. Returns 0 if empty. */
+int GetJournalRange(long *first, long *last) {
+    if (journalCount == 0) {
+        return 0;
+    }
+    *first = JOURNAL_AT(0)->cityTime;
+    *last = JOURNAL_AT(journalCount - 1)->cityTime;
+    return 1;
+}
+
+/* Make the city as it was at the start of the given month the running
+ * city. Later months are discarded, so the game carries on from there.
+ * Caller must hold the simulation lock. Returns 0 if the month is not in
+ * the journal. */
+int RewindJournal(long cityTime) {
+    JournalEntry *e;
+    int target;
+    int key;
+    int i;
+
+    /* Find the month and the keyframe it is built on */
+    for (target = journalCount - 1; target >= 0; target--) {
+        if (JOURNAL_AT(target)->cityTime == cityTime) {
+            break;
+        }
+    }
+    if (target < 0) {
+        return 0;
+    }
+    for (key = target; key > 0 && !JOURNAL_AT(key)->keyframe; key--) {
+    }
+
+    e = JOURNAL_AT(key);
+    if (!UnpackCityFile(e->data, e->size, &journalFile)) {
+        addDebugLog("Journal: keyframe at month %ld is damaged", e->cityTime);
+        return 0;
+    }
+    for (i = key + 1; i <= target; i++) {
+        e = JOURNAL_AT(i);
+        if (!ApplyDelta(&journalFile.state, e->data, e->size)) {
+            addDebugLog("Journal: delta at month %ld is damaged", e->cityTime);
+            return 0;
+        }
+    }
+
+    RestoreCityState(&journalFile.state);
+
+    /* The rewound month is now the newest; record on from it */
+    while (journalCount > target + 1) {
+        DropNewestEntry();
+    }
+    memcpy(lastState, &journalFile.state, sizeof(CityState));
+    monthsSinceKey = target - key;
+
+    addDebugLog("Journal: rewound to month %ld using %d deltas, %ld KB held", cityTime,
+                target - key, journalBytes / 1024);
+    return 1;
+}
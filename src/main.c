@@ -15,12 +15,22 @@
 #define IDM_FILE_NEW 1001
 #define IDM_FILE_OPEN 1002
 #define IDM_FILE_EXIT 1003
+#define IDM_FILE_SAVE 1004
+#define IDM_FILE_AUTOSAVE 1005
+#define IDM_FILE_RECORD 1006
+#define IDM_FILE_STATS 1007
+#define IDM_FILE_HEATMAP 1008
 #define IDM_TILESET_BASE 2000
 #define IDM_TILESET_MAX 2100
 #define IDM_SIM_PAUSE 3001
 #define IDM_SIM_SLOW 3002
 #define IDM_SIM_MEDIUM 3003
 #define IDM_SIM_FAST 3004
+#define IDM_SIM_REWIND_MONTH 3005
+#define IDM_SIM_REWIND_YEAR 3006
+#define IDM_FUND_BASE 3100   /* + 10 * BUDGET_ROAD/POLICE/FIRE + level */
+#define IDM_FUND_LEVELS 5    /* 100%, 75%, 50%, 25%, 0% */
+#define IDM_FUND_MAX 3130
 
 /* Scenario menu IDs */
 #define IDM_SCENARIO_BASE 4000
@@ -38,6 +48,7 @@
 #define IDM_VIEW_LOGWINDOW 4101
 #define IDM_VIEW_POWER_OVERLAY 4102
 #define IDM_VIEW_DEBUG_LOGS 4103
+#define IDM_VIEW_MINIMAP 4104
 
 /* Info window definitions */
 #define INFO_WINDOW_CLASS "MicropolisInfoWindow"
@@ -54,6 +65,11 @@
 #define MAX_LOG_BUFFER 32000 /* Maximum size for the log text buffer */
 #define MAX_LOG_ENTRIES 100  /* Maximum number of log entries to keep */
 
+/* Overview map window definitions */
+#define MINIMAP_WINDOW_CLASS "MicropolisMiniMap"
+#define MINIMAP_WINDOW_WIDTH (WORLD_X * 2 + 16)  /* 2 pixels per tile plus frame */
+#define MINIMAP_WINDOW_HEIGHT (WORLD_Y * 2 + 40)
+
 /* Tool menu IDs */
 #define IDM_TOOL_BASE 5000
 #define IDM_TOOL_BULLDOZER 5001
@@ -94,6 +110,11 @@
 #define IMAGE_BITMAP 0
 #endif
 
+/* Missing from older headers; NT 3.x never sends it */
+#ifndef WM_CAPTURECHANGED
+#define WM_CAPTURECHANGED 0x0215
+#endif
+
 #define TILE_SIZE 16
 
 /* Main map and history arrays - now defined in simulation.h/c */
@@ -105,6 +126,15 @@ short CrimeHis[HISTLEN / 2];
 short PollutionHis[HISTLEN / 2];
 short MoneyHis[HISTLEN / 2];
 short MiscHis[MISCHISTLEN / 2];
+short ResLongHis[HISTLEN / 2];
+short ComLongHis[HISTLEN / 2];
+short IndLongHis[HISTLEN / 2];
+short CrimeLongHis[HISTLEN / 2];
+short PollutionLongHis[HISTLEN / 2];
+short MoneyLongHis[HISTLEN / 2];
+int HistoryHead = 0;
+int MiscHistoryHead = 0;
+int LongHistoryHead = 0;
 
 HWND hwndMain = NULL; /* Main window handle - used by other modules */
 HWND hwndInfo = NULL; /* Info window handle for displaying city stats */
@@ -121,6 +151,18 @@ static HBITMAP hbmTiles = NULL;
 static HDC hdcTiles = NULL;
 static HPALETTE hPalette = NULL;
 
+/* Tile layer of the map view, kept between paints so panning only has to
+   draw the strip of tiles that scrolls into view */
+static HBITMAP hbmMapCache = NULL;
+static HDC hdcMapCache = NULL;
+static int mapCacheWidth = 0;
+static int mapCacheHeight = 0;
+static int mapCacheValid = 0;
+static int mapCacheX = 0;       /* xOffset the cache was drawn at */
+static int mapCacheY = 0;       /* yOffset the cache was drawn at */
+static int mapCacheFrame = 0;   /* Traffic animation frame in the cache */
+static short mapCacheTiles[WORLD_Y][WORLD_X]; /* Tile values in the cache */
+
 static int cxClient = 0;
 static int cyClient = 0;
 static int xOffset = 0;
@@ -131,6 +173,14 @@ static BOOL isMouseDown = FALSE; /* Used for map dragging */
 static int lastMouseX = 0;
 static int lastMouseY = 0;
 
+/* Road, rail or wire stroke being dragged, in map coordinates */
+static BOOL isStroking = FALSE;
+static int strokeStartX = 0;
+static int strokeStartY = 0;
+static int strokeEndX = 0;
+static int strokeEndY = 0;
+static int strokeShape = STROKE_LINE;
+
 char progPathName[MAX_PATH];
 char cityFileName[MAX_PATH]; /* Current city filename - used by other modules */
 static HMENU hMenu = NULL;
@@ -139,8 +189,14 @@ static HMENU hTilesetMenu = NULL;
 static HMENU hSimMenu = NULL;
 static HMENU hScenarioMenu = NULL;
 static HMENU hToolMenu = NULL;
+static HMENU hBudgetMenu = NULL;
+static HMENU hFundMenus[3];     /* Levels for each BUDGET_ kind */
 static char currentTileset[MAX_PATH] = "classic";
 static int powerOverlayEnabled = 0; /* Power overlay display toggle */
+static int simThreaded = 0;         /* Simulation runs on its own thread */
+static long drawnSerial = -1;       /* Serial of the snapshot last drawn */
+static CRITICAL_SECTION logLock;    /* Guards logBuffer between threads */
+static volatile LONG logRefreshPosted = 0; /* WM_LOG_REFRESH in the queue */
 
 /* External reference to scenario variables (defined in scenarios.c) */
 extern short ScenarioID;    /* Current scenario ID (0 = none) */
@@ -281,10 +337,16 @@ int loadFile(char *filename);
 void drawCity(HDC hdc);
 void drawTile(HDC hdc, int x, int y, short tileValue);
 int getBaseFromTile(short tile);
-void swapShorts(short *buf, int len);
 void resizeBuffer(int cx, int cy);
+void resizeMapCache(int cx, int cy);
 void scrollView(int dx, int dy);
 void openCityDialog(HWND hwnd);
+void saveCityDialog(HWND hwnd);
+void rewindCity(HWND hwnd, int months);
+void recordSession(HWND hwnd);
+void recordStatistics(HWND hwnd);
+void exportOverlays(HWND hwnd);
+void discardRecording(void);
 int loadTileset(const char *filename);
 HPALETTE createSystemPalette(void);
 HMENU createMainMenu(void);
@@ -292,6 +354,13 @@ void populateTilesetMenu(HMENU hSubMenu);
 int changeTileset(HWND hwnd, const char *tilesetName);
 void ForceFullCensus(void);
 void createNewMap(HWND hwnd);
+void GetMapViewRect(RECT *rc);
+void CenterMapView(int tileX, int tileY);
+void InvalidateMapTiles(int left, int top, int right, int bottom);
+void invalidateStroke(void);
+void showToolResult(HWND hwnd, int result);
+void setFunding(int item);
+void updateFundingMenu(void);
 
 /* External functions - defined in simulation.c */
 extern int SimRandom(int range);
@@ -332,6 +401,28 @@ BOOL WINAPI MyPathRemoveFileSpecA(char* path)
 	return modified;
 }
 
+/* Read "years city.cty" from a batch command line. Returns 0 if either
+   is missing. */
+static int parseBatchArgs(const char *args, int *years, char *path) {
+    char *end;
+
+    *years = atoi(args);
+    args = strchr(args, ' ');
+    if (*years <= 0 || args == NULL) {
+        return 0;
+    }
+    args++;
+    if (*args == '"') {
+        args++;
+    }
+    lstrcpyn(path, args, MAX_PATH);
+    end = strchr(path, '"');
+    if (end) {
+        *end = '\0';
+    }
+    return *path != '\0';
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     WNDCLASS wc, wcInfo;
     MSG msg;
@@ -341,6 +432,82 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 	GetModuleFileName(NULL, progPathName, MAX_PATH);
 	MyPathRemoveFileSpecA(progPathName);
 
+    /* The log is written from both the UI and simulation threads */
+    InitializeCriticalSection(&logLock);
+
+    /* "/replay file.mnr" runs a recording without windows and exits with
+       0 if it reproduced the recorded city */
+    if (strncmp(lpCmdLine, "/replay ", 8) == 0) {
+        char replayPath[MAX_PATH];
+        char *end;
+
+        lpCmdLine += 8;
+        if (*lpCmdLine == '"') {
+            lpCmdLine++;
+        }
+        lstrcpyn(replayPath, lpCmdLine, MAX_PATH);
+        end = strchr(replayPath, '"');
+        if (end) {
+            *end = '\0';
+        }
+        return RunReplay(replayPath) ? 0 : 1;
+    }
+
+    /* "/golden record" stores the golden hashes for every city in the
+       cities folder; "/golden" checks a run against them */
+    if (strncmp(lpCmdLine, "/golden", 7) == 0) {
+        return RunGoldenCheck(strstr(lpCmdLine, "record") != NULL) ? 0 : 1;
+    }
+
+    /* "/bench" times each simulation kernel and writes bench.log */
+    if (strncmp(lpCmdLine, "/bench", 6) == 0) {
+        return RunBenchmarks() ? 0 : 1;
+    }
+
+    /* "/batch years city.cty" runs a city without windows and writes its
+       monthly statistics to city.mns */
+    if (strncmp(lpCmdLine, "/batch ", 7) == 0) {
+        char batchPath[MAX_PATH];
+        int years;
+
+        if (!parseBatchArgs(lpCmdLine + 7, &years, batchPath)) {
+            return 1;
+        }
+        return RunStatsBatch(batchPath, years) ? 0 : 1;
+    }
+
+    /* "/heatmaps months years city.cty" runs a city without windows and
+       writes every overlay each few months to heatmaps\city */
+    if (strncmp(lpCmdLine, "/heatmaps ", 10) == 0) {
+        char batchPath[MAX_PATH];
+        char *args;
+        int months;
+        int years;
+
+        months = atoi(lpCmdLine + 10);
+        args = strchr(lpCmdLine + 10, ' ');
+        if (months <= 0 || args == NULL || !parseBatchArgs(args + 1, &years, batchPath)) {
+            return 1;
+        }
+        return RunHeatmapBatch(batchPath, years, months) ? 0 : 1;
+    }
+
+    /* "/thumbs size years city.cty" runs a city without windows and draws
+       the map at size pixels per tile every year to thumbs\city */
+    if (strncmp(lpCmdLine, "/thumbs ", 8) == 0) {
+        char batchPath[MAX_PATH];
+        char *args;
+        int tileSize;
+        int years;
+
+        tileSize = atoi(lpCmdLine + 8);
+        args = strchr(lpCmdLine + 8, ' ');
+        if (tileSize <= 0 || args == NULL || !parseBatchArgs(args + 1, &years, batchPath)) {
+            return 1;
+        }
+        return RunThumbnailBatch(batchPath, years, tileSize) ? 0 : 1;
+    }
+
     /* Register main window class */
     //wc.cbSize = sizeof(WNDCLASS);
     wc.style = CS_HREDRAW | CS_VREDRAW | CS_BYTEALIGNWINDOW;
@@ -388,6 +555,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 0;
     }
 
+    /* Register overview map window class */
+    wcInfo.lpfnWndProc = miniMapWndProc;
+    wcInfo.lpszClassName = MINIMAP_WINDOW_CLASS;
+
+    if (!RegisterClass(&wcInfo)) {
+        MessageBox(NULL, "Minimap Window Registration Failed!", "Error", MB_ICONEXCLAMATION | MB_OK);
+        return 0;
+    }
+
     hMenu = createMainMenu();
 
     /* Create main window */
@@ -437,6 +613,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         /* Continue anyway, just without the log window */
     }
 
+    /* Create overview map window below the info window */
+    hwndMiniMap = CreateWindowEx(
+        WS_EX_CLIENTEDGE, MINIMAP_WINDOW_CLASS, "Micropolis Map",
+        WS_OVERLAPPEDWINDOW | WS_VISIBLE, mainWindowX + rect.right - rect.left + 10,
+        mainWindowY + INFO_WINDOW_HEIGHT + 10, MINIMAP_WINDOW_WIDTH, MINIMAP_WINDOW_HEIGHT, NULL,
+        NULL, hInstance, NULL);
+
+    if (hwndMiniMap == NULL) {
+        MessageBox(NULL, "Minimap Window Creation Failed!", "Error", MB_ICONEXCLAMATION | MB_OK);
+        /* Continue anyway, just without the overview */
+    }
+
     /* Initialize graphics first */
     initializeGraphics(hwndMain);
     
@@ -461,6 +649,29 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     return msg.wParam;
 }
 
+/**
+ * Copies the log buffer into the edit control and scrolls to the end.
+ * Must run on the UI thread.
+ */
+static void refreshLogText(void) {
+    int textLen;
+
+    if (!hwndLogText) {
+        return;
+    }
+
+    InterlockedExchange(&logRefreshPosted, 0);
+
+    EnterCriticalSection(&logLock);
+    SetWindowText(hwndLogText, logBuffer);
+    LeaveCriticalSection(&logLock);
+
+    /* Scroll to the bottom */
+    textLen = GetWindowTextLength(hwndLogText);
+    SendMessage(hwndLogText, EM_SETSEL, textLen, textLen);
+    SendMessage(hwndLogText, EM_SCROLLCARET, 0, 0);
+}
+
 /**
  * Adds an entry to the game log
  */
@@ -470,7 +681,6 @@ void addGameLog(const char *format, ...) {
     char timeBuffer[64];
     SYSTEMTIME st;
     int len;
-    int textLen;
 
     /* Only proceed if we have a text control */
     if (!hwndLogText) {
@@ -489,6 +699,8 @@ void addGameLog(const char *format, ...) {
     /* Add time prefix + message + newline to the log buffer */
     len = lstrlen(timeBuffer) + lstrlen(buffer) + 2; /* +2 for newline and null terminator */
 
+    EnterCriticalSection(&logLock);
+
     /* Check if we need to make room in the buffer */
     if (logBufferPos + len >= MAX_LOG_BUFFER) {
         /* Buffer is full, remove some old text */
@@ -520,13 +732,17 @@ void addGameLog(const char *format, ...) {
     logBuffer[logBufferPos++] = '\n';
     logBuffer[logBufferPos] = '\0';
 
-    /* Update the text control */
-    SetWindowText(hwndLogText, logBuffer);
+    LeaveCriticalSection(&logLock);
 
-    /* Scroll to the bottom */
-    textLen = GetWindowTextLength(hwndLogText);
-    SendMessage(hwndLogText, EM_SETSEL, textLen, textLen);
-    SendMessage(hwndLogText, EM_SCROLLCARET, 0, 0);
+    /* Update the text control. The simulation thread must not block on
+       the UI thread, so it leaves one refresh request in the queue. */
+    if (OnSimThread()) {
+        if (InterlockedExchange(&logRefreshPosted, 1) == 0) {
+            PostMessage(hwndLog, WM_LOG_REFRESH, 0, 0);
+        }
+    } else {
+        refreshLogText();
+    }
 }
 
 /**
@@ -628,6 +844,10 @@ LRESULT CALLBACK logWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         }
         return 0;
 
+    case WM_LOG_REFRESH:
+        refreshLogText();
+        return 0;
+
     case WM_DESTROY:
         hwndLogText = NULL;
         hwndLog = NULL;
@@ -794,6 +1014,9 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         CHECK_MENU_RADIO_ITEM(hTilesetMenu, 0, GetMenuItemCount(hTilesetMenu) - 1, 0, MF_BYPOSITION);
         /* Initialize simulation */
         DoSimInit();
+
+        /* Step the simulation on its own thread; fall back to the timer */
+        simThreaded = StartSimThread();
         return 0;
 
     case WM_COMMAND:
@@ -806,61 +1029,83 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             openCityDialog(hwnd);
             return 0;
 
+        case IDM_FILE_SAVE:
+            saveCityDialog(hwnd);
+            return 0;
+
+        case IDM_FILE_AUTOSAVE:
+            /* Read by the simulation thread at the start of each month */
+            AutosaveEnabled = AutosaveEnabled ? 0 : 1;
+            CheckMenuItem(hFileMenu, IDM_FILE_AUTOSAVE,
+                          MF_BYCOMMAND | (AutosaveEnabled ? MF_CHECKED : MF_UNCHECKED));
+            addGameLog(AutosaveEnabled ? "Autosave enabled" : "Autosave disabled");
+            return 0;
+
+        case IDM_FILE_RECORD:
+            recordSession(hwnd);
+            return 0;
+
+        case IDM_FILE_STATS:
+            recordStatistics(hwnd);
+            return 0;
+
+        case IDM_FILE_HEATMAP:
+            exportOverlays(hwnd);
+            return 0;
+
         case IDM_FILE_EXIT:
             PostMessage(hwnd, WM_CLOSE, 0, 0);
             return 0;
 
         case IDM_SIM_PAUSE:
+            LockSimulation();
             SetSimulationSpeed(hwnd, SPEED_PAUSED);
+            UnlockSimulation();
             addGameLog("Simulation paused");
             return 0;
 
         case IDM_SIM_SLOW:
+            LockSimulation();
             SetSimulationSpeed(hwnd, SPEED_SLOW);
+            UnlockSimulation();
             addGameLog("Simulation speed: Slow");
             return 0;
 
         case IDM_SIM_MEDIUM:
+            LockSimulation();
             SetSimulationSpeed(hwnd, SPEED_MEDIUM);
+            UnlockSimulation();
             addGameLog("Simulation speed: Medium");
             return 0;
 
         case IDM_SIM_FAST:
+            LockSimulation();
             SetSimulationSpeed(hwnd, SPEED_FAST);
+            UnlockSimulation();
             addGameLog("Simulation speed: Fast");
             return 0;
 
-        /* Scenario menu items */
-        case IDM_SCENARIO_DULLSVILLE:
-            loadScenario(1);
+        case IDM_SIM_REWIND_MONTH:
+            rewindCity(hwnd, 1);
             return 0;
 
-        case IDM_SCENARIO_SANFRANCISCO:
-            loadScenario(2);
+        case IDM_SIM_REWIND_YEAR:
+            rewindCity(hwnd, 12);
             return 0;
 
+        /* Scenario menu items */
+        case IDM_SCENARIO_DULLSVILLE:
+        case IDM_SCENARIO_SANFRANCISCO:
         case IDM_SCENARIO_HAMBURG:
-            loadScenario(3);
-            return 0;
-
         case IDM_SCENARIO_BERN:
-            loadScenario(4);
-            return 0;
-
         case IDM_SCENARIO_TOKYO:
-            loadScenario(5);
-            return 0;
-
         case IDM_SCENARIO_DETROIT:
-            loadScenario(6);
-            return 0;
-
         case IDM_SCENARIO_BOSTON:
-            loadScenario(7);
-            return 0;
-
         case IDM_SCENARIO_RIO:
-            loadScenario(8);
+            LockSimulation();
+            discardRecording();
+            loadScenario(LOWORD(wParam) - IDM_SCENARIO_BASE);
+            UnlockSimulation();
             return 0;
 
         /* View menu items */
@@ -905,6 +1150,25 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             }
             return 0;
 
+        case IDM_VIEW_MINIMAP:
+            if (hwndMiniMap) {
+                HMENU hMenu = GetMenu(hwnd);
+                HMENU hViewMenu = GetSubMenu(hMenu, 4); /* View is the 5th menu (0-based index) */
+                UINT state = GetMenuState(hViewMenu, IDM_VIEW_MINIMAP, MF_BYCOMMAND);
+
+                if (state & MF_CHECKED) {
+                    /* Hide overview window */
+                    CheckMenuItem(hViewMenu, IDM_VIEW_MINIMAP, MF_BYCOMMAND | MF_UNCHECKED);
+                    ShowWindow(hwndMiniMap, SW_HIDE);
+                } else {
+                    /* Show overview window */
+                    CheckMenuItem(hViewMenu, IDM_VIEW_MINIMAP, MF_BYCOMMAND | MF_CHECKED);
+                    ShowWindow(hwndMiniMap, SW_SHOW);
+                    SetFocus(hwnd); /* Keep focus on main window */
+                }
+            }
+            return 0;
+
         case IDM_VIEW_DEBUG_LOGS: {
             HMENU hMenu = GetMenu(hwnd);
             HMENU hViewMenu = GetSubMenu(hMenu, 4); /* View is the 5th menu (0-based index) */
@@ -1077,6 +1341,10 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
 
         default:
+            if (LOWORD(wParam) >= IDM_FUND_BASE && LOWORD(wParam) < IDM_FUND_MAX) {
+                setFunding(LOWORD(wParam) - IDM_FUND_BASE);
+                return 0;
+            }
             if (LOWORD(wParam) >= IDM_TILESET_BASE && LOWORD(wParam) < IDM_TILESET_MAX) {
                 int index;
                 char tilesetName[MAX_PATH];
@@ -1100,11 +1368,17 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         if (wParam == SIM_TIMER_ID) {
             BOOL needRedraw;
 
-            /* Run the simulation frame */
-            SimFrame();
-
-            /* Always redraw to handle animations, but skip if paused */
-            needRedraw = TRUE;
+            if (simThreaded) {
+                /* The simulation thread steps the city; only repaint once
+                   it has published a snapshot we have not drawn */
+                needRedraw = AcquireSnapshot()->serial != drawnSerial;
+            } else {
+                /* Run the simulation frame */
+                LockSimulation();
+                SimFrame();
+                UnlockSimulation();
+                needRedraw = TRUE;
+            }
 
             /* Update the display */
             if (needRedraw) {
@@ -1114,6 +1388,12 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         }
         break;
 
+    case WM_SIM_MESSAGE:
+        /* Message box raised on the simulation thread */
+        MessageBox(hwnd, (const char *)lParam, (const char *)wParam, MB_ICONEXCLAMATION | MB_OK);
+        free((void *)lParam);
+        return 0;
+
     case WM_QUERYNEWPALETTE: {
         /* Realize the palette when window gets focus */
         if (hPalette != NULL) {
@@ -1179,19 +1459,29 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
         }
 
-        if (isToolActive) {
+        if (isToolActive && IsStrokeTool(GetCurrentTool())) {
+            /* Start a stroke; it is built when the button is released */
+            ScreenToMap(xPos, yPos, &strokeStartX, &strokeStartY, xOffset, yOffset);
+            strokeEndX = strokeStartX;
+            strokeEndY = strokeStartY;
+            strokeShape = (wParam & MK_SHIFT) ? STROKE_RECT : STROKE_LINE;
+            isStroking = TRUE;
+            SetCapture(hwnd);
+        } else if (isToolActive) {
             /* Apply the tool at this position */
-            int result = HandleToolMouse(xPos, yPos, xOffset, yOffset);
-
-            /* Display result if needed */
-            if (result == TOOLRESULT_NO_MONEY) {
-                MessageBox(hwnd, "Not enough money!", "Tool Error", MB_ICONEXCLAMATION | MB_OK);
-            } else if (result == TOOLRESULT_NEED_BULLDOZE) {
-                MessageBox(hwnd, "You need to bulldoze this area first!", "Tool Error",
-                           MB_ICONEXCLAMATION | MB_OK);
-            } else if (result == TOOLRESULT_FAILED) {
-                MessageBox(hwnd, "Can't build there!", "Tool Error", MB_ICONEXCLAMATION | MB_OK);
+            int result;
+            const char *query;
+
+            LockSimulation();
+            result = HandleToolMouse(xPos, yPos, xOffset, yOffset);
+            query = TakeQueryText();
+            UnlockSimulation();
+
+            /* Answer queries only after the simulation is running again */
+            if (query != NULL) {
+                MessageBox(hwnd, query, "Zone Info", MB_OK | MB_ICONINFORMATION);
             }
+            showToolResult(hwnd, result);
         } else {
             /* Regular map dragging */
             isMouseDown = TRUE;
@@ -1227,6 +1517,20 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             }
 
             SetCursor(LoadCursor(NULL, IDC_SIZEALL));
+        } else if (isStroking) {
+            int shape = (wParam & MK_SHIFT) ? STROKE_RECT : STROKE_LINE;
+
+            ScreenToMap(xPos, yPos, &mapX, &mapY, xOffset, yOffset);
+
+            /* Redraw the stroke preview only when its path changes, over the
+               boxes of the old path and the new one */
+            if (mapX != strokeEndX || mapY != strokeEndY || shape != strokeShape) {
+                invalidateStroke();
+                strokeEndX = mapX;
+                strokeEndY = mapY;
+                strokeShape = shape;
+                invalidateStroke();
+            }
         } else if (isToolActive) {
             /* Convert mouse position to map coordinates for tool hover */
             ScreenToMap(xPos, yPos, &mapX, &mapY, xOffset, yOffset);
@@ -1250,6 +1554,27 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     }
 
     case WM_LBUTTONUP: {
+        if (isStroking) {
+            /* Build the whole stroke at once */
+            int result;
+
+            isStroking = FALSE;
+            ReleaseCapture();
+            strokeShape = (wParam & MK_SHIFT) ? STROKE_RECT : STROKE_LINE;
+
+            LockSimulation();
+            result = ApplyToolStroke(strokeStartX, strokeStartY, strokeEndX, strokeEndY,
+                                     strokeShape);
+            UnlockSimulation();
+
+            /* A stroke that built nothing still has its preview to clear */
+            if (result != TOOLRESULT_OK) {
+                invalidateStroke();
+            }
+            showToolResult(hwnd, result);
+            return 0;
+        }
+
         isMouseDown = FALSE;
         ReleaseCapture();
 
@@ -1258,6 +1583,21 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         return 0;
     }
 
+    case WM_INITMENUPOPUP:
+        /* The funding may have changed with a loaded city or the budget */
+        if ((HMENU)wParam == hBudgetMenu) {
+            updateFundingMenu();
+        }
+        break;
+
+    case WM_CAPTURECHANGED:
+        /* Another window took the mouse mid-stroke: drop the stroke */
+        if (isStroking) {
+            isStroking = FALSE;
+            invalidateStroke();
+        }
+        return 0;
+
     case WM_RBUTTONDOWN: {
         int xPos = LOWORD(lParam);
         int yPos = HIWORD(lParam);
@@ -1394,14 +1734,6 @@ LRESULT CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     }
 }
 
-void swapShorts(short *buf, int len) {
-    int i;
-
-    for (i = 0; i < len; i++) {
-        buf[i] = ((buf[i] & 0xFF) << 8) | ((buf[i] & 0xFF00) >> 8);
-    }
-}
-
 HPALETTE createSystemPalette(void) {
     LOGPALETTE *pLogPal;
     HPALETTE hPal;
@@ -1608,6 +1940,8 @@ void initializeGraphics(HWND hwnd) {
     /* Fill with black background */
     FillRect(hdcBuffer, &rect, (HBRUSH)GetStockObject(BLACK_BRUSH));
 
+    resizeMapCache(width, height);
+
     /* Use default.bmp tileset by default */
     strcpy(currentTileset, "default");
     wsprintf(tilePath, "%s\\tilesets\\%s.bmp", progPathName, currentTileset);
@@ -1674,6 +2008,10 @@ wsprintf(debugMsg, "Tileset Info: %dx%d, %d bits/pixel", bm.bmWidth, bm.bmHeight
         }
     }
 
+    /* Derive the overview colours before the bitmap is selected into a DC */
+    BuildTileColors(hbmTiles);
+    mapCacheValid = 0;
+
     hdc = GetDC(hwndMain);
     hdcTiles = CreateCompatibleDC(hdc);
 
@@ -1754,6 +2092,10 @@ int changeTileset(HWND hwnd, const char *tilesetName) {
         OutputDebugString(debugMsg);
     }
 
+    /* Derive the overview colours before the bitmap is selected into a DC */
+    BuildTileColors(hbmTiles);
+    mapCacheValid = 0;
+
     hdc = GetDC(hwndMain);
     hdcTiles = CreateCompatibleDC(hdc);
 
@@ -1796,6 +2138,16 @@ void cleanupGraphics(void) {
         hdcBuffer = NULL;
     }
 
+    if (hbmMapCache) {
+        DeleteObject(hbmMapCache);
+        hbmMapCache = NULL;
+    }
+
+    if (hdcMapCache) {
+        DeleteDC(hdcMapCache);
+        hdcMapCache = NULL;
+    }
+
     if (hbmTiles) {
         DeleteObject(hbmTiles);
         hbmTiles = NULL;
@@ -1894,13 +2246,55 @@ void resizeBuffer(int cx, int cy) {
 
     ReleaseDC(hwndMain, hdc);
 
+    resizeMapCache(cx, cy);
+
     InvalidateRect(hwndMain, NULL, FALSE);
 }
 
+/* (Re)create the tile layer cache to match the drawing buffer */
+void resizeMapCache(int cx, int cy) {
+    HBITMAP hbmNew;
+
+    mapCacheValid = 0;
+
+    if (cx <= 0 || cy <= 0 || hdcBuffer == NULL) {
+        return;
+    }
+
+    if (hdcMapCache == NULL) {
+        hdcMapCache = CreateCompatibleDC(hdcBuffer);
+        if (hdcMapCache == NULL) {
+            return;
+        }
+    }
+
+    /* Compatible with the buffer's DIB, so blits between them are plain copies */
+    hbmNew = CreateCompatibleBitmap(hdcBuffer, cx, cy);
+    if (hbmNew == NULL) {
+        OutputDebugString("Failed to create map cache bitmap\n");
+        return;
+    }
+
+    SelectObject(hdcMapCache, hbmNew);
+    if (hbmMapCache) {
+        DeleteObject(hbmMapCache);
+    }
+    hbmMapCache = hbmNew;
+    mapCacheWidth = cx;
+    mapCacheHeight = cy;
+
+    if (hPalette) {
+        SelectPalette(hdcMapCache, hPalette, FALSE);
+        RealizePalette(hdcMapCache);
+    }
+}
+
 void scrollView(int dx, int dy) {
     RECT rcClient;
     RECT updateRect;
     HRGN hRgn;
+    int oldX = xOffset;
+    int oldY = yOffset;
 
     /* Adjust offsets */
     xOffset += dx;
@@ -1921,7 +2315,13 @@ void scrollView(int dx, int dy) {
         yOffset = WORLD_Y * TILE_SIZE - cyClient;
     }
 
-    /* Get client area without toolbar */
+    /* Nothing to repaint when already against the edge */
+    if (xOffset == oldX && yOffset == oldY) {
+        return;
+    }
+
+    /* Get client area without toolbar. The tile layer is shifted by the
+       delta when painted, so only the newly exposed tiles are drawn. */
     GetClientRect(hwndMain, &rcClient);
     rcClient.left = toolbarWidth; /* Skip toolbar area */
 
@@ -1933,94 +2333,85 @@ void scrollView(int dx, int dy) {
     DeleteObject(hRgn);
 }
 
-/* Internal function to load file data */
-int loadFile(char *filename) {
-    FILE *f;
-    DWORD size;
-    size_t readResult;
+/* Report the part of the map shown in the main window, in tile coordinates */
+void GetMapViewRect(RECT *rc) {
+    rc->left = xOffset / TILE_SIZE;
+    rc->top = yOffset / TILE_SIZE;
+    rc->right = (xOffset + cxClient - toolbarWidth + TILE_SIZE - 1) / TILE_SIZE;
+    rc->bottom = (yOffset + cyClient + TILE_SIZE - 1) / TILE_SIZE;
 
-    f = fopen(filename, "rb");
-    if (f == NULL) {
-        return 0;
+    if (rc->right > WORLD_X) {
+        rc->right = WORLD_X;
+    }
+    if (rc->bottom > WORLD_Y) {
+        rc->bottom = WORLD_Y;
     }
+}
 
-    fseek(f, 0L, SEEK_END);
-    size = ftell(f);
-    fseek(f, 0L, SEEK_SET);
+/* Repaint a box of map tiles in the main window, corners included, with
+   room either side for the pen of an outline drawn on the box edges */
+void InvalidateMapTiles(int left, int top, int right, int bottom) {
+    RECT rc;
 
-    /* The original Micropolis city files are 27120 bytes */
-    if (size != 27120) {
-        fclose(f);
-        return 0;
-    }
+    rc.left = left * TILE_SIZE - xOffset + toolbarWidth;
+    rc.top = top * TILE_SIZE - yOffset;
+    rc.right = (right + 1) * TILE_SIZE - xOffset + toolbarWidth;
+    rc.bottom = (bottom + 1) * TILE_SIZE - yOffset;
+    InflateRect(&rc, 2, 2);
 
-    readResult = fread(ResHis, sizeof(short), HISTLEN / 2, f);
-    if (readResult != HISTLEN / 2) {
-        goto read_error;
+    /* Keep the toolbar out of it */
+    if (rc.left < toolbarWidth) {
+        rc.left = toolbarWidth;
     }
-    swapShorts(ResHis, HISTLEN / 2);
-
-    readResult = fread(ComHis, sizeof(short), HISTLEN / 2, f);
-    if (readResult != HISTLEN / 2) {
-        goto read_error;
+    if (rc.right > rc.left && rc.bottom > rc.top) {
+        InvalidateRect(hwndMain, &rc, FALSE);
     }
-    swapShorts(ComHis, HISTLEN / 2);
+}
 
-    readResult = fread(IndHis, sizeof(short), HISTLEN / 2, f);
-    if (readResult != HISTLEN / 2) {
-        goto read_error;
-    }
-    swapShorts(IndHis, HISTLEN / 2);
+/* Repaint the tiles the stroke preview covers */
+void invalidateStroke(void) {
+    InvalidateMapTiles(strokeStartX < strokeEndX ? strokeStartX : strokeEndX,
+                       strokeStartY < strokeEndY ? strokeStartY : strokeEndY,
+                       strokeStartX < strokeEndX ? strokeEndX : strokeStartX,
+                       strokeStartY < strokeEndY ? strokeEndY : strokeStartY);
+}
 
-    readResult = fread(CrimeHis, sizeof(short), HISTLEN / 2, f);
-    if (readResult != HISTLEN / 2) {
-        goto read_error;
-    }
-    swapShorts(CrimeHis, HISTLEN / 2);
+/* Scroll the main window so the given tile is in the middle of the view */
+void CenterMapView(int tileX, int tileY) {
+    int newX = tileX * TILE_SIZE - (cxClient - toolbarWidth) / 2;
+    int newY = tileY * TILE_SIZE - cyClient / 2;
 
-    readResult = fread(PollutionHis, sizeof(short), HISTLEN / 2, f);
-    if (readResult != HISTLEN / 2) {
-        goto read_error;
-    }
-    swapShorts(PollutionHis, HISTLEN / 2);
+    /* scrollView clamps the offsets and repaints the map area */
+    scrollView(newX - xOffset, newY - yOffset);
+}
 
-    readResult = fread(MoneyHis, sizeof(short), HISTLEN / 2, f);
-    if (readResult != HISTLEN / 2) {
-        goto read_error;
+/* Internal function to load file data */
+int loadFile(char *filename) {
+    MappedFile mf;
+    const CityFile *file;
+    int fileType;
+
+    /* Native saves are viewed in place; original city files come from a
+       cached native copy, converted on first use */
+    file = OpenCityView(filename, &mf);
+    if (file == NULL) {
+        return 0;
     }
-    swapShorts(MoneyHis, HISTLEN / 2);
 
-    readResult = fread(MiscHis, sizeof(short), MISCHISTLEN / 2, f);
-    if (readResult != MISCHISTLEN / 2) {
-        goto read_error;
+    if (file->header.flags & SAVE_FLAG_IMPORTED) {
+        RestoreImportedCity(&file->state);
+        fileType = CITYFILE_LEGACY;
+    } else {
+        RestoreCityState(&file->state);
+        fileType = CITYFILE_NATIVE;
     }
-    swapShorts(MiscHis, MISCHISTLEN / 2);
-
-    /* Original Micropolis stores map transposed compared to our array convention */
-    {
-        short tmpMap[WORLD_X][WORLD_Y];
-        int x, y;
-
-        readResult = fread(&tmpMap[0][0], sizeof(short), WORLD_X * WORLD_Y, f);
-        if (readResult != WORLD_X * WORLD_Y) {
-            goto read_error;
-        }
 
-        swapShorts((short *)tmpMap, WORLD_X * WORLD_Y);
+    UnmapCityFile(&mf);
 
-        for (x = 0; x < WORLD_X; x++) {
-            for (y = 0; y < WORLD_Y; y++) {
-                Map[y][x] = tmpMap[x][y];
-            }
-        }
-    }
+    /* Months recorded for the previous city no longer apply */
+    ResetJournal();
 
-    fclose(f);
-    return 1;
-
-read_error:
-    fclose(f);
-    return 0;
+    return fileType;
 }
 
 /* External function declarations */
@@ -2148,6 +2539,7 @@ int loadCity(char *filename) {
     int oldComPop;
     int oldIndPop;
     QUAD oldCityPop;
+    int fileType;
 
     /* Initialize variables at the top of function for C89 compliance */
     oldResPop = ResPop;
@@ -2155,6 +2547,10 @@ int loadCity(char *filename) {
     oldIndPop = IndPop;
     oldCityPop = CityPop;
 
+    /* Hold the simulation thread off while the city is replaced */
+    LockSimulation();
+    discardRecording();
+
     /* Reset scenario ID */
     ScenarioID = 0;
     DisasterEvent = 0;
@@ -2162,7 +2558,9 @@ int loadCity(char *filename) {
 
     lstrcpy(cityFileName, filename);
 
-    if (!loadFile(filename)) {
+    fileType = loadFile(filename);
+    if (!fileType) {
+        UnlockSimulation();
         MessageBox(hwndMain, "Failed to load city file", "Error", MB_ICONERROR | MB_OK);
         return 0;
     }
@@ -2176,45 +2574,55 @@ int loadCity(char *filename) {
         yOffset = 0;
     }
 
-    /* First run a full census to calculate initial city population */
-    ForceFullCensus();
+    /* Native saves restore the full simulation state; only the original
+       city files need the census and a fresh simulation start */
+    if (fileType == CITYFILE_LEGACY) {
+        /* First run a full census to calculate initial city population */
+        ForceFullCensus();
+
+        /* Check if we got a valid population */
+        if (CityPop == 0 && (oldCityPop > 0)) {
+            /* If no population detected, use values from previous city */
+            ResPop = oldResPop;
+            ComPop = oldComPop;
+            IndPop = oldIndPop;
+            TotalPop = (ResPop + ComPop + IndPop) * 8;
+            CityPop = oldCityPop;
+
+            /* Update city class based on restored population */
+            CityClass = 0; /* Village */
+            if (CityPop > 2000) {
+                CityClass++; /* Town */
+            }
+            if (CityPop > 10000) {
+                CityClass++; /* City */
+            }
+            if (CityPop > 50000) {
+                CityClass++; /* Capital */
+            }
+            if (CityPop > 100000) {
+                CityClass++; /* Metropolis */
+            }
+            if (CityPop > 500000) {
+                CityClass++; /* Megalopolis */
+            }
+        }
 
-    /* Check if we got a valid population */
-    if (CityPop == 0 && (oldCityPop > 0)) {
-        /* If no population detected, use values from previous city */
-        ResPop = oldResPop;
-        ComPop = oldComPop;
-        IndPop = oldIndPop;
-        TotalPop = (ResPop + ComPop + IndPop) * 8;
-        CityPop = oldCityPop;
+        /* Now we can initialize the simulation but preserve population */
+        DoSimInit();
 
-        /* Update city class based on restored population */
-        CityClass = 0; /* Village */
-        if (CityPop > 2000) {
-            CityClass++; /* Town */
-        }
-        if (CityPop > 10000) {
-            CityClass++; /* City */
-        }
-        if (CityPop > 50000) {
-            CityClass++; /* Capital */
-        }
-        if (CityPop > 100000) {
-            CityClass++; /* Metropolis */
-        }
-        if (CityPop > 500000) {
-            CityClass++; /* Megalopolis */
-        }
+        /* Force a final population census calculation for the loaded city */
+        ForceFullCensus();
     }
 
-    /* Now we can initialize the simulation but preserve population */
-    DoSimInit();
-
-    /* Force a final population census calculation for the loaded city */
-    ForceFullCensus();
+    UnlockSimulation();
 
-    /* Unpause simulation at medium speed */
-    SetSimulationSpeed(hwndMain, SPEED_MEDIUM);
+    /* Unpause simulation at medium speed, or resume a save at its own speed */
+    if (fileType == CITYFILE_NATIVE && SimSpeed != SPEED_PAUSED) {
+        SetSimulationSpeed(hwndMain, SimSpeed);
+    } else {
+        SetSimulationSpeed(hwndMain, SPEED_MEDIUM);
+    }
 
     /* Update the window title with city name */
     {
@@ -2269,6 +2677,37 @@ int loadCity(char *filename) {
     return 1;
 }
 
+/* Save the running city in the native format */
+int saveCity(char *filename) {
+    static CityFile saveFile; /* Too large for the stack */
+    char *baseName;
+
+    /* Take a consistent copy; the file is written without the lock held */
+    LockSimulation();
+    CaptureCityState(&saveFile.state);
+    UnlockSimulation();
+
+    PrepareCityFile(&saveFile, 0);
+
+    if (!WriteCityFile(filename, &saveFile)) {
+        MessageBox(hwndMain, "Failed to save city file", "Error", MB_ICONERROR | MB_OK);
+        return 0;
+    }
+
+    lstrcpy(cityFileName, filename);
+
+    baseName = cityFileName;
+    if (strrchr(baseName, '\\')) {
+        baseName = strrchr(baseName, '\\') + 1;
+    }
+    if (strrchr(baseName, '/')) {
+        baseName = strrchr(baseName, '/') + 1;
+    }
+
+    addGameLog("City saved: %s", baseName);
+    return 1;
+}
+
 int getBaseFromTile(short tile) {
     tile &= LOMASK;
 
@@ -2538,11 +2977,208 @@ void drawTile(HDC hdc, int x, int y, short tileValue) {
      */
 }
 
+/* Draw one map tile, and its power overlay if enabled, at its view position */
+static void drawMapTile(HDC hdc, const MapSnapshot *snap, int x, int y) {
+    int screenX;
+    int screenY;
+    short tile;
+
+    screenX = x * TILE_SIZE - xOffset;
+    screenY = y * TILE_SIZE - yOffset;
+
+    tile = snap->map[y][x];
+    drawTile(hdc, screenX, screenY, tile);
+
+    /* If power overlay is enabled, show power status with a transparent color overlay */
+    if (powerOverlayEnabled) {
+        RECT tileRect;
+        HBRUSH hOverlayBrush;
+
+        tileRect.left = screenX;
+        tileRect.top = screenY;
+        tileRect.right = screenX + TILE_SIZE;
+        tileRect.bottom = screenY + TILE_SIZE;
+
+        /* Skip power plants themselves */
+        if ((tile & LOMASK) != POWERPLANT && (tile & LOMASK) != NUCLEAR) {
+            /* Create overlay effect - use red for unpowered zones and green for powered */
+            if (tile & ZONEBIT) {
+                if (tile & POWERBIT) {
+                    /* Powered zones - bright green border */
+                    hOverlayBrush = CreateSolidBrush(RGB(0, 255, 0));
+                    /* Draw a thick green border for powered zones */
+                    FrameRect(hdc, &tileRect, hOverlayBrush);
+                    /* Add a small green power indicator in the corner */
+                    Rectangle(hdc, tileRect.left + 2, tileRect.top + 2, tileRect.left + 6,
+                              tileRect.top + 6);
+                    DeleteObject(hOverlayBrush);
+                } else {
+                    /* Unpowered zones - red overlay */
+                    hOverlayBrush = CreateSolidBrush(RGB(255, 0, 0));
+                    /* Draw a thick red border for unpowered zones */
+                    FrameRect(hdc, &tileRect, hOverlayBrush);
+                    /* Add an X in the corner to indicate no power */
+                    MoveToEx(hdc, tileRect.left + 2, tileRect.top + 2, NULL);
+                    LineTo(hdc, tileRect.left + 6, tileRect.top + 6);
+                    MoveToEx(hdc, tileRect.left + 6, tileRect.top + 2, NULL);
+                    LineTo(hdc, tileRect.left + 2, tileRect.top + 6);
+                    DeleteObject(hOverlayBrush);
+                }
+            } else if (PLANE_TEST(snap->powerMap, x, y)) {
+                /* Show power conducting elements (power lines, roads, etc.) clearly */
+                hOverlayBrush = CreateSolidBrush(RGB(0, 200, 0));
+                /* Show the power path with an overlay */
+                if ((tile & LOMASK) >= POWERBASE &&
+                    (tile & LOMASK) < POWERBASE + 12) {
+                    /* Power lines - make them bright */
+                    HPEN hPen = CreatePen(PS_SOLID, 1, RGB(0, 255, 0));
+                    HPEN hOldPen = SelectObject(hdc, hPen);
+                    /* Draw a cross through the tile to indicate power flow */
+                    MoveToEx(hdc, tileRect.left, tileRect.top, NULL);
+                    LineTo(hdc, tileRect.right, tileRect.bottom);
+                    MoveToEx(hdc, tileRect.right, tileRect.top, NULL);
+                    LineTo(hdc, tileRect.left, tileRect.bottom);
+                    SelectObject(hdc, hOldPen);
+                    DeleteObject(hPen);
+                } else {
+                    /* Other conductive tiles - highlight them */
+                    Rectangle(hdc, tileRect.left + (TILE_SIZE / 2) - 1,
+                              tileRect.top + (TILE_SIZE / 2) - 1,
+                              tileRect.left + (TILE_SIZE / 2) + 2,
+                              tileRect.top + (TILE_SIZE / 2) + 2);
+                }
+                DeleteObject(hOverlayBrush);
+            }
+        }
+
+        /* Mark power plants with a yellow circle */
+        if ((tile & LOMASK) == POWERPLANT || (tile & LOMASK) == NUCLEAR) {
+            HPEN hPen;
+            HPEN hOldPen;
+            HBRUSH hOldBrush;
+
+            hPen = CreatePen(PS_SOLID, 2, RGB(255, 255, 0));
+            hOldPen = SelectObject(hdc, hPen);
+            hOldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+
+            /* Draw a circle around the power plant */
+            Ellipse(hdc, screenX + 2, screenY + 2, screenX + TILE_SIZE - 2,
+                    screenY + TILE_SIZE - 2);
+
+            SelectObject(hdc, hOldPen);
+            SelectObject(hdc, hOldBrush);
+            DeleteObject(hPen);
+        }
+    }
+}
+
+/* Bring the tile layer cache up to date for the current view. When only the
+ * view offset changed, the cached pixels are shifted by the scroll delta and
+ * only tiles that scrolled into view or changed in the snapshot are drawn. */
+static void updateMapCache(const MapSnapshot *snap) {
+    int x, y;
+    int dx, dy;
+    int startX, startY, endX, endY;
+    int left, top;
+    int frame;
+    int full;
+    short tile;
+    RECT rc;
+
+    frame = Fcycle & 3;
+    dx = xOffset - mapCacheX;
+    dy = yOffset - mapCacheY;
+
+    /* The power overlay depends on more than the tile value; redraw it all */
+    full = !mapCacheValid || powerOverlayEnabled ||
+           dx >= mapCacheWidth || -dx >= mapCacheWidth ||
+           dy >= mapCacheHeight || -dy >= mapCacheHeight;
+
+    if (full) {
+        rc.left = 0;
+        rc.top = 0;
+        rc.right = mapCacheWidth;
+        rc.bottom = mapCacheHeight;
+        FillRect(hdcMapCache, &rc, (HBRUSH)GetStockObject(BLACK_BRUSH));
+    } else if (dx != 0 || dy != 0) {
+        /* Shift what is already drawn; GDI handles the overlapping copy */
+        BitBlt(hdcMapCache, -dx, -dy, mapCacheWidth, mapCacheHeight, hdcMapCache, 0, 0,
+               SRCCOPY);
+
+        /* Clear the exposed strips in case they fall outside the world */
+        rc.top = 0;
+        rc.bottom = mapCacheHeight;
+        if (dx > 0) {
+            rc.left = mapCacheWidth - dx;
+            rc.right = mapCacheWidth;
+            FillRect(hdcMapCache, &rc, (HBRUSH)GetStockObject(BLACK_BRUSH));
+        } else if (dx < 0) {
+            rc.left = 0;
+            rc.right = -dx;
+            FillRect(hdcMapCache, &rc, (HBRUSH)GetStockObject(BLACK_BRUSH));
+        }
+        rc.left = 0;
+        rc.right = mapCacheWidth;
+        if (dy > 0) {
+            rc.top = mapCacheHeight - dy;
+            rc.bottom = mapCacheHeight;
+            FillRect(hdcMapCache, &rc, (HBRUSH)GetStockObject(BLACK_BRUSH));
+        } else if (dy < 0) {
+            rc.top = 0;
+            rc.bottom = -dy;
+            FillRect(hdcMapCache, &rc, (HBRUSH)GetStockObject(BLACK_BRUSH));
+        }
+    }
+
+    /* Visible tile range */
+    startX = xOffset / TILE_SIZE;
+    startY = yOffset / TILE_SIZE;
+    endX = (xOffset + mapCacheWidth + TILE_SIZE - 1) / TILE_SIZE;
+    endY = (yOffset + mapCacheHeight + TILE_SIZE - 1) / TILE_SIZE;
+    if (startX < 0) {
+        startX = 0;
+    }
+    if (startY < 0) {
+        startY = 0;
+    }
+    if (endX > WORLD_X) {
+        endX = WORLD_X;
+    }
+    if (endY > WORLD_Y) {
+        endY = WORLD_Y;
+    }
+
+    for (y = startY; y < endY; y++) {
+        for (x = startX; x < endX; x++) {
+            tile = snap->map[y][x];
+
+            if (!full) {
+                /* Position of the tile when the cache was last drawn */
+                left = x * TILE_SIZE - mapCacheX;
+                top = y * TILE_SIZE - mapCacheY;
+
+                /* Keep tiles that were wholly in view and have not changed */
+                if (left >= 0 && top >= 0 && left + TILE_SIZE <= mapCacheWidth &&
+                    top + TILE_SIZE <= mapCacheHeight && mapCacheTiles[y][x] == tile &&
+                    (!(tile & ANIMBIT) || frame == mapCacheFrame)) {
+                    continue;
+                }
+            }
+
+            drawMapTile(hdcMapCache, snap, x, y);
+            mapCacheTiles[y][x] = tile;
+        }
+    }
+
+    mapCacheX = xOffset;
+    mapCacheY = yOffset;
+    mapCacheFrame = frame;
+    mapCacheValid = !powerOverlayEnabled; /* Overlay pixels must not be reused */
+}
+
 void drawCity(HDC hdc) {
     int x;
     int y;
-    int screenX;
-    int screenY;
     int startX;
     int startY;
     int endX;
@@ -2575,6 +3211,12 @@ void drawCity(HDC hdc) {
     char nameBuffer[MAX_PATH];
     char buffer[256];
     char *dot;
+    const MapSnapshot *snap;
+
+    /* Draw from the latest snapshot rather than the live map, which the
+       simulation thread may be changing */
+    snap = AcquireSnapshot();
+    drawnSerial = snap->serial;
 
     /* Copy simulation values to local variables for display */
     cityMonth = CityMonth;
@@ -2605,101 +3247,20 @@ void drawCity(HDC hdc) {
         endY = WORLD_Y;
     }
 
-    /* Clear the background */
-    rcClient.left = 0;
-    rcClient.top = 0;
-    rcClient.right = cxClient;
-    rcClient.bottom = cyClient;
-    FillRect(hdc, &rcClient, (HBRUSH)GetStockObject(BLACK_BRUSH));
-
-    /* Draw the map tiles */
-    for (y = startY; y < endY; y++) {
-        for (x = startX; x < endX; x++) {
-            screenX = x * TILE_SIZE - xOffset;
-            screenY = y * TILE_SIZE - yOffset;
-
-            drawTile(hdc, screenX, screenY, Map[y][x]);
-
-            /* If power overlay is enabled, show power status with a transparent color overlay */
-            if (powerOverlayEnabled) {
-                RECT tileRect;
-                HBRUSH hOverlayBrush;
-
-                tileRect.left = screenX;
-                tileRect.top = screenY;
-                tileRect.right = screenX + TILE_SIZE;
-                tileRect.bottom = screenY + TILE_SIZE;
-
-                /* Skip power plants themselves */
-                if ((Map[y][x] & LOMASK) != POWERPLANT && (Map[y][x] & LOMASK) != NUCLEAR) {
-                    /* Create overlay effect - use red for unpowered zones and green for powered */
-                    if (Map[y][x] & ZONEBIT) {
-                        if (Map[y][x] & POWERBIT) {
-                            /* Powered zones - bright green border */
-                            hOverlayBrush = CreateSolidBrush(RGB(0, 255, 0));
-                            /* Draw a thick green border for powered zones */
-                            FrameRect(hdc, &tileRect, hOverlayBrush);
-                            /* Add a small green power indicator in the corner */
-                            Rectangle(hdc, tileRect.left + 2, tileRect.top + 2, tileRect.left + 6,
-                                      tileRect.top + 6);
-                            DeleteObject(hOverlayBrush);
-                        } else {
-                            /* Unpowered zones - red overlay */
-                            hOverlayBrush = CreateSolidBrush(RGB(255, 0, 0));
-                            /* Draw a thick red border for unpowered zones */
-                            FrameRect(hdc, &tileRect, hOverlayBrush);
-                            /* Add an X in the corner to indicate no power */
-                            MoveToEx(hdc, tileRect.left + 2, tileRect.top + 2, NULL);
-                            LineTo(hdc, tileRect.left + 6, tileRect.top + 6);
-                            MoveToEx(hdc, tileRect.left + 6, tileRect.top + 2, NULL);
-                            LineTo(hdc, tileRect.left + 2, tileRect.top + 6);
-                            DeleteObject(hOverlayBrush);
-                        }
-                    } else if (PowerMap[y][x] == 1) {
-                        /* Show power conducting elements (power lines, roads, etc.) clearly */
-                        hOverlayBrush = CreateSolidBrush(RGB(0, 200, 0));
-                        /* Show the power path with an overlay */
-                        if ((Map[y][x] & LOMASK) >= POWERBASE &&
-                            (Map[y][x] & LOMASK) < POWERBASE + 12) {
-                            /* Power lines - make them bright */
-                            HPEN hPen = CreatePen(PS_SOLID, 1, RGB(0, 255, 0));
-                            HPEN hOldPen = SelectObject(hdc, hPen);
-                            /* Draw a cross through the tile to indicate power flow */
-                            MoveToEx(hdc, tileRect.left, tileRect.top, NULL);
-                            LineTo(hdc, tileRect.right, tileRect.bottom);
-                            MoveToEx(hdc, tileRect.right, tileRect.top, NULL);
-                            LineTo(hdc, tileRect.left, tileRect.bottom);
-                            SelectObject(hdc, hOldPen);
-                            DeleteObject(hPen);
-                        } else {
-                            /* Other conductive tiles - highlight them */
-                            Rectangle(hdc, tileRect.left + (TILE_SIZE / 2) - 1,
-                                      tileRect.top + (TILE_SIZE / 2) - 1,
-                                      tileRect.left + (TILE_SIZE / 2) + 2,
-                                      tileRect.top + (TILE_SIZE / 2) + 2);
-                        }
-                        DeleteObject(hOverlayBrush);
-                    }
-                }
-
-                /* Mark power plants with a yellow circle */
-                if ((Map[y][x] & LOMASK) == POWERPLANT || (Map[y][x] & LOMASK) == NUCLEAR) {
-                    HPEN hPen;
-                    HPEN hOldPen;
-                    HBRUSH hOldBrush;
-
-                    hPen = CreatePen(PS_SOLID, 2, RGB(255, 255, 0));
-                    hOldPen = SelectObject(hdc, hPen);
-                    hOldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
-
-                    /* Draw a circle around the power plant */
-                    Ellipse(hdc, screenX + 2, screenY + 2, screenX + TILE_SIZE - 2,
-                            screenY + TILE_SIZE - 2);
-
-                    SelectObject(hdc, hOldPen);
-                    SelectObject(hdc, hOldBrush);
-                    DeleteObject(hPen);
-                }
+    /* Bring the tile layer up to date and copy it under the overlays */
+    if (hdcMapCache) {
+        updateMapCache(snap);
+        BitBlt(hdc, 0, 0, mapCacheWidth, mapCacheHeight, hdcMapCache, 0, 0, SRCCOPY);
+    } else {
+        rcClient.left = 0;
+        rcClient.top = 0;
+        rcClient.right = cxClient;
+        rcClient.bottom = cyClient;
+        FillRect(hdc, &rcClient, (HBRUSH)GetStockObject(BLACK_BRUSH));
+
+        for (y = startY; y < endY; y++) {
+            for (x = startX; x < endX; x++) {
+                drawMapTile(hdc, snap, x, y);
             }
         }
     }
@@ -2848,8 +3409,13 @@ void drawCity(HDC hdc) {
             /* Convert to map coordinates */
             ScreenToMap(mousePos.x, mousePos.y, &mapX, &mapY, xOffset, yOffset);
 
-            /* Draw the highlight box */
-            DrawToolHover(hdc, mapX, mapY, GetCurrentTool(), xOffset, yOffset);
+            /* Draw the stroke being dragged, or the highlight box */
+            if (isStroking) {
+                DrawToolStroke(hdc, strokeStartX, strokeStartY, strokeEndX, strokeEndY,
+                               strokeShape, xOffset, yOffset);
+            } else {
+                DrawToolHover(hdc, mapX, mapY, GetCurrentTool(), xOffset, yOffset);
+            }
         }
     }
 
@@ -2858,6 +3424,66 @@ void drawCity(HDC hdc) {
     SetTextColor(hdc, RGB(255, 255, 255));
 }
 
+/* Tell the player why a tool could not be used */
+void showToolResult(HWND hwnd, int result) {
+    if (result == TOOLRESULT_NO_MONEY) {
+        MessageBox(hwnd, "Not enough money!", "Tool Error", MB_ICONEXCLAMATION | MB_OK);
+    } else if (result == TOOLRESULT_NEED_BULLDOZE) {
+        MessageBox(hwnd, "You need to bulldoze this area first!", "Tool Error",
+                   MB_ICONEXCLAMATION | MB_OK);
+    } else if (result == TOOLRESULT_FAILED) {
+        MessageBox(hwnd, "Can't build there!", "Tool Error", MB_ICONEXCLAMATION | MB_OK);
+    }
+}
+
+/* Set a funding level from the Budget menu. The item is 10 * the
+   BUDGET_ kind plus the level, 0 being full funding. */
+void setFunding(int item) {
+    static const char *fundNames[3] = { "Road", "Police", "Fire" };
+    int kind = item / 10;
+    int level = item % 10;
+    float percent;
+
+    if (kind > BUDGET_FIRE || level >= IDM_FUND_LEVELS) {
+        return;
+    }
+    percent = (float)(IDM_FUND_LEVELS - 1 - level) / (float)(IDM_FUND_LEVELS - 1);
+
+    /* Through the setters, so that recordings replay the change */
+    LockSimulation();
+    if (kind == BUDGET_ROAD) {
+        SetRoadPercent(percent);
+    } else if (kind == BUDGET_POLICE) {
+        SetPolicePercent(percent);
+    } else {
+        SetFirePercent(percent);
+    }
+    UnlockSimulation();
+
+    addGameLog("%s funding set to %d%%", fundNames[kind], 100 - level * 25);
+    updateFundingMenu();
+}
+
+/* Check the funding level nearest to each current percentage */
+void updateFundingMenu(void) {
+    float percent[3];
+    int kind;
+    int level;
+
+    LockSimulation();
+    percent[BUDGET_ROAD] = RoadPercent;
+    percent[BUDGET_POLICE] = PolicePercent;
+    percent[BUDGET_FIRE] = FirePercent;
+    UnlockSimulation();
+
+    for (kind = BUDGET_ROAD; kind <= BUDGET_FIRE; kind++) {
+        level = (int)((1.0f - percent[kind]) * (IDM_FUND_LEVELS - 1) + 0.5f);
+        CHECK_MENU_RADIO_ITEM(hFundMenus[kind], IDM_FUND_BASE + kind * 10,
+                              IDM_FUND_BASE + kind * 10 + IDM_FUND_LEVELS - 1,
+                              IDM_FUND_BASE + kind * 10 + level, MF_BYCOMMAND);
+    }
+}
+
 void openCityDialog(HWND hwnd) {
     OPENFILENAME ofn;
     char szFileName[MAX_PATH];
@@ -2868,7 +3494,7 @@ void openCityDialog(HWND hwnd) {
 
     ofn.lStructSize = sizeof(ofn);
     ofn.hwndOwner = hwnd;
-    ofn.lpstrFilter = "City Files (*.cty)\0*.cty\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFilter = "City Files (*.cty;*.mnc)\0*.cty;*.mnc\0All Files (*.*)\0*.*\0";
     ofn.lpstrFile = szFileName;
     ofn.nMaxFile = MAX_PATH;
     ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_HIDEREADONLY;
@@ -2879,15 +3505,219 @@ void openCityDialog(HWND hwnd) {
     }
 }
 
+/* Go back the given number of months using the rewind journal */
+void rewindCity(HWND hwnd, int months) {
+    long first;
+    long last;
+    long target;
+    int rewound;
+
+    LockSimulation();
+
+    rewound = 0;
+    if (GetJournalRange(&first, &last)) {
+        target = last - months;
+        if (target < first) {
+            target = first;
+        }
+        RecordRewindCommand(target);
+        rewound = RewindJournal(target);
+    }
+
+    UnlockSimulation();
+
+    if (!rewound) {
+        addGameLog("Nothing to rewind to");
+        return;
+    }
+
+    addGameLog("Rewound to month %d of year %d", CityMonth + 1, CityYear);
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void saveCityDialog(HWND hwnd) {
+    OPENFILENAME ofn;
+    char szFileName[MAX_PATH];
+    char *dot;
+
+    /* Suggest the current city name with the native extension */
+    lstrcpy(szFileName, cityFileName);
+    dot = strrchr(szFileName, '.');
+    if (dot && !strchr(dot, '\\')) {
+        *dot = '\0';
+    }
+
+    ZeroMemory(&ofn, sizeof(ofn));
+
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFilter = "MicropolisNT Cities (*.mnc)\0*.mnc\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFile = szFileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_EXPLORER | OFN_OVERWRITEPROMPT | OFN_HIDEREADONLY;
+    ofn.lpstrDefExt = SAVE_EXTENSION;
+
+    if (GetSaveFileName(&ofn)) {
+        saveCity(szFileName);
+    }
+}
+
+/* Start recording, or stop and save the recording */
+void recordSession(HWND hwnd) {
+    OPENFILENAME ofn;
+    char szFileName[MAX_PATH];
+    int recorded;
+
+    if (!IsRecording()) {
+        LockSimulation();
+        RequestRecording();
+        UnlockSimulation();
+
+        CheckMenuItem(hFileMenu, IDM_FILE_RECORD, MF_BYCOMMAND | MF_CHECKED);
+        addGameLog("Recording starts next month");
+        return;
+    }
+
+    LockSimulation();
+    recorded = StopRecording();
+    UnlockSimulation();
+
+    CheckMenuItem(hFileMenu, IDM_FILE_RECORD, MF_BYCOMMAND | MF_UNCHECKED);
+    if (!recorded) {
+        addGameLog("Recording cancelled before it started");
+        return;
+    }
+
+    szFileName[0] = '\0';
+
+    ZeroMemory(&ofn, sizeof(ofn));
+
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFilter = "MicropolisNT Replays (*.mnr)\0*.mnr\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFile = szFileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_EXPLORER | OFN_OVERWRITEPROMPT | OFN_HIDEREADONLY;
+    ofn.lpstrDefExt = REPLAY_EXTENSION;
+
+    if (!GetSaveFileName(&ofn)) {
+        return;
+    }
+
+    if (WriteRecording(szFileName)) {
+        addGameLog("Recording saved: %s", szFileName);
+    } else {
+        MessageBox(hwnd, "Failed to save recording", "Error", MB_ICONERROR | MB_OK);
+    }
+}
+
+/* Start writing monthly statistics to a file, or close the file */
+void recordStatistics(HWND hwnd) {
+    OPENFILENAME ofn;
+    char szFileName[MAX_PATH];
+    int started;
+
+    if (IsRecordingStats()) {
+        LockSimulation();
+        StopStats();
+        UnlockSimulation();
+
+        CheckMenuItem(hFileMenu, IDM_FILE_STATS, MF_BYCOMMAND | MF_UNCHECKED);
+        addGameLog("Statistics file closed");
+        return;
+    }
+
+    szFileName[0] = '\0';
+
+    ZeroMemory(&ofn, sizeof(ofn));
+
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFilter = "MicropolisNT Statistics (*.mns)\0*.mns\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFile = szFileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_EXPLORER | OFN_OVERWRITEPROMPT | OFN_HIDEREADONLY;
+    ofn.lpstrDefExt = STATS_EXTENSION;
+
+    if (!GetSaveFileName(&ofn)) {
+        return;
+    }
+
+    LockSimulation();
+    started = StartStats(szFileName);
+    UnlockSimulation();
+
+    if (!started) {
+        MessageBox(hwnd, "Failed to create statistics file", "Error", MB_ICONERROR | MB_OK);
+        return;
+    }
+
+    CheckMenuItem(hFileMenu, IDM_FILE_STATS, MF_BYCOMMAND | MF_CHECKED);
+    addGameLog("Recording statistics: %s", szFileName);
+}
+
+/* Write the overlay maps as they are now, as one raw stack or as PGM images */
+void exportOverlays(HWND hwnd) {
+    OPENFILENAME ofn;
+    char szFileName[MAX_PATH];
+    int ok;
+
+    szFileName[0] = '\0';
+
+    ZeroMemory(&ofn, sizeof(ofn));
+
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFilter = "Overlay Stack (*.mnh)\0*.mnh\0PGM Images (*.pgm)\0*.pgm\0";
+    ofn.lpstrFile = szFileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_EXPLORER | OFN_OVERWRITEPROMPT | OFN_HIDEREADONLY;
+    ofn.lpstrDefExt = HEATMAP_EXTENSION;
+
+    if (!GetSaveFileName(&ofn)) {
+        return;
+    }
+
+    LockSimulation();
+    ok = ExportHeatmaps(szFileName, HEATMAP_ALL_LAYERS,
+                        ofn.nFilterIndex == 2 ? HEATMAP_PGM : HEATMAP_RAW);
+    UnlockSimulation();
+
+    if (!ok) {
+        MessageBox(hwnd, "Failed to export overlays", "Error", MB_ICONERROR | MB_OK);
+        return;
+    }
+
+    addGameLog("Overlays exported: %s", szFileName);
+}
+
+/* A recording cannot span a change of city. Caller must hold the
+ * simulation lock. */
+void discardRecording(void) {
+    if (IsRecording()) {
+        CancelRecording();
+        CheckMenuItem(hFileMenu, IDM_FILE_RECORD, MF_BYCOMMAND | MF_UNCHECKED);
+        addGameLog("Recording discarded: city replaced");
+    }
+}
+
 HMENU createMainMenu(void) {
     HMENU hMainMenu;
     HMENU hViewMenu;
+    char label[16];
+    int kind;
+    int level;
 
     hMainMenu = CreateMenu();
 
     hFileMenu = CreatePopupMenu();
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_NEW, "&New...");
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_OPEN, "&Open City...");
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_SAVE, "&Save City As...");
+    AppendMenu(hFileMenu, MF_STRING | MF_CHECKED, IDM_FILE_AUTOSAVE, "&Autosave Monthly");
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_RECORD, "&Record Session");
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_STATS, "Record S&tatistics...");
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_HEATMAP, "Export O&verlays...");
     AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_EXIT, "E&xit");
 
@@ -2899,10 +3729,26 @@ HMENU createMainMenu(void) {
     AppendMenu(hSimMenu, MF_STRING, IDM_SIM_SLOW, "&Slow");
     AppendMenu(hSimMenu, MF_STRING, IDM_SIM_MEDIUM, "&Medium");
     AppendMenu(hSimMenu, MF_STRING, IDM_SIM_FAST, "&Fast");
+    AppendMenu(hSimMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenu(hSimMenu, MF_STRING, IDM_SIM_REWIND_MONTH, "Rewind One &Month");
+    AppendMenu(hSimMenu, MF_STRING, IDM_SIM_REWIND_YEAR, "Rewind One &Year");
 
     /* Default simulation speed is medium */
     CHECK_MENU_RADIO_ITEM(hSimMenu, IDM_SIM_PAUSE, IDM_SIM_FAST, IDM_SIM_MEDIUM, MF_BYCOMMAND);
 
+    /* Funding levels for roads, police and fire */
+    hBudgetMenu = CreatePopupMenu();
+    for (kind = BUDGET_ROAD; kind <= BUDGET_FIRE; kind++) {
+        hFundMenus[kind] = CreatePopupMenu();
+        for (level = 0; level < IDM_FUND_LEVELS; level++) {
+            wsprintf(label, "&%d%%", 100 - level * 25);
+            AppendMenu(hFundMenus[kind], MF_STRING, IDM_FUND_BASE + kind * 10 + level, label);
+        }
+    }
+    AppendMenu(hBudgetMenu, MF_POPUP, (UINT)hFundMenus[BUDGET_ROAD], "&Roads");
+    AppendMenu(hBudgetMenu, MF_POPUP, (UINT)hFundMenus[BUDGET_POLICE], "&Police");
+    AppendMenu(hBudgetMenu, MF_POPUP, (UINT)hFundMenus[BUDGET_FIRE], "&Fire");
+
     /* Create scenario menu */
     hScenarioMenu = CreatePopupMenu();
     AppendMenu(hScenarioMenu, MF_STRING, IDM_SCENARIO_DULLSVILLE, "&Dullsville (1900): Boredom");
@@ -2964,6 +3810,9 @@ HMENU createMainMenu(void) {
     AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_LOGWINDOW, "&Log Window");
     /* Check it by default since the log window is now shown on startup */
     CheckMenuItem(hViewMenu, IDM_VIEW_LOGWINDOW, MF_CHECKED);
+    AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_MINIMAP, "&Map Overview");
+    /* Check it by default since the overview is shown on startup */
+    CheckMenuItem(hViewMenu, IDM_VIEW_MINIMAP, MF_CHECKED);
     AppendMenu(hViewMenu, MF_SEPARATOR, 0, NULL);
     AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_POWER_OVERLAY, "&Power Overlay");
     AppendMenu(hViewMenu, MF_SEPARATOR, 0, NULL);
@@ -2975,6 +3824,7 @@ HMENU createMainMenu(void) {
     AppendMenu(hMainMenu, MF_POPUP, (UINT)hScenarioMenu, "&Scenarios");
     AppendMenu(hMainMenu, MF_POPUP, (UINT)hTilesetMenu, "&Tileset");
     AppendMenu(hMainMenu, MF_POPUP, (UINT)hSimMenu, "&Speed");
+    AppendMenu(hMainMenu, MF_POPUP, (UINT)hBudgetMenu, "&Budget");
     AppendMenu(hMainMenu, MF_POPUP, (UINT)hViewMenu, "&View");
 
     return hMainMenu;
@@ -3036,10 +3886,14 @@ void createNewMap(HWND hwnd) {
     /* Update window title (override the tileset title) */
     SetWindowText(hwnd, "MicropolisNT - New City");
     
+    /* Hold the simulation thread off while the city is replaced */
+    LockSimulation();
+    discardRecording();
+
     /* Fill map with dirt */
     for (y = 0; y < WORLD_Y; y++) {
         for (x = 0; x < WORLD_X; x++) {
-            Map[y][x] = TILE_DIRT;
+            SetTile(x, y, TILE_DIRT);
         }
     }
     
@@ -3062,6 +3916,8 @@ void createNewMap(HWND hwnd) {
     
     /* Set demand valves to initial values */
     SetValves(500, 300, 100);
+
+    UnlockSimulation();
     
     /* Add logging */
     addGameLog("Created new empty city");
@@ -0,0 +1,429 @@
+/* minimap.c - Overview map window for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* Tileset geometry - must match main.c */
+#define TILE_SIZE 16
+#define TILES_IN_ROW 32
+
+/* Overview is drawn at 1 to 3 screen pixels per map tile */
+#define MINIMAP_MIN_SCALE 1
+#define MINIMAP_MAX_SCALE 3
+
+#define MINIMAP_TIMER_ID 3
+#define MINIMAP_TIMER_INTERVAL 250 /* Check for changed tiles every 250ms */
+
+/* View menu ID - must match main.c */
+#define IDM_VIEW_MINIMAP 4104
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External variables */
+extern HWND hwndMain;
+
+/* Main view helpers (main.c) */
+extern void GetMapViewRect(RECT *rc);
+extern void CenterMapView(int tileX, int tileY);
+
+HWND hwndMiniMap = NULL; /* Overview window handle */
+
+/* Average colour of every tile in the current tileset (0x00RRGGBB, DIB order) */
+static DWORD TileColors[TILE_COUNT];
+
+/* One pixel per tile, top-down 32-bit DIB, stretched to the window on paint */
+static DWORD MiniPixels[WORLD_Y][WORLD_X];
+
+/* Tile number last plotted at each position - used to find changed tiles */
+static short MiniShadow[WORLD_Y][WORLD_X];
+static int MiniShadowValid = 0;
+static long miniSerial = 0; /* Serial of the snapshot plotted last */
+
+/* Main view rectangle (in tiles) drawn last time */
+static RECT lastViewRect;
+
+static int miniScale = 2;
+static BOOL miniDragging = FALSE;
+
+/* Fallback colour for a tile when no tileset bitmap could be read */
+static DWORD DefaultTileColor(int tile) {
+    if (tile >= RIVER && tile <= LASTRIVEDGE) {
+        return 0x00000080; /* Dark blue */
+    }
+    if (tile >= TREEBASE && tile <= WOODS5) {
+        return 0x00008000; /* Dark green */
+    }
+    if (tile >= RUBBLE && tile <= LASTRUBBLE) {
+        return 0x00808000; /* Olive */
+    }
+    if (tile >= FLOOD && tile <= LASTFLOOD) {
+        return 0x000080FF; /* Light blue */
+    }
+    if (tile >= FIREBASE && tile <= LASTFIRE) {
+        return 0x00FF0000; /* Red */
+    }
+    if (tile >= ROADBASE && tile <= LASTROAD) {
+        return 0x00808080; /* Gray */
+    }
+    if (tile >= POWERBASE && tile <= LASTPOWER) {
+        return 0x00FFFF00; /* Yellow */
+    }
+    if (tile >= RAILBASE && tile <= LASTRAIL) {
+        return 0x00C0C0C0; /* Light gray */
+    }
+    if (tile >= RESBASE && tile <= LASTRES) {
+        return 0x0000FF00; /* Green */
+    }
+    if (tile >= COMBASE && tile <= LASTCOM) {
+        return 0x000000FF; /* Blue */
+    }
+    if (tile >= INDBASE && tile <= LASTIND) {
+        return 0x00FFFF00; /* Yellow */
+    }
+    if (tile >= PORTBASE) {
+        return 0x00A0A0A0; /* Special buildings */
+    }
+    return 0x00CC6600; /* Orange-brown dirt */
+}
+
+/* Build the per-tile average colour table from a freshly loaded tileset.
+ * Must be called before the bitmap is selected into a DC (GetDIBits requirement). */
+void BuildTileColors(HBITMAP hbmTileset) {
+    BITMAP bm;
+    BITMAPINFO bmi;
+    HDC hdc;
+    DWORD *bits;
+    DWORD pixel;
+    DWORD r, g, b;
+    int tile, px, py;
+    int srcX, srcY;
+    int tilesRead;
+
+    for (tile = 0; tile < TILE_COUNT; tile++) {
+        TileColors[tile] = DefaultTileColor(tile);
+    }
+
+    /* Force a full replot with the new colours */
+    MiniShadowValid = 0;
+
+    if (hbmTileset == NULL || !GetObject(hbmTileset, sizeof(BITMAP), &bm)) {
+        return;
+    }
+
+    bits = (DWORD *)malloc(bm.bmWidth * bm.bmHeight * sizeof(DWORD));
+    if (bits == NULL) {
+        return;
+    }
+
+    ZeroMemory(&bmi, sizeof(BITMAPINFO));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = bm.bmWidth;
+    bmi.bmiHeader.biHeight = -bm.bmHeight; /* Negative for top-down DIB */
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    hdc = GetDC(NULL);
+    if (!GetDIBits(hdc, hbmTileset, 0, bm.bmHeight, bits, &bmi, DIB_RGB_COLORS)) {
+        OutputDebugString("MINIMAP: Could not read tileset bits, using default colours\n");
+        ReleaseDC(NULL, hdc);
+        free(bits);
+        return;
+    }
+    ReleaseDC(NULL, hdc);
+
+    /* Average the 16x16 pixels of every tile present in the bitmap */
+    tilesRead = 0;
+    for (tile = 0; tile < TILE_COUNT; tile++) {
+        srcX = (tile % TILES_IN_ROW) * TILE_SIZE;
+        srcY = (tile / TILES_IN_ROW) * TILE_SIZE;
+
+        if (srcX + TILE_SIZE > bm.bmWidth || srcY + TILE_SIZE > bm.bmHeight) {
+            continue;
+        }
+
+        r = g = b = 0;
+        for (py = 0; py < TILE_SIZE; py++) {
+            for (px = 0; px < TILE_SIZE; px++) {
+                pixel = bits[(srcY + py) * bm.bmWidth + srcX + px];
+                b += pixel & 0xFF;
+                g += (pixel >> 8) & 0xFF;
+                r += (pixel >> 16) & 0xFF;
+            }
+        }
+
+        r /= TILE_SIZE * TILE_SIZE;
+        g /= TILE_SIZE * TILE_SIZE;
+        b /= TILE_SIZE * TILE_SIZE;
+        TileColors[tile] = (r << 16) | (g << 8) | b;
+        tilesRead++;
+    }
+
+    free(bits);
+
+    addDebugLog("Minimap colour table built from %d tiles", tilesRead);
+
+    if (hwndMiniMap) {
+        InvalidateRect(hwndMiniMap, NULL, FALSE);
+    }
+}
+
+/* Convert a rectangle in tiles to window pixels */
+static void TileRectToClient(const RECT *tiles, RECT *client) {
+    client->left = tiles->left * miniScale;
+    client->top = tiles->top * miniScale;
+    client->right = tiles->right * miniScale;
+    client->bottom = tiles->bottom * miniScale;
+}
+
+/* Plot every tile that changed since the last update and invalidate only
+ * the affected part of the window. Only chunks the snapshot copied after
+ * the last snapshot seen here are compared. */
+void UpdateMiniMap(void) {
+    int x, y;
+    int cx, cy;
+    int left, top, right, bottom;
+    short tile;
+    RECT dirty;
+    RECT view;
+    RECT rc;
+    int changed;
+    const MapSnapshot *snap;
+
+    if (hwndMiniMap == NULL || !IsWindowVisible(hwndMiniMap)) {
+        return;
+    }
+
+    snap = AcquireSnapshot();
+
+    dirty.left = WORLD_X;
+    dirty.top = WORLD_Y;
+    dirty.right = 0;
+    dirty.bottom = 0;
+    changed = 0;
+
+    for (cy = 0; cy < CHUNK_ROWS; cy++) {
+        top = cy * CHUNK_SIZE;
+        bottom = top + CHUNK_SIZE < WORLD_Y ? top + CHUNK_SIZE : WORLD_Y;
+
+        for (cx = 0; cx < CHUNK_COLS; cx++) {
+            if (MiniShadowValid && snap->chunkSerial[cy][cx] <= miniSerial) {
+                continue;
+            }
+
+            left = cx * CHUNK_SIZE;
+            right = left + CHUNK_SIZE < WORLD_X ? left + CHUNK_SIZE : WORLD_X;
+
+            for (y = top; y < bottom; y++) {
+                for (x = left; x < right; x++) {
+                    tile = snap->map[y][x] & LOMASK;
+
+                    if (MiniShadowValid && MiniShadow[y][x] == tile) {
+                        continue;
+                    }
+
+                    MiniShadow[y][x] = tile;
+                    MiniPixels[y][x] = (tile < TILE_COUNT) ? TileColors[tile] : 0;
+
+                    if (x < dirty.left) {
+                        dirty.left = x;
+                    }
+                    if (x >= dirty.right) {
+                        dirty.right = x + 1;
+                    }
+                    if (y < dirty.top) {
+                        dirty.top = y;
+                    }
+                    if (y >= dirty.bottom) {
+                        dirty.bottom = y + 1;
+                    }
+                    changed++;
+                }
+            }
+        }
+    }
+
+    MiniShadowValid = 1;
+    miniSerial = snap->serial;
+
+    if (changed) {
+        TileRectToClient(&dirty, &rc);
+        InvalidateRect(hwndMiniMap, &rc, FALSE);
+    }
+
+    /* Redraw the view frame if the main window scrolled */
+    GetMapViewRect(&view);
+    if (view.left != lastViewRect.left || view.top != lastViewRect.top ||
+        view.right != lastViewRect.right || view.bottom != lastViewRect.bottom) {
+        TileRectToClient(&lastViewRect, &rc);
+        InflateRect(&rc, 1, 1);
+        InvalidateRect(hwndMiniMap, &rc, FALSE);
+
+        TileRectToClient(&view, &rc);
+        InflateRect(&rc, 1, 1);
+        InvalidateRect(hwndMiniMap, &rc, FALSE);
+    }
+}
+
+/* Jump the main view to the tile under a window position */
+static void MiniMapJump(int xPos, int yPos) {
+    int tileX = xPos / miniScale;
+    int tileY = yPos / miniScale;
+
+    if (tileX < 0) {
+        tileX = 0;
+    }
+    if (tileY < 0) {
+        tileY = 0;
+    }
+    if (tileX >= WORLD_X) {
+        tileX = WORLD_X - 1;
+    }
+    if (tileY >= WORLD_Y) {
+        tileY = WORLD_Y - 1;
+    }
+
+    CenterMapView(tileX, tileY);
+    UpdateMiniMap();
+}
+
+/**
+ * Overview window procedure - handles messages for the minimap window
+ */
+LRESULT CALLBACK miniMapWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_CREATE:
+        MiniShadowValid = 0;
+        SetTimer(hwnd, MINIMAP_TIMER_ID, MINIMAP_TIMER_INTERVAL, NULL);
+        return 0;
+
+    case WM_SIZE: {
+        int sx = LOWORD(lParam) / WORLD_X;
+        int sy = HIWORD(lParam) / WORLD_Y;
+
+        /* Pick the largest whole scale that fits the client area */
+        miniScale = (sx < sy) ? sx : sy;
+        if (miniScale < MINIMAP_MIN_SCALE) {
+            miniScale = MINIMAP_MIN_SCALE;
+        }
+        if (miniScale > MINIMAP_MAX_SCALE) {
+            miniScale = MINIMAP_MAX_SCALE;
+        }
+        InvalidateRect(hwnd, NULL, TRUE);
+        return 0;
+    }
+
+    case WM_TIMER:
+        if (wParam == MINIMAP_TIMER_ID) {
+            UpdateMiniMap();
+            return 0;
+        }
+        break;
+
+    case WM_PAINT: {
+        PAINTSTRUCT ps;
+        HDC hdc;
+        BITMAPINFO bmi;
+        RECT rc;
+        HBRUSH hBrush;
+
+        hdc = BeginPaint(hwnd, &ps);
+
+        if (!MiniShadowValid) {
+            /* First paint - nothing plotted yet */
+            UpdateMiniMap();
+        }
+
+        ZeroMemory(&bmi, sizeof(BITMAPINFO));
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = WORLD_X;
+        bmi.bmiHeader.biHeight = -WORLD_Y; /* Negative for top-down DIB */
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+
+        SetStretchBltMode(hdc, COLORONCOLOR);
+        StretchDIBits(hdc, 0, 0, WORLD_X * miniScale, WORLD_Y * miniScale, 0, 0, WORLD_X,
+                      WORLD_Y, MiniPixels, &bmi, DIB_RGB_COLORS, SRCCOPY);
+
+        /* Frame the part of the city shown in the main window */
+        GetMapViewRect(&lastViewRect);
+        TileRectToClient(&lastViewRect, &rc);
+        hBrush = CreateSolidBrush(RGB(255, 255, 255));
+        FrameRect(hdc, &rc, hBrush);
+        DeleteObject(hBrush);
+
+        EndPaint(hwnd, &ps);
+        return 0;
+    }
+
+    case WM_ERASEBKGND: {
+        /* Only erase the margin outside the map image */
+        RECT rc;
+        RECT rcMap;
+        HRGN hRgn;
+        HRGN hMapRgn;
+
+        GetClientRect(hwnd, &rc);
+        rcMap.left = 0;
+        rcMap.top = 0;
+        rcMap.right = WORLD_X * miniScale;
+        rcMap.bottom = WORLD_Y * miniScale;
+
+        hRgn = CreateRectRgnIndirect(&rc);
+        hMapRgn = CreateRectRgnIndirect(&rcMap);
+        CombineRgn(hRgn, hRgn, hMapRgn, RGN_DIFF);
+        FillRgn((HDC)wParam, hRgn, (HBRUSH)GetStockObject(BLACK_BRUSH));
+        DeleteObject(hMapRgn);
+        DeleteObject(hRgn);
+        return 1;
+    }
+
+    case WM_LBUTTONDOWN:
+        miniDragging = TRUE;
+        SetCapture(hwnd);
+        MiniMapJump((short)LOWORD(lParam), (short)HIWORD(lParam));
+        return 0;
+
+    case WM_MOUSEMOVE:
+        if (miniDragging) {
+            MiniMapJump((short)LOWORD(lParam), (short)HIWORD(lParam));
+        }
+        return 0;
+
+    case WM_LBUTTONUP:
+        if (miniDragging) {
+            miniDragging = FALSE;
+            ReleaseCapture();
+        }
+        return 0;
+
+    case WM_CLOSE:
+        /* Don't destroy, just hide the window */
+        ShowWindow(hwnd, SW_HIDE);
+
+        /* Update menu checkmark */
+        if (hwndMain) {
+            HMENU hViewMenu = GetSubMenu(GetMenu(hwndMain), 4); /* View is the 5th menu */
+            if (hViewMenu) {
+                CheckMenuItem(hViewMenu, IDM_VIEW_MINIMAP, MF_BYCOMMAND | MF_UNCHECKED);
+            }
+        }
+        return 0;
+
+    case WM_DESTROY:
+        KillTimer(hwnd, MINIMAP_TIMER_ID);
+        hwndMiniMap = NULL;
+        return 0;
+    }
+
+    return DefWindowProc(hwnd, msg, wParam, lParam);
+}
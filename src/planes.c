@@ -0,0 +1,259 @@
+/* planes.c - Tile flag planes and change tracking for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * Map packs each tile's number with its ZONEBIT, ANIMBIT, BULLBIT, BURNBIT,
+ * CONDBIT and POWERBIT flags. The planes here hold the same flags one bit
+ * per tile, together with a few tile classes (water, road, rail, houses,
+ * fire), so a question such as "where are the zone centres" is answered a
+ * word of tiles at a time instead of by masking every Map entry.
+ *
+ * Every Map write goes through SetTile, which keeps the planes in step and
+ * tells the rest of the game what changed: the chunk holding the tile is
+ * flagged for each consumer that copies the map (the snapshot buffers and
+ * the autosave shadow), a change to which tiles are zones, conductors or
+ * powered, or to what a zone centre is, asks for a new power scan, and a
+ * change to a station's centre asks for its coverage map to be worked out
+ * again. The zone, animation and fire planes stand in for a zone registry,
+ * an animation list and a list of fires. Code that fills Map wholesale (loading a city, clearing the map)
+ * calls RebuildTilePlanes afterwards. CheckTilePlanes compares the planes
+ * with Map and is run after every golden step.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* The flags from ZONEBIT up to POWERBIT, in TILE_PLANE_ZONE order */
+#define FLAG_SHIFT 10
+#define FLAG_PLANES 6
+
+BitPlane TilePlanes[TILE_PLANES];
+Byte TileChunks[CHUNK_ROWS][CHUNK_COLS];
+int PowerScanNeeded = 1;
+int CoverageNeeded = COVER_ALL;
+
+/* Which planes a map value belongs to, one bit per plane */
+static unsigned int TilePlaneMask(short value) {
+    unsigned int mask;
+    int tile;
+
+    mask = ((unsigned short)value >> FLAG_SHIFT) & ((1U << FLAG_PLANES) - 1);
+    tile = value & LOMASK;
+
+    if (tile >= RIVER && tile <= LASTRIVEDGE) {
+        mask |= 1U << TILE_PLANE_WATER;
+    } else if (tile >= ROADBASE && tile <= LASTROAD) {
+        mask |= 1U << TILE_PLANE_ROAD;
+    } else if (tile >= RAILBASE && tile <= LASTRAIL) {
+        mask |= 1U << TILE_PLANE_RAIL;
+    } else if (tile >= LHTHR && tile <= HHTHR) {
+        mask |= 1U << TILE_PLANE_HOUSE;
+    } else if (tile >= FIREBASE && tile <= LASTFIRE) {
+        mask |= 1U << TILE_PLANE_FIRE;
+    }
+    return mask;
+}
+
+/* Write a map tile, bring the planes up to date and note the change */
+void SetTile(int x, int y, short value) {
+    unsigned int changed;
+    unsigned long bit;
+    short old;
+    int i;
+
+    old = Map[y][x];
+    if (old == value) {
+        return;
+    }
+    Map[y][x] = value;
+    TileChunks[y / CHUNK_SIZE][x / CHUNK_SIZE] = CHUNK_ALL;
+
+    /* The power scan reads which tiles are zones and conductors and which
+       zone centres are plants, and its result stands only while nothing
+       else moves a power bit. Animation frames and traffic rewrite a tile
+       with the same flags, so they leave it alone. */
+    if (((old ^ value) & (ZONEBIT | CONDBIT | POWERBIT)) ||
+        ((value & ZONEBIT) && (old & LOMASK) != (value & LOMASK))) {
+        PowerScanNeeded = 1;
+    }
+    if ((old | value) & ZONEBIT) {
+        if ((old & LOMASK) == FIRESTATION || (value & LOMASK) == FIRESTATION) {
+            CoverageNeeded |= COVER_FIRE;
+        }
+        if ((old & LOMASK) == POLICESTATION || (value & LOMASK) == POLICESTATION) {
+            CoverageNeeded |= COVER_POLICE;
+        }
+    }
+
+    changed = TilePlaneMask(old) ^ TilePlaneMask(value);
+    if (changed) {
+        bit = PLANE_BIT(x);
+        for (i = 0; i < TILE_PLANES; i++) {
+            if (changed & (1U << i)) {
+                TilePlanes[i][y][x / PLANE_WORD_BITS] ^= bit;
+            }
+        }
+    }
+}
+
+/* Rebuild every plane from Map after it has been filled wholesale, and
+ * treat the whole map as changed */
+void RebuildTilePlanes(void) {
+    unsigned int mask;
+    int x, y;
+    int i;
+
+    memset(TilePlanes, 0, sizeof(TilePlanes));
+    memset(TileChunks, CHUNK_ALL, sizeof(TileChunks));
+    PowerScanNeeded = 1;
+    CoverageNeeded = COVER_ALL;
+    LandScanFull = 1;
+
+    for (y = 0; y < WORLD_Y; y++) {
+        for (x = 0; x < WORLD_X; x++) {
+            mask = TilePlaneMask(Map[y][x]);
+            for (i = 0; mask; i++, mask >>= 1) {
+                if (mask & 1) {
+                    PLANE_SET(TilePlanes[i], x, y);
+                }
+            }
+        }
+    }
+}
+
+/* Compare the planes with Map. Returns the number of tiles that differ and
+ * logs the first one. */
+int CheckTilePlanes(void) {
+    unsigned int want;
+    unsigned int have;
+    int mismatches;
+    int x, y;
+    int i;
+
+    mismatches = 0;
+    for (y = 0; y < WORLD_Y; y++) {
+        for (x = 0; x < WORLD_X; x++) {
+            want = TilePlaneMask(Map[y][x]);
+            have = 0;
+            for (i = 0; i < TILE_PLANES; i++) {
+                if (PLANE_TEST(TilePlanes[i], x, y)) {
+                    have |= 1U << i;
+                }
+            }
+            if (have != want) {
+                if (mismatches == 0) {
+                    addDebugLog("Tile planes differ at %d,%d: planes %03X, map %03X",
+                                x, y, have, want);
+                }
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+/* Find the next tile set in a plane, reading along rows from (*x, *y).
+ * Returns 0 once the plane is exhausted. The caller moves *x on by one
+ * before asking again. Words are read as the search reaches them, so
+ * tiles changed behind the search are seen just as a Map loop would. */
+int NextPlaneTile(BitPlane plane, int *x, int *y) {
+    unsigned long word;
+    int wx, wy;
+    int bit;
+
+    wx = *x;
+    wy = *y;
+    if (wx >= WORLD_X) {
+        wx = 0;
+        wy++;
+    }
+
+    while (wy < WORLD_Y) {
+        word = plane[wy][wx / PLANE_WORD_BITS] & (~0UL << (wx & (PLANE_WORD_BITS - 1)));
+        while (word == 0) {
+            wx = (wx / PLANE_WORD_BITS + 1) * PLANE_WORD_BITS;
+            if (wx >= WORLD_X) {
+                break;
+            }
+            word = plane[wy][wx / PLANE_WORD_BITS];
+        }
+        if (word != 0) {
+            bit = 0;
+            while (!(word & 1UL)) {
+                word >>= 1;
+                bit++;
+            }
+            *x = (wx & ~(PLANE_WORD_BITS - 1)) + bit;
+            *y = wy;
+            return 1;
+        }
+        wx = 0;
+        wy++;
+    }
+    return 0;
+}
+
+/* Count the set bits in a word */
+static int CountWordBits(unsigned long w) {
+    w &= 0xFFFFFFFFUL;
+    w = w - ((w >> 1) & 0x55555555UL);
+    w = (w & 0x33333333UL) + ((w >> 2) & 0x33333333UL);
+    w = (w + (w >> 4)) & 0x0F0F0F0FUL;
+    return (int)(((w * 0x01010101UL) & 0xFFFFFFFFUL) >> 24);
+}
+
+/* Count the tiles set in a plane, or in both a plane and a mask */
+int CountPlaneBits(BitPlane plane, BitPlane mask) {
+    int count;
+    int x, y;
+
+    count = 0;
+    for (y = 0; y < WORLD_Y; y++) {
+        for (x = 0; x < PLANE_ROW_WORDS; x++) {
+            count += CountWordBits(mask ? plane[y][x] & mask[y][x] : plane[y][x]);
+        }
+    }
+    return count;
+}
+
+/* Count the tiles set in a plane within a box, corners included. The box
+ * is clipped to the map. */
+int CountPlaneBox(BitPlane plane, int x0, int y0, int x1, int y1) {
+    unsigned long word;
+    int count;
+    int x, y;
+
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 > WORLD_X - 1) {
+        x1 = WORLD_X - 1;
+    }
+    if (y1 > WORLD_Y - 1) {
+        y1 = WORLD_Y - 1;
+    }
+
+    count = 0;
+    for (y = y0; y <= y1; y++) {
+        x = x0;
+        while (x <= x1) {
+            /* The part of this word that lies inside the box */
+            word = plane[y][x / PLANE_WORD_BITS] >> (x & (PLANE_WORD_BITS - 1));
+            if (x1 - x < PLANE_WORD_BITS - 1 - (x & (PLANE_WORD_BITS - 1))) {
+                word &= (2UL << (x1 - x)) - 1;
+            }
+            count += CountWordBits(word);
+            x = (x / PLANE_WORD_BITS + 1) * PLANE_WORD_BITS;
+        }
+    }
+    return count;
+}
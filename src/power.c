@@ -24,11 +24,17 @@ static QUAD NumPower = 0;
 static int CoalPop = 0;
 static int NuclearPop = 0;
 
+/* Zone counts from the last full scan */
+static int ScanPwrdZCnt = 0;
+static int ScanUnpwrdZCnt = 0;
+
 /* Function prototypes */
 static void PushPowerStack(void);
 static void PullPowerStack(void);
 static int MoveMapSim(short MDir);
 static int TestForCond(short TFDir);
+static void ScanPower(void);
+static void ApplyPowerMap(void);
 
 /* Move in a direction on the map during power scan */
 static int MoveMapSim(short MDir) {
@@ -96,11 +102,11 @@ static int TestForCond(short TFDir) {
     if (MoveMapSim(TFDir)) {
         tile = Map[SMapY][SMapX] & LOMASK;
 
-        /* Check if tile can conduct power and is not already powered.
+        /* Check if tile can conduct power and is not already powered by this scan.
            NOTE: ZONEBIT-flagged tiles can also conduct power even if CONDBIT is not set.
            This is critical for residential zones to get power. */
         if (((Map[SMapY][SMapX] & CONDBIT) || (Map[SMapY][SMapX] & ZONEBIT)) && (tile != NUCLEAR) &&
-            (tile != POWERPLANT) && !(Map[SMapY][SMapX] & POWERBIT)) {
+            (tile != POWERPLANT) && !PLANE_TEST(PowerMap, SMapX, SMapY)) {
             SMapX = xsave;
             SMapY = ysave;
             return 1;
@@ -138,18 +144,17 @@ void CountPowerPlants(void) {
     CoalPop = 0;
     NuclearPop = 0;
 
-    for (y = 0; y < WORLD_Y; y++) {
-        for (x = 0; x < WORLD_X; x++) {
-            tile = Map[y][x] & LOMASK;
-
-            if ((Map[y][x] & ZONEBIT) != 0) {
-                if (tile == POWERPLANT) {
-                    CoalPop++;
-                } else if (tile == NUCLEAR) {
-                    NuclearPop++;
-                }
-            }
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(TilePlanes[TILE_PLANE_ZONE], &x, &y)) {
+        tile = Map[y][x] & LOMASK;
+
+        if (tile == POWERPLANT) {
+            CoalPop++;
+        } else if (tile == NUCLEAR) {
+            NuclearPop++;
         }
+        x++;
     }
 }
 
@@ -169,13 +174,35 @@ void FindPowerPlants(void) {
 
     PowerStackNum = 0;
 
-    for (y = 0; y < WORLD_Y; y++) {
-        for (x = 0; x < WORLD_X; x++) {
-            tile = Map[y][x] & LOMASK;
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(TilePlanes[TILE_PLANE_ZONE], &x, &y)) {
+        tile = Map[y][x] & LOMASK;
+
+        if (tile == POWERPLANT || tile == NUCLEAR) {
+            QueuePowerPlant(x, y);
+        }
+        x++;
+    }
+}
 
-            if ((Map[y][x] & ZONEBIT) != 0) {
-                if (tile == POWERPLANT || tile == NUCLEAR) {
-                    QueuePowerPlant(x, y);
+/* Turn the whole power map off */
+void ClearPowerMap(void) {
+    memset(PowerMap, 0, sizeof(BitPlane));
+}
+
+/* Bring the power bits on the map in line with the power map, calling
+   SetTile only for tiles whose power has changed */
+static void ApplyPowerMap(void) {
+    int x, y, w;
+    unsigned long diff;
+
+    for (y = 0; y < WORLD_Y; y++) {
+        for (w = 0; w < PLANE_ROW_WORDS; w++) {
+            diff = TilePlanes[TILE_PLANE_POWER][y][w] ^ PowerMap[y][w];
+            for (x = w * PLANE_WORD_BITS; diff != 0; x++, diff >>= 1) {
+                if (diff & 1) {
+                    SetTile(x, y, Map[y][x] ^ POWERBIT);
                 }
             }
         }
@@ -185,8 +212,8 @@ void FindPowerPlants(void) {
 /* Do a full power distribution scan - ORIGINAL ALGORITHM
    This uses the original Micropolis power transmission method that traces along
    power lines and conductive terrain rather than using a simple radius */
-void DoPowerScan(void) {
-    int x, y;
+static void ScanPower(void) {
+    int zones;
     short ADir, ConNum, Dir;
 
     /* Count power plants */
@@ -196,28 +223,18 @@ void DoPowerScan(void) {
     MaxPower = (CoalPop * 700L) + (NuclearPop * 2000L);
     NumPower = 0;
 
-    /* Clear the power map first */
-    for (y = 0; y < WORLD_Y; y++) {
-        for (x = 0; x < WORLD_X; x++) {
-            Map[y][x] &= ~POWERBIT; /* Turn off the power bit */
-            PowerMap[y][x] = 0;     /* Set PowerMap to unpowered */
-        }
-    }
+    /* Trace into a cleared power map and copy it onto the tiles only at
+       the end, so tiles that stay powered are never written. Nothing
+       below changes which tiles are zones, so the zone counts can come
+       from the zone plane. */
+    ClearPowerMap();
+    zones = CountPlaneBits(TilePlanes[TILE_PLANE_ZONE], NULL);
 
     /* If we have no power plants, no point in doing anything else */
     if (CoalPop == 0 && NuclearPop == 0) {
-        /* Update power counts */
+        ApplyPowerMap();
         PwrdZCnt = 0;
-        UnpwrdZCnt = 0;
-
-        /* Count unpowered zones */
-        for (y = 0; y < WORLD_Y; y++) {
-            for (x = 0; x < WORLD_X; x++) {
-                if (Map[y][x] & ZONEBIT) {
-                    UnpwrdZCnt++;
-                }
-            }
-        }
+        UnpwrdZCnt = zones;
         return;
     }
 
@@ -236,21 +253,9 @@ void DoPowerScan(void) {
             /* Increment the power counter - if over capacity, stop */
             if (++NumPower > MaxPower) {
                 /* We've reached the power capacity limit */
-                /* Update power zone counts */
-                PwrdZCnt = 0;
-                UnpwrdZCnt = 0;
-
-                for (y = 0; y < WORLD_Y; y++) {
-                    for (x = 0; x < WORLD_X; x++) {
-                        if (Map[y][x] & ZONEBIT) {
-                            if (Map[y][x] & POWERBIT) {
-                                PwrdZCnt++;
-                            } else {
-                                UnpwrdZCnt++;
-                            }
-                        }
-                    }
-                }
+                ApplyPowerMap();
+                PwrdZCnt = CountPlaneBits(PowerMap, TilePlanes[TILE_PLANE_ZONE]);
+                UnpwrdZCnt = zones - PwrdZCnt;
                 return;
             }
 
@@ -258,8 +263,7 @@ void DoPowerScan(void) {
             MoveMapSim(ADir);
 
             /* Power the current position */
-            Map[SMapY][SMapX] |= POWERBIT;
-            PowerMap[SMapY][SMapX] = 1;
+            PLANE_SET(PowerMap, SMapX, SMapY);
 
             /* Look in all four directions for conducting tiles */
             ConNum = 0;
@@ -281,19 +285,33 @@ void DoPowerScan(void) {
         } while (ConNum); /* Continue as long as we have conductive paths */
     }
 
+    ApplyPowerMap();
+
     /* Update power zone counts */
-    PwrdZCnt = 0;
-    UnpwrdZCnt = 0;
+    PwrdZCnt = CountPlaneBits(PowerMap, TilePlanes[TILE_PLANE_ZONE]);
+    UnpwrdZCnt = zones - PwrdZCnt;
+}
 
-    for (y = 0; y < WORLD_Y; y++) {
-        for (x = 0; x < WORLD_X; x++) {
-            if (Map[y][x] & ZONEBIT) {
-                if (Map[y][x] & POWERBIT) {
-                    PwrdZCnt++;
-                } else {
-                    UnpwrdZCnt++;
-                }
-            }
-        }
+/* Check whether DoPowerScan has anything to do: a tile the scan reads
+   has changed, or the census has cleared the zone counts since */
+int PowerScanDue(void) {
+    return PowerScanNeeded || PwrdZCnt != ScanPwrdZCnt || UnpwrdZCnt != ScanUnpwrdZCnt;
+}
+
+/* Distribute power, unless no zone, conductor or powered tile has changed
+   since the last scan. The scan reads nothing else, so it would light the
+   same tiles again; only the zone counts, which the census clears, need
+   putting back. */
+void DoPowerScan(void) {
+    if (!PowerScanNeeded) {
+        PwrdZCnt = ScanPwrdZCnt;
+        UnpwrdZCnt = ScanUnpwrdZCnt;
+        return;
     }
-}
\ No newline at end of file
+
+    ScanPower();
+
+    ScanPwrdZCnt = PwrdZCnt;
+    ScanUnpwrdZCnt = UnpwrdZCnt;
+    PowerScanNeeded = 0;
+}
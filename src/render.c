@@ -0,0 +1,388 @@
+/* render.c - Headless map renderer for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * Draws the map into a caller's 8-bit buffer without GDI, so batch runs
+ * can produce pictures of a city. The tileset BMP is read once with plain
+ * file I/O (4-bit, 8-bit or 8-bit RLE, as all but one bundled tileset are) and
+ * turned into an atlas that keeps each tile's 16x16 pixels together.
+ * Drawing a map then only copies tile rows out of the atlas. Tiles can be
+ * drawn 1 to 64 pixels across: 16 copies whole rows, smaller sizes take
+ * the centre pixel of each block, larger sizes repeat pixels.
+ *
+ * The atlas is only read once loaded, so several threads may draw at the
+ * same time. Pixels are palette indices; RenderPalette gives the colours.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External variables */
+extern char progPathName[MAX_PATH];
+
+/* Tileset geometry - must match main.c */
+#define TILE_SIZE 16
+#define TILES_IN_ROW 32
+
+#define THUMB_DIR "thumbs"
+#define THUMB_TILESET "default"
+
+/* BMP compression types */
+#define BMP_RGB 0
+#define BMP_RLE8 1
+
+/* Every tile's pixels, tile after tile, top row first */
+static Byte TileAtlas[TILE_COUNT][TILE_SIZE][TILE_SIZE];
+
+/* Tileset colours as 0x00RRGGBB */
+DWORD RenderPalette[256];
+
+static int atlasLoaded = 0;
+
+/* Little-endian fields of the BMP headers */
+static unsigned long GetLong(const Byte *p) {
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) |
+           ((unsigned long)p[3] << 24);
+}
+
+static unsigned int GetShort(const Byte *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+/* Expand RLE8 data into rows of width bytes. Returns 0 if it is malformed. */
+static int DecodeRLE8(const Byte *src, long size, Byte *dst, int width, int height) {
+    const Byte *end;
+    int x, y;
+    int n;
+    int i;
+
+    end = src + size;
+    x = 0;
+    y = 0;
+    while (src + 1 < end && y < height) {
+        n = src[0];
+        if (n > 0) {
+            /* A run of one colour */
+            while (n-- > 0 && x < width) {
+                dst[(long)y * width + x++] = src[1];
+            }
+            src += 2;
+        } else if (src[1] == 0) {
+            x = 0;
+            y++;
+            src += 2;
+        } else if (src[1] == 1) {
+            break;
+        } else if (src[1] == 2) {
+            if (src + 3 >= end) {
+                return 0;
+            }
+            x += src[2];
+            y += src[3];
+            src += 4;
+        } else {
+            /* A run of literal bytes, padded to a whole word */
+            n = src[1];
+            src += 2;
+            if (src + n > end) {
+                return 0;
+            }
+            for (i = 0; i < n; i++) {
+                if (x < width) {
+                    dst[(long)y * width + x++] = src[i];
+                }
+            }
+            src += n + (n & 1);
+        }
+    }
+    return 1;
+}
+
+/* Read a tileset BMP into the atlas. Returns 1 on success. */
+int LoadRenderTileset(const char *filename) {
+    Byte header[54];
+    Byte *data;
+    Byte *pixels;
+    const Byte *row;
+    FILE *f;
+    long fileSize;
+    long offset;
+    long width, height;
+    long stride;
+    unsigned long compression;
+    unsigned long colors;
+    int bits;
+    int bottomUp;
+    int tile, px, py;
+    int srcX, srcY;
+    int ok;
+    int i;
+
+    f = fopen(filename, "rb");
+    if (f == NULL) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = (Byte *)malloc(fileSize > 0 ? fileSize : 1);
+    ok = data != NULL && fileSize > (long)sizeof(header) &&
+         fread(data, 1, fileSize, f) == (size_t)fileSize;
+    fclose(f);
+    if (!ok) {
+        free(data);
+        return 0;
+    }
+
+    memcpy(header, data, sizeof(header));
+    offset = (long)GetLong(header + 10);
+    width = (long)GetLong(header + 18);
+    height = (long)GetLong(header + 22);
+    bits = (int)GetShort(header + 28);
+    compression = GetLong(header + 30);
+    colors = GetLong(header + 46);
+
+    bottomUp = height > 0;
+    if (!bottomUp) {
+        height = -height;
+    }
+    if (colors == 0 || colors > (1UL << bits)) {
+        colors = 1UL << bits;
+    }
+
+    if (header[0] != 'B' || header[1] != 'M' || (bits != 4 && bits != 8) ||
+        (compression != BMP_RGB && (compression != BMP_RLE8 || bits != 8)) || width < TILE_SIZE ||
+        height < TILE_SIZE || offset >= fileSize ||
+        14 + (long)GetLong(header + 14) + (long)colors * 4 > fileSize) {
+        free(data);
+        return 0;
+    }
+
+    pixels = (Byte *)calloc(width * height, 1);
+    if (pixels == NULL) {
+        free(data);
+        return 0;
+    }
+
+    /* Rows in file order */
+    if (compression == BMP_RLE8) {
+        ok = DecodeRLE8(data + offset, fileSize - offset, pixels, (int)width, (int)height);
+    } else {
+        stride = ((width * bits + 31) / 32) * 4;
+        ok = offset + stride * height <= fileSize;
+        for (i = 0; ok && i < height; i++) {
+            row = data + offset + i * stride;
+            if (bits == 8) {
+                memcpy(pixels + i * width, row, width);
+            } else {
+                for (px = 0; px < width; px++) {
+                    pixels[i * width + px] = (Byte)((px & 1) ? row[px >> 1] & 15 : row[px >> 1] >> 4);
+                }
+            }
+        }
+    }
+
+    if (ok) {
+        memset(RenderPalette, 0, sizeof(RenderPalette));
+        row = data + 14 + GetLong(header + 14);
+        for (i = 0; i < (int)colors; i++) {
+            RenderPalette[i] = ((DWORD)row[i * 4 + 2] << 16) | ((DWORD)row[i * 4 + 1] << 8) |
+                               row[i * 4];
+        }
+
+        memset(TileAtlas, 0, sizeof(TileAtlas));
+        for (tile = 0; tile < TILE_COUNT; tile++) {
+            srcX = (tile % TILES_IN_ROW) * TILE_SIZE;
+            srcY = (tile / TILES_IN_ROW) * TILE_SIZE;
+            if (srcX + TILE_SIZE > width || srcY + TILE_SIZE > height) {
+                continue;
+            }
+            for (py = 0; py < TILE_SIZE; py++) {
+                i = srcY + py;
+                row = pixels + (bottomUp ? height - 1 - i : i) * width + srcX;
+                for (px = 0; px < TILE_SIZE; px++) {
+                    TileAtlas[tile][py][px] = row[px];
+                }
+            }
+        }
+        atlasLoaded = 1;
+    }
+
+    free(pixels);
+    free(data);
+    return ok;
+}
+
+/* Draw part of a map into an 8-bit buffer at tileSize pixels per tile.
+ * The part is cols x rows tiles from (left, top); the buffer must hold
+ * rows * tileSize lines of pitch bytes. Returns 0 if no tileset is loaded
+ * or the part is off the map. */
+int RenderMap(const short *map, int left, int top, int cols, int rows, int tileSize,
+              Byte *pixels, long pitch) {
+    int sample[TILE_SIZE * 4];
+    const Byte *src;
+    Byte *dst;
+    int tile;
+    int x, y;
+    int line;
+    int i;
+
+    if (!atlasLoaded || tileSize < 1 || tileSize > TILE_SIZE * 4 || left < 0 || top < 0 ||
+        cols <= 0 || rows <= 0 || left + cols > WORLD_X || top + rows > WORLD_Y) {
+        return 0;
+    }
+
+    /* Source pixel for each output pixel across or down a tile */
+    for (i = 0; i < tileSize; i++) {
+        sample[i] = ((2 * i + 1) * TILE_SIZE) / (2 * tileSize);
+    }
+
+    for (y = 0; y < rows; y++) {
+        for (x = 0; x < cols; x++) {
+            tile = map[(top + y) * WORLD_X + left + x] & LOMASK;
+            if (tile >= TILE_COUNT) {
+                tile = 0;
+            }
+
+            dst = pixels + (long)y * tileSize * pitch + (long)x * tileSize;
+            if (tileSize == TILE_SIZE) {
+                for (line = 0; line < TILE_SIZE; line++, dst += pitch) {
+                    memcpy(dst, TileAtlas[tile][line], TILE_SIZE);
+                }
+            } else {
+                for (line = 0; line < tileSize; line++, dst += pitch) {
+                    src = TileAtlas[tile][sample[line]];
+                    for (i = 0; i < tileSize; i++) {
+                        dst[i] = src[sample[i]];
+                    }
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+/* Write an 8-bit image with RenderPalette as a BMP. Returns 1 on success. */
+int WriteRenderBMP(const char *filename, const Byte *pixels, int width, int height, long pitch) {
+    Byte header[54];
+    Byte quad[4];
+    Byte pad[3];
+    FILE *f;
+    long stride;
+    long size;
+    int ok;
+    int i;
+
+    stride = ((long)width + 3) & ~3L;
+    size = 54 + 256 * 4 + stride * height;
+
+    memset(header, 0, sizeof(header));
+    header[0] = 'B';
+    header[1] = 'M';
+    for (i = 0; i < 4; i++) {
+        header[2 + i] = (Byte)(size >> (8 * i));
+        header[10 + i] = (Byte)((54 + 256 * 4) >> (8 * i));
+        header[18 + i] = (Byte)((long)width >> (8 * i));
+        header[22 + i] = (Byte)((long)height >> (8 * i));
+        header[34 + i] = (Byte)((stride * height) >> (8 * i));
+    }
+    header[14] = 40;
+    header[26] = 1;
+    header[28] = 8;
+    header[47] = 1;              /* 256 colours */
+
+    f = fopen(filename, "wb");
+    if (f == NULL) {
+        return 0;
+    }
+
+    ok = fwrite(header, sizeof(header), 1, f) == 1;
+    for (i = 0; ok && i < 256; i++) {
+        quad[0] = (Byte)RenderPalette[i];
+        quad[1] = (Byte)(RenderPalette[i] >> 8);
+        quad[2] = (Byte)(RenderPalette[i] >> 16);
+        quad[3] = 0;
+        ok = fwrite(quad, 4, 1, f) == 1;
+    }
+
+    /* Bottom row first */
+    memset(pad, 0, sizeof(pad));
+    for (i = height - 1; ok && i >= 0; i--) {
+        ok = fwrite(pixels + i * pitch, 1, width, f) == (size_t)width &&
+             (stride == width || fwrite(pad, 1, stride - width, f) == (size_t)(stride - width));
+    }
+
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+static CityState batchStart;     /* The game as it was before a batch run */
+
+/* Run a city for a number of game years without windows, writing a picture
+ * of the whole map at tileSize pixels per tile at the end of every year to
+ * thumbs\<city>. Returns 1 on success. */
+int RunThumbnailBatch(const char *filename, int years, int tileSize) {
+    char folder[MAX_PATH];
+    char path[MAX_PATH];
+    const char *base;
+    const char *p;
+    char *dot;
+    Byte *image;
+    long pitch;
+    long steps;
+    long i;
+    int ok;
+
+    wsprintf(path, "%s\\tilesets\\%s.bmp", progPathName, THUMB_TILESET);
+    if (tileSize < 1 || tileSize > TILE_SIZE * 4 || !LoadRenderTileset(path)) {
+        return 0;
+    }
+
+    base = filename;
+    for (p = filename; *p; p++) {
+        if (*p == '\\' || *p == '/' || *p == ':') {
+            base = p + 1;
+        }
+    }
+    wsprintf(folder, "%s\\%s", progPathName, THUMB_DIR);
+    CreateDirectory(folder, NULL);
+    wsprintf(folder, "%s\\%s\\%s", progPathName, THUMB_DIR, base);
+    dot = strrchr(folder, '.');
+    if (dot && dot > strrchr(folder, '\\')) {
+        *dot = '\0';
+    }
+    CreateDirectory(folder, NULL);
+
+    pitch = (long)WORLD_X * tileSize;
+    image = (Byte *)malloc(pitch * WORLD_Y * tileSize);
+    if (image == NULL) {
+        return 0;
+    }
+
+    AutosaveEnabled = 0;
+    CaptureCityState(&batchStart);
+    ok = StartHeadlessCity(filename, &batchStart);
+
+    steps = (long)years * 12L * 16L;
+    for (i = 1; ok && i <= steps; i++) {
+        SimStep();
+        if (i % (12L * 16L) == 0) {
+            wsprintf(path, "%s\\y%04d.bmp", folder, (int)(i / (12L * 16L)));
+            ok = RenderMap(&Map[0][0], 0, 0, WORLD_X, WORLD_Y, tileSize, image, pitch) &&
+                 WriteRenderBMP(path, image, WORLD_X * tileSize, WORLD_Y * tileSize, pitch);
+        }
+    }
+
+    free(image);
+    return ok;
+}
@@ -0,0 +1,394 @@
+/* replay.c - Command recording and replay for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * While recording, every player action that changes the city is appended
+ * to a command stream together with the simulation step it followed. A
+ * replay file holds the city as it was when recording started, the
+ * command stream, and the step and checksum the recording ended on.
+ * RunReplay() loads one without any windows, runs the simulation flat
+ * out, applies each command after the same step and checks that the city
+ * ends up identical.
+ *
+ * Each command is stored as variable-length integers: the step, the
+ * command type and its arguments.
+ */
+
+#include "sim.h"
+#include "tools.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+#define REPLAY_MAGIC "MNTR"
+#define REPLAY_VERSION 1
+
+/* Command types */
+#define CMD_TOOL 1   /* tool, x, y */
+#define CMD_SPEED 2  /* speed */
+#define CMD_REWIND 3 /* month */
+#define CMD_BUDGET 4 /* BUDGET_*, percent as float bits */
+#define CMD_STROKE 5 /* tool and shape, start, end (x low, y high) */
+#define CMD_COUNT 6
+
+/* Arguments taken by each command type */
+static const int CommandArgs[CMD_COUNT] = { 0, 3, 1, 1, 2, 3 };
+
+/* Longest encoded command: step, type and three arguments */
+#define CMD_MAX_BYTES (5 * 5)
+
+/* Initial command buffer size, doubled as needed */
+#define CMD_BUFFER_START 4096
+
+/* Replay file header, followed by a CityFile and the command stream */
+typedef struct {
+    char magic[4];               /* REPLAY_MAGIC */
+    unsigned short version;      /* REPLAY_VERSION */
+    unsigned short reserved;
+    long startStep;              /* Step the recording started after */
+    long endStep;                /* Step the recording stopped after */
+    unsigned long endChecksum;   /* City checksum when recording stopped */
+    unsigned long commandCount;
+    unsigned long commandBytes;  /* Size of the command stream */
+} ReplayHeader;
+
+static int recordPending = 0;
+static int recording = 0;
+static ReplayHeader replayHeader;
+static CityFile replayCity;          /* City as it was when recording started */
+static Byte *commandData = NULL;
+static unsigned long commandSize = 0; /* Allocated size of commandData */
+static CityState checkState;
+
+/* Position of the simulation: one step per Simulate() call. CityTime
+ * advances on phase 0, so this counts up by one per step. */
+static long GetStepNumber(void) {
+    return (long)CityTime * 16L + (Fcycle & 15);
+}
+
+/* Checksum of the running city for comparing a replay with its recording */
+static unsigned long GetCityChecksum(void) {
+    CaptureCityState(&checkState);
+
+    /* Only paces the simulation against the clock */
+    checkState.spdcycle = 0;
+
+    return CityChecksum(&checkState, sizeof(CityState));
+}
+
+/* Append one command to the stream */
+static void AppendCommand(int type, unsigned long a, unsigned long b, unsigned long c) {
+    Byte *p;
+    Byte *grown;
+    unsigned long newSize;
+
+    if (!recording) {
+        return;
+    }
+
+    if (replayHeader.commandBytes + CMD_MAX_BYTES > commandSize) {
+        newSize = commandSize ? commandSize * 2 : CMD_BUFFER_START;
+        grown = (Byte *)realloc(commandData, newSize);
+        if (grown == NULL) {
+            addGameLog("Recording stopped: out of memory");
+            recording = 0;
+            return;
+        }
+        commandData = grown;
+        commandSize = newSize;
+    }
+
+    p = commandData + replayHeader.commandBytes;
+    p = PutVarint(p, (unsigned long)GetStepNumber());
+    p = PutVarint(p, (unsigned long)type);
+    if (CommandArgs[type] > 0) {
+        p = PutVarint(p, a);
+    }
+    if (CommandArgs[type] > 1) {
+        p = PutVarint(p, b);
+    }
+    if (CommandArgs[type] > 2) {
+        p = PutVarint(p, c);
+    }
+
+    replayHeader.commandBytes = (unsigned long)(p - commandData);
+    replayHeader.commandCount++;
+}
+
+/* Record a tool applied at a map position */
+void RecordToolCommand(int tool, int x, int y) {
+    AppendCommand(CMD_TOOL, (unsigned long)tool, (unsigned long)(unsigned short)x,
+                  (unsigned long)(unsigned short)y);
+}
+
+/* Record a tool dragged from one map position to another */
+void RecordStrokeCommand(int tool, int x0, int y0, int x1, int y1, int shape) {
+    AppendCommand(CMD_STROKE, (unsigned long)tool | ((unsigned long)shape << 8),
+                  (unsigned long)x0 | ((unsigned long)y0 << 16),
+                  (unsigned long)x1 | ((unsigned long)y1 << 16));
+}
+
+/* Record a speed change */
+void RecordSpeedCommand(int speed) {
+    AppendCommand(CMD_SPEED, (unsigned long)speed, 0, 0);
+}
+
+/* Record a rewind to the start of a month */
+void RecordRewindCommand(long cityTime) {
+    AppendCommand(CMD_REWIND, (unsigned long)cityTime, 0, 0);
+}
+
+/* Record a change to one of the funding percentages */
+void RecordBudgetCommand(int which, float percent) {
+    unsigned long bits;
+
+    bits = 0;
+    memcpy(&bits, &percent, sizeof(float));
+    AppendCommand(CMD_BUDGET, (unsigned long)which, bits, 0);
+}
+
+/* Ask for a recording to start. It begins at the start of the next game
+ * month, when the simulation has finished a cycle and holds no partial
+ * census. Caller must hold the simulation lock. */
+void RequestRecording(void) {
+    recordPending = 1;
+}
+
+/* Called by the simulation at the start of each month, before the month is
+ * recorded in the journal. Starts a requested recording. */
+void BeginRecording(void) {
+    if (!recordPending) {
+        return;
+    }
+    recordPending = 0;
+
+    CaptureCityState(&replayCity.state);
+    PrepareCityFile(&replayCity, 0);
+
+    memset(&replayHeader, 0, sizeof(replayHeader));
+    memcpy(replayHeader.magic, REPLAY_MAGIC, 4);
+    replayHeader.version = REPLAY_VERSION;
+    replayHeader.startStep = GetStepNumber();
+
+    /* A replay can only rewind to months it recorded itself */
+    ResetJournal();
+
+    recording = 1;
+    addDebugLog("Recording started at step %ld", replayHeader.startStep);
+}
+
+/* Stop recording and note where the city ended up. Caller must hold the
+ * simulation lock. Returns 1 if there is a recording to write. */
+int StopRecording(void) {
+    if (!recording) {
+        recordPending = 0;
+        return 0;
+    }
+
+    replayHeader.endStep = GetStepNumber();
+    replayHeader.endChecksum = GetCityChecksum();
+    recording = 0;
+    return 1;
+}
+
+/* Drop a recording in progress */
+void CancelRecording(void) {
+    recordPending = 0;
+    recording = 0;
+    replayHeader.version = 0;
+}
+
+/* Check if a recording is requested or in progress */
+int IsRecording(void) {
+    return recording || recordPending;
+}
+
+/* Write the last stopped recording to a replay file */
+int WriteRecording(const char *filename) {
+    FILE *f;
+    int ok;
+
+    if (recording || replayHeader.version != REPLAY_VERSION) {
+        return 0;
+    }
+
+    f = fopen(filename, "wb");
+    if (f == NULL) {
+        return 0;
+    }
+
+    ok = fwrite(&replayHeader, sizeof(ReplayHeader), 1, f) == 1 &&
+         fwrite(&replayCity, sizeof(CityFile), 1, f) == 1;
+    if (ok && replayHeader.commandBytes > 0) {
+        ok = fwrite(commandData, replayHeader.commandBytes, 1, f) == 1;
+    }
+
+    fclose(f);
+    return ok;
+}
+
+/* Carry out one recorded command */
+static int ApplyCommand(int type, unsigned long *args) {
+    float percent;
+
+    switch (type) {
+    case CMD_TOOL:
+        SelectTool((int)args[0]);
+        ApplyTool((short)args[1], (short)args[2]);
+        return 1;
+
+    case CMD_STROKE:
+        SelectTool((int)(args[0] & 0xFF));
+        ApplyToolStroke((int)(args[1] & 0xFFFF), (int)(args[1] >> 16), (int)(args[2] & 0xFFFF),
+                        (int)(args[2] >> 16), (int)(args[0] >> 8));
+        return 1;
+
+    case CMD_SPEED:
+        SimSpeed = (int)args[0];
+        return 1;
+
+    case CMD_REWIND:
+        return RewindJournal((long)args[0]);
+
+    case CMD_BUDGET:
+        memcpy(&percent, &args[1], sizeof(float));
+        if (args[0] == BUDGET_ROAD) {
+            SetRoadPercent(percent);
+        } else if (args[0] == BUDGET_POLICE) {
+            SetPolicePercent(percent);
+        } else {
+            SetFirePercent(percent);
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Run the simulation until the given step. Fails if it is already past. */
+static int RunToStep(long step, long *steps) {
+    while (GetStepNumber() != step) {
+        if (GetStepNumber() > step) {
+            return 0;
+        }
+        SimStep();
+        (*steps)++;
+    }
+    return 1;
+}
+
+/* Replay a recording without windows and compare the final city with the
+ * one recorded. Writes a report next to the replay file. Returns 1 if the
+ * replay reproduced the recording exactly. */
+int RunReplay(const char *filename) {
+    FILE *f;
+    Byte *data;
+    long fileSize;
+    const ReplayHeader *header;
+    const CityFile *city;
+    const Byte *p;
+    const Byte *end;
+    unsigned long value;
+    unsigned long args[3];
+    unsigned long checksum;
+    unsigned long commands;
+    long steps;
+    DWORD startTime;
+    DWORD elapsed;
+    int type;
+    int i;
+    int ok;
+    char reportPath[MAX_PATH];
+
+    f = fopen(filename, "rb");
+    if (f == NULL) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (fileSize < (long)(sizeof(ReplayHeader) + sizeof(CityFile))) {
+        fclose(f);
+        return 0;
+    }
+
+    data = (Byte *)malloc(fileSize);
+    if (data == NULL) {
+        fclose(f);
+        return 0;
+    }
+    ok = fread(data, fileSize, 1, f) == 1;
+    fclose(f);
+
+    header = (const ReplayHeader *)data;
+    city = (const CityFile *)(data + sizeof(ReplayHeader));
+    if (!ok || memcmp(header->magic, REPLAY_MAGIC, 4) != 0 ||
+        header->version != REPLAY_VERSION ||
+        (unsigned long)fileSize !=
+            sizeof(ReplayHeader) + sizeof(CityFile) + header->commandBytes ||
+        !CheckCityFile(city, sizeof(CityFile))) {
+        free(data);
+        return 0;
+    }
+
+    /* Start from the recorded city, with only its first month to rewind
+       to, as the recording did */
+    RestoreCityState(&city->state);
+    ResetJournal();
+    RecordJournal();
+    AutosaveEnabled = 0;
+
+    p = data + sizeof(ReplayHeader) + sizeof(CityFile);
+    end = p + header->commandBytes;
+    steps = 0;
+    commands = 0;
+    startTime = GetTickCount();
+
+    while (ok && p < end) {
+        p = GetVarint(p, end, &value);
+        ok = p != NULL && RunToStep((long)value, &steps);
+        if (ok) {
+            p = GetVarint(p, end, &value);
+            ok = p != NULL && value > 0 && value < CMD_COUNT;
+        }
+        type = (int)value;
+        for (i = 0; ok && i < CommandArgs[type]; i++) {
+            p = GetVarint(p, end, &args[i]);
+            ok = p != NULL;
+        }
+        if (ok) {
+            ok = ApplyCommand(type, args);
+            commands++;
+        }
+    }
+
+    if (ok) {
+        ok = RunToStep(header->endStep, &steps);
+    }
+
+    elapsed = GetTickCount() - startTime;
+    checksum = GetCityChecksum();
+    if (ok) {
+        ok = checksum == header->endChecksum;
+    }
+
+    wsprintf(reportPath, "%s.log", filename);
+    f = fopen(reportPath, "w");
+    if (f != NULL) {
+        fprintf(f, "Replay: %s\n", filename);
+        fprintf(f, "Steps: %ld in %lu ms\n", steps, (unsigned long)elapsed);
+        fprintf(f, "Commands: %lu of %lu\n", commands, header->commandCount);
+        fprintf(f, "Checksum: %08lx, recorded %08lx\n", checksum, header->endChecksum);
+        fprintf(f, "Result: %s\n", ok ? "MATCH" : "MISMATCH");
+        fclose(f);
+    }
+
+    free(data);
+    return ok;
+}
@@ -0,0 +1,521 @@
+/* savefile.c - Native city save format for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * A native city file is a SaveHeader followed by a CityState, written
+ * exactly as they sit in memory. Loading maps the file (citymap.c) and
+ * block-copies the state into the simulation globals; there is no byte
+ * swapping or transposing as with the original .cty layout, which is
+ * converted once into a cached native copy.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External reference to scenario variables (defined in scenarios.c) */
+extern short ScenarioID;
+extern short DisasterEvent;
+extern short DisasterWait;
+extern short ScoreType;
+extern short ScoreWait;
+
+/* Adler-32 modulus and the largest block that cannot overflow the sums */
+#define ADLER_MOD 65521UL
+#define ADLER_NMAX 5552
+
+/* Arrays in a CityState and the globals they are saved from */
+typedef struct {
+    size_t offset;
+    void *global;
+    size_t size;
+} StateArray;
+
+static StateArray StateArrays[] = {
+    { offsetof(CityState, map), Map, sizeof(Map) },
+    { offsetof(CityState, powerMap), PowerMap, sizeof(PowerMap) },
+    { offsetof(CityState, popDensity), PopDensity, sizeof(PopDensity) },
+    { offsetof(CityState, trfDensity), TrfDensity, sizeof(TrfDensity) },
+    { offsetof(CityState, pollutionMem), PollutionMem, sizeof(PollutionMem) },
+    { offsetof(CityState, landValueMem), LandValueMem, sizeof(LandValueMem) },
+    { offsetof(CityState, crimeMem), CrimeMem, sizeof(CrimeMem) },
+    { offsetof(CityState, terrainMem), TerrainMem, sizeof(TerrainMem) },
+    { offsetof(CityState, fireStMap), FireStMap, sizeof(FireStMap) },
+    { offsetof(CityState, fireRate), FireRate, sizeof(FireRate) },
+    { offsetof(CityState, policeMap), PoliceMap, sizeof(PoliceMap) },
+    { offsetof(CityState, policeMapEffect), PoliceMapEffect, sizeof(PoliceMapEffect) },
+    { offsetof(CityState, comRate), ComRate, sizeof(ComRate) }
+};
+
+#define STATE_ARRAY_COUNT ((int)(sizeof(StateArrays) / sizeof(StateArrays[0])))
+
+/* History rings in a CityState, saved oldest entry first */
+typedef struct {
+    size_t offset;
+    short *ring;
+    int count;
+    int *head;
+} StateHistory;
+
+static StateHistory StateHistories[] = {
+    { offsetof(CityState, resHis), ResHis, HISTORY_COUNT, &HistoryHead },
+    { offsetof(CityState, comHis), ComHis, HISTORY_COUNT, &HistoryHead },
+    { offsetof(CityState, indHis), IndHis, HISTORY_COUNT, &HistoryHead },
+    { offsetof(CityState, crimeHis), CrimeHis, HISTORY_COUNT, &HistoryHead },
+    { offsetof(CityState, pollutionHis), PollutionHis, HISTORY_COUNT, &HistoryHead },
+    { offsetof(CityState, moneyHis), MoneyHis, HISTORY_COUNT, &HistoryHead },
+    { offsetof(CityState, miscHis), MiscHis, MISC_HISTORY_COUNT, &MiscHistoryHead },
+    { offsetof(CityState, resLongHis), ResLongHis, HISTORY_COUNT, &LongHistoryHead },
+    { offsetof(CityState, comLongHis), ComLongHis, HISTORY_COUNT, &LongHistoryHead },
+    { offsetof(CityState, indLongHis), IndLongHis, HISTORY_COUNT, &LongHistoryHead },
+    { offsetof(CityState, crimeLongHis), CrimeLongHis, HISTORY_COUNT, &LongHistoryHead },
+    { offsetof(CityState, pollutionLongHis), PollutionLongHis, HISTORY_COUNT, &LongHistoryHead },
+    { offsetof(CityState, moneyLongHis), MoneyLongHis, HISTORY_COUNT, &LongHistoryHead }
+};
+
+#define STATE_HISTORY_COUNT ((int)(sizeof(StateHistories) / sizeof(StateHistories[0])))
+
+/* Largest history, for unrolling a ring before comparing it */
+static short historyBuffer[HISTORY_COUNT];
+
+/* Copy the history rings into a state image in order */
+static void CaptureHistories(CityState *state) {
+    int i;
+
+    for (i = 0; i < STATE_HISTORY_COUNT; i++) {
+        ReadHistory(StateHistories[i].ring, StateHistories[i].count, *StateHistories[i].head,
+                    (short *)((Byte *)state + StateHistories[i].offset));
+    }
+}
+
+/* Make the histories in a state image the running ones */
+static void RestoreHistories(const CityState *state) {
+    int i;
+
+    for (i = 0; i < STATE_HISTORY_COUNT; i++) {
+        memcpy(StateHistories[i].ring, (const Byte *)state + StateHistories[i].offset,
+               StateHistories[i].count * sizeof(short));
+    }
+    HistoryHead = 0;
+    MiscHistoryHead = 0;
+    LongHistoryHead = 0;
+}
+
+/* Copy the scalar part of the running city into a state image */
+static void CaptureCityScalars(CityState *state) {
+    state->cityTime = CityTime;
+    state->cityYear = CityYear;
+    state->cityMonth = CityMonth;
+    state->totalFunds = TotalFunds;
+    state->taxRate = TaxRate;
+    state->scycle = Scycle;
+    state->fcycle = Fcycle;
+    state->spdcycle = Spdcycle;
+    state->simSpeed = SimSpeed;
+    state->randomState = RandomState;
+
+    state->rValve = RValve;
+    state->cValve = CValve;
+    state->iValve = IValve;
+    state->autoBudget = (short)AutoBudget;
+    state->roadPercent = RoadPercent;
+    state->policePercent = PolicePercent;
+    state->firePercent = FirePercent;
+
+    state->cityPop = CityPop;
+    state->cityYes = CityYes;
+    state->cityNo = CityNo;
+    state->cityScore = CityScore;
+    state->deltaCityScore = deltaCityScore;
+    state->cityClass = CityClass;
+    state->gameLevel = GameLevel;
+    state->resPop = ResPop;
+    state->comPop = ComPop;
+    state->indPop = IndPop;
+    state->totalPop = TotalPop;
+    state->lastTotalPop = LastTotalPop;
+
+    state->scenarioID = ScenarioID;
+    state->disasterEvent = DisasterEvent;
+    state->disasterWait = DisasterWait;
+    state->scoreType = ScoreType;
+    state->scoreWait = ScoreWait;
+    state->disasterLevel = (short)DisasterLevel;
+}
+
+/* Copy the running city into a state image */
+void CaptureCityState(CityState *state) {
+    int i;
+
+    for (i = 0; i < STATE_ARRAY_COUNT; i++) {
+        memcpy((Byte *)state + StateArrays[i].offset, StateArrays[i].global,
+               StateArrays[i].size);
+    }
+
+    CaptureHistories(state);
+    CaptureCityScalars(state);
+}
+
+/* Copy the map chunks SetTile has flagged for the autosave shadow. Returns
+ * the number of chunks copied. */
+static int CaptureChangedMap(CityState *state) {
+    int copied;
+    int cx, cy;
+    int x, y;
+    int top, bottom;
+
+    copied = 0;
+    for (cy = 0; cy < CHUNK_ROWS; cy++) {
+        top = cy * CHUNK_SIZE;
+        bottom = top + CHUNK_SIZE < WORLD_Y ? top + CHUNK_SIZE : WORLD_Y;
+
+        for (cx = 0; cx < CHUNK_COLS; cx++) {
+            if (!(TileChunks[cy][cx] & CHUNK_AUTOSAVE)) {
+                continue;
+            }
+            TileChunks[cy][cx] &= ~CHUNK_AUTOSAVE;
+
+            x = cx * CHUNK_SIZE;
+            for (y = top; y < bottom; y++) {
+                memcpy(&state->map[y][x], &Map[y][x], CHUNK_SIZE * sizeof(short));
+            }
+            copied++;
+        }
+    }
+    return copied;
+}
+
+/* Bring an earlier image up to date, copying only the chunks of each array
+ * that differ from the running city. The map is copied by the chunks
+ * SetTile flags for the autosave, so only the autosave shadow may be kept
+ * up to date this way. Returns the number of chunks copied. */
+int CaptureChangedCityState(CityState *state, unsigned long chunkSize) {
+    int i;
+    int copied;
+    size_t pos;
+    size_t n;
+    Byte *dst;
+    const Byte *src;
+
+    copied = 0;
+
+    for (i = 0; i < STATE_ARRAY_COUNT; i++) {
+        if (StateArrays[i].global == (void *)Map) {
+            copied += CaptureChangedMap(state);
+            continue;
+        }
+
+        dst = (Byte *)state + StateArrays[i].offset;
+        src = (const Byte *)StateArrays[i].global;
+
+        for (pos = 0; pos < StateArrays[i].size; pos += n) {
+            n = StateArrays[i].size - pos;
+            if (n > chunkSize) {
+                n = chunkSize;
+            }
+            if (memcmp(dst + pos, src + pos, n) != 0) {
+                memcpy(dst + pos, src + pos, n);
+                copied++;
+            }
+        }
+    }
+
+    /* Histories are small; each counts as one chunk */
+    for (i = 0; i < STATE_HISTORY_COUNT; i++) {
+        dst = (Byte *)state + StateHistories[i].offset;
+        n = StateHistories[i].count * sizeof(short);
+        ReadHistory(StateHistories[i].ring, StateHistories[i].count, *StateHistories[i].head,
+                    historyBuffer);
+        if (memcmp(dst, historyBuffer, n) != 0) {
+            memcpy(dst, historyBuffer, n);
+            copied++;
+        }
+    }
+
+    CaptureCityScalars(state);
+    return copied;
+}
+
+/* Make a state image the running city */
+void RestoreCityState(const CityState *state) {
+    int i;
+
+    for (i = 0; i < STATE_ARRAY_COUNT; i++) {
+        memcpy(StateArrays[i].global, (const Byte *)state + StateArrays[i].offset,
+               StateArrays[i].size);
+    }
+    RebuildTilePlanes();
+    RestoreHistories(state);
+
+    CityTime = (int)state->cityTime;
+    CityYear = (int)state->cityYear;
+    CityMonth = (int)state->cityMonth;
+    TotalFunds = state->totalFunds;
+    TaxRate = (int)state->taxRate;
+    Scycle = (int)state->scycle;
+    Fcycle = (int)state->fcycle;
+    Spdcycle = (int)state->spdcycle;
+    ResetSimTasks();
+    SimSpeed = (int)state->simSpeed;
+    RandomState = state->randomState;
+
+    RValve = state->rValve;
+    CValve = state->cValve;
+    IValve = state->iValve;
+    AutoBudget = state->autoBudget;
+    RoadPercent = state->roadPercent;
+    PolicePercent = state->policePercent;
+    FirePercent = state->firePercent;
+
+    CityPop = state->cityPop;
+    CityYes = (int)state->cityYes;
+    CityNo = (int)state->cityNo;
+    CityScore = (int)state->cityScore;
+    deltaCityScore = (int)state->deltaCityScore;
+    CityClass = (int)state->cityClass;
+    GameLevel = (int)state->gameLevel;
+    ResPop = (int)state->resPop;
+    ComPop = (int)state->comPop;
+    IndPop = (int)state->indPop;
+    TotalPop = (int)state->totalPop;
+    LastTotalPop = (int)state->lastTotalPop;
+
+    ScenarioID = state->scenarioID;
+    DisasterEvent = state->disasterEvent;
+    DisasterWait = state->disasterWait;
+    ScoreType = state->scoreType;
+    ScoreWait = state->scoreWait;
+    DisasterLevel = state->disasterLevel;
+
+    /* Redraw the demand indicator from the restored valves */
+    ValveFlag = 1;
+}
+
+/* Take only the parts an original city file holds: the map and history */
+void RestoreImportedCity(const CityState *state) {
+    memcpy(Map, state->map, sizeof(Map));
+    RebuildTilePlanes();
+
+    RestoreHistories(state);
+}
+
+/* Adler-32 checksum */
+unsigned long CityChecksum(const void *data, unsigned long size) {
+    const unsigned char *p;
+    unsigned long a;
+    unsigned long b;
+    unsigned long n;
+
+    p = (const unsigned char *)data;
+    a = 1;
+    b = 0;
+
+    while (size > 0) {
+        n = size < ADLER_NMAX ? size : ADLER_NMAX;
+        size -= n;
+        while (n-- > 0) {
+            a += *p++;
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+
+    return (b << 16) | a;
+}
+
+/* Fill in the header for the state already in the file image */
+void PrepareCityFile(CityFile *file, unsigned short flags) {
+    memcpy(file->header.magic, SAVE_MAGIC, 4);
+    file->header.version = SAVE_VERSION;
+    file->header.headerSize = sizeof(SaveHeader);
+    file->header.worldX = WORLD_X;
+    file->header.worldY = WORLD_Y;
+    file->header.flags = flags;
+    file->header.reserved = 0;
+    file->header.stateSize = sizeof(CityState);
+    file->header.checksum = CityChecksum(&file->state, sizeof(CityState));
+}
+
+/* Check that a header describes a state this build can restore */
+static int CheckSaveHeader(const SaveHeader *header) {
+    if (memcmp(header->magic, SAVE_MAGIC, 4) != 0) {
+        return 0;
+    }
+
+    if (header->version != SAVE_VERSION || header->headerSize != sizeof(SaveHeader) ||
+        header->stateSize != sizeof(CityState)) {
+        addDebugLog("Unsupported save version %d", header->version);
+        return 0;
+    }
+
+    if (header->worldX != WORLD_X || header->worldY != WORLD_Y) {
+        addDebugLog("Save file map is %dx%d, expected %dx%d", header->worldX, header->worldY,
+                    WORLD_X, WORLD_Y);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Validate an unpacked file image of the given size. Returns 1 if it can be
+ * restored. */
+int CheckCityFile(const CityFile *file, unsigned long size) {
+    if (size != sizeof(CityFile)) {
+        addDebugLog("Save file size %lu, expected %lu", size, (unsigned long)sizeof(CityFile));
+        return 0;
+    }
+
+    if (!CheckSaveHeader(&file->header) || (file->header.flags & SAVE_FLAG_PACKED)) {
+        return 0;
+    }
+
+    if (file->header.checksum != CityChecksum(&file->state, sizeof(CityState))) {
+        addDebugLog("Save file checksum mismatch");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Pack a prepared file image with PackBits run-length coding. The header is
+ * copied with SAVE_FLAG_PACKED set; the checksum stays that of the unpacked
+ * state. Returns the packed size, or 0 if out is too small (see
+ * PACKED_CITY_BOUND). */
+unsigned long PackCityFile(const CityFile *file, Byte *out, unsigned long outSize) {
+    const Byte *src;
+    const Byte *end;
+    const Byte *run;
+    Byte *dst;
+    Byte *dstEnd;
+    SaveHeader header;
+    int n;
+
+    if (outSize < sizeof(SaveHeader)) {
+        return 0;
+    }
+
+    header = file->header;
+    header.flags |= SAVE_FLAG_PACKED;
+    memcpy(out, &header, sizeof(SaveHeader));
+
+    src = (const Byte *)&file->state;
+    end = src + sizeof(CityState);
+    dst = out + sizeof(SaveHeader);
+    dstEnd = out + outSize;
+
+    while (src < end) {
+        /* Measure the run starting here */
+        run = src + 1;
+        while (run < end && *run == *src && run - src < 128) {
+            run++;
+        }
+        n = (int)(run - src);
+
+        if (n >= 2) {
+            /* Repeat: 257-count, then the byte */
+            if (dstEnd - dst < 2) {
+                return 0;
+            }
+            *dst++ = (Byte)(257 - n);
+            *dst++ = *src;
+            src = run;
+        } else {
+            /* Literal: gather bytes up to the next run of two */
+            run = src;
+            while (run < end && run - src < 128 && !(run + 1 < end && run[0] == run[1])) {
+                run++;
+            }
+            n = (int)(run - src);
+            if (dstEnd - dst < n + 1) {
+                return 0;
+            }
+            *dst++ = (Byte)(n - 1);
+            memcpy(dst, src, n);
+            dst += n;
+            src = run;
+        }
+    }
+
+    return (unsigned long)(dst - out);
+}
+
+/* Expand a packed file image into file. Returns 1 if the result is a valid
+ * city. */
+int UnpackCityFile(const Byte *data, unsigned long size, CityFile *file) {
+    const Byte *src;
+    const Byte *end;
+    Byte *dst;
+    Byte *dstEnd;
+    int n;
+
+    if (size < sizeof(SaveHeader)) {
+        return 0;
+    }
+
+    memcpy(&file->header, data, sizeof(SaveHeader));
+    if (!CheckSaveHeader(&file->header) || !(file->header.flags & SAVE_FLAG_PACKED)) {
+        return 0;
+    }
+
+    src = data + sizeof(SaveHeader);
+    end = data + size;
+    dst = (Byte *)&file->state;
+    dstEnd = dst + sizeof(CityState);
+
+    while (src < end && dst < dstEnd) {
+        n = *src++;
+        if (n < 128) {
+            /* n+1 literal bytes */
+            n++;
+            if (end - src < n || dstEnd - dst < n) {
+                return 0;
+            }
+            memcpy(dst, src, n);
+            src += n;
+            dst += n;
+        } else if (n > 128) {
+            /* 257-n copies of the next byte */
+            n = 257 - n;
+            if (src >= end || dstEnd - dst < n) {
+                return 0;
+            }
+            memset(dst, *src++, n);
+            dst += n;
+        }
+    }
+
+    if (dst != dstEnd || src != end) {
+        addDebugLog("Packed save file is truncated");
+        return 0;
+    }
+
+    file->header.flags &= ~SAVE_FLAG_PACKED;
+    return CheckCityFile(file, sizeof(CityFile));
+}
+
+/* Write a prepared file image */
+int WriteCityFile(const char *filename, const CityFile *file) {
+    FILE *f;
+    size_t written;
+
+    f = fopen(filename, "wb");
+    if (f == NULL) {
+        return 0;
+    }
+
+    written = fwrite(file, sizeof(CityFile), 1, f);
+
+    if (fclose(f) != 0 || written != 1) {
+        return 0;
+    }
+
+    return 1;
+}
@@ -17,16 +17,46 @@ static short CrimeMaxX, CrimeMaxY; /* Coordinates of highest crime */
 /* Temporary arrays for smoothing operations */
 static Byte tem[WORLD_X / 2][WORLD_Y / 2];  /* Temp array 1 for smoothing */
 static Byte tem2[WORLD_X / 2][WORLD_Y / 2]; /* Temp array 2 for smoothing */
-static Byte STem[WORLD_X / 4][WORLD_Y / 4]; /* Small temp array for fire/police map */
-static Byte Qtem[WORLD_X / 4][WORLD_Y / 4]; /* Quarter-size temp array */
+static Byte Qtem[WORLD_X / 4][WORLD_Y / 4]; /* Quarter-size terrain totals */
+
+/* What PTLScan read from the map last time, kept so that only the changed
+ * chunks need reading again */
+static Byte PolRaw[WORLD_X / 2][WORLD_Y / 2];     /* Pollution before smoothing */
+static Byte PolSmooth[WORLD_X / 2][WORLD_Y / 2];  /* After the first smoothing pass */
+static Byte Developed[WORLD_X / 2][WORLD_Y / 2];  /* Has tiles that give land value */
+static Byte TerrainRaw[WORLD_X / 2][WORLD_Y / 2]; /* Terrain before summing */
+static Byte ScanMark[WORLD_X / 2][WORLD_Y / 2];   /* MARK_ flags of cells to redo */
+static Byte TerrainMark[WORLD_X / 4][WORLD_Y / 4]; /* Quarter cells to smooth again */
+static short ptlCCx2 = -1, ptlCCy2 = -1;          /* Centre the land values used */
+
+/* Running totals behind LVAverage and PollutionAverage */
+static QUAD LVTotal, PolTotal;
+static int LVCount, PolCount;
+
+#define MARK_LAND    0x01   /* Land value */
+#define MARK_SMOOTH1 0x02   /* First pollution smoothing pass */
+#define MARK_SMOOTH2 0x04   /* Second pass, which gives PollutionMem */
+#define MARK_ALL     0x07
+
+int LandScanFull = 1;
+
+/* Station coverage at half size, [y][x] like the other half-size maps.
+ * It is not saved: a loaded city marks every station changed, so it is
+ * worked out again before it is next read. */
+Byte FireCover[WORLD_Y / 2][WORLD_X / 2];
+Byte PoliceCover[WORLD_Y / 2][WORLD_X / 2];
 
 /* Function prototypes */
 static void ClrTemArray(void);
 static void DoSmooth(void);
 static void DoSmooth2(void);
-static void SmoothPSMap(void);
-static void SmoothFSMap(void);
+static void SpreadCoverage(short station, int effect, Byte cover[WORLD_Y / 2][WORLD_X / 2],
+                           Byte quarter[WORLD_X / 4][WORLD_Y / 4]);
 static void SmoothTerrain(void);
+static void MarkHalfCells(int x0, int y0, int x1, int y1, int mark);
+static void SumScanMaps(void);
+static void AddTerrain(int qx, int qy);
+static void SmoothPollution(void);
 static int GetDisCC(int x, int y);
 static int GetPValueLocal(int loc);
 static int GetPDen(int zone);
@@ -107,86 +137,266 @@ static void DoSmooth2(void) {
     }
 }
 
-/* Smooth the Police Station effect map */
-static void SmoothPSMap(void) {
-    int x, y, edge;
+/* Station coverage. Each station covers its own half cell fully and
+ * COVER_STEP less for every half cell further away, so a fully funded
+ * station reaches just beyond COVER_REACH cells: 20 tiles, where the
+ * original three smoothing passes over quarter cells reached about 12. A
+ * diagonal step costs COVER_DIAG, the usual 3-4 chamfer weight, which
+ * keeps the reach roughly round. */
+#define COVER_W     (WORLD_X / 2)
+#define COVER_H     (WORLD_Y / 2)
+#define COVER_MAX   250
+#define COVER_REACH 10
+#define COVER_STEP  ((COVER_MAX + COVER_REACH) / (COVER_REACH + 1))
+#define COVER_DIAG  (COVER_STEP * 4 / 3)
+
+static int coverFireEffect = -1;     /* FireEffect the fire map was made with */
+static int coverPoliceEffect = -1;   /* PoliceEffect the police map was made with */
+
+/* Keep the better of a cell's coverage and a neighbour's less the step */
+#define COVER_FROM(c, n, step) \
+    if ((int)(n) - (step) > (int)(c)) { \
+        (c) = (Byte)((n) - (step)); \
+    }
 
-    /* Quarter size map */
-    for (x = 0; x < WORLD_X / 4; x++) {
-        for (y = 0; y < WORLD_Y / 4; y++) {
-            edge = 0;
+/* Work out the coverage of every station of one kind. Stations are found
+ * from the zone plane and seeded with a strength set by the funding level
+ * (halved without power). A two-pass distance transform then spreads the
+ * strongest coverage over the map, which takes the same time however many
+ * stations there are and however far they reach. The quarter-size map,
+ * which is saved and shown as the overlay, gets the best of each 2x2. */
+static void SpreadCoverage(short station, int effect, Byte cover[WORLD_Y / 2][WORLD_X / 2],
+                           Byte quarter[WORLD_X / 4][WORLD_Y / 4]) {
+    int strength;
+    int x, y;
+    int z;
 
-            /* Add up surrounding cells */
-            if (x > 0) {
-                edge += PoliceMap[x - 1][y];
+    if (effect > 100) {
+        effect = 100;
+    }
+    if (effect < 0) {
+        effect = 0;
+    }
+
+    memset(cover, 0, sizeof(Byte) * COVER_W * COVER_H);
+
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(TilePlanes[TILE_PLANE_ZONE], &x, &y)) {
+        if ((Map[y][x] & LOMASK) == station) {
+            strength = COVER_MAX * effect / 100;
+            if (!(Map[y][x] & POWERBIT)) {
+                strength >>= 1;
             }
-            if (x < (WORLD_X / 4 - 1)) {
-                edge += PoliceMap[x + 1][y];
+            z = cover[y >> 1][x >> 1];
+            if (strength > z) {
+                cover[y >> 1][x >> 1] = (Byte)strength;
             }
-            if (y > 0) {
-                edge += PoliceMap[x][y - 1];
+        }
+        x++;
+    }
+
+    /* Forward pass from the top left */
+    for (y = 0; y < COVER_H; y++) {
+        for (x = 0; x < COVER_W; x++) {
+            if (x > 0) {
+                COVER_FROM(cover[y][x], cover[y][x - 1], COVER_STEP);
             }
-            if (y < (WORLD_Y / 4 - 1)) {
-                edge += PoliceMap[x][y + 1];
+            if (y > 0) {
+                COVER_FROM(cover[y][x], cover[y - 1][x], COVER_STEP);
+                if (x > 0) {
+                    COVER_FROM(cover[y][x], cover[y - 1][x - 1], COVER_DIAG);
+                }
+                if (x < COVER_W - 1) {
+                    COVER_FROM(cover[y][x], cover[y - 1][x + 1], COVER_DIAG);
+                }
             }
+        }
+    }
 
-            /* Weighted average */
-            edge = (edge >> 2) + PoliceMap[x][y];
-            STem[x][y] = (Byte)(edge >> 1);
+    /* Backward pass from the bottom right */
+    for (y = COVER_H - 1; y >= 0; y--) {
+        for (x = COVER_W - 1; x >= 0; x--) {
+            if (x < COVER_W - 1) {
+                COVER_FROM(cover[y][x], cover[y][x + 1], COVER_STEP);
+            }
+            if (y < COVER_H - 1) {
+                COVER_FROM(cover[y][x], cover[y + 1][x], COVER_STEP);
+                if (x < COVER_W - 1) {
+                    COVER_FROM(cover[y][x], cover[y + 1][x + 1], COVER_DIAG);
+                }
+                if (x > 0) {
+                    COVER_FROM(cover[y][x], cover[y + 1][x - 1], COVER_DIAG);
+                }
+            }
         }
     }
 
-    /* Copy back to original map */
     for (x = 0; x < WORLD_X / 4; x++) {
         for (y = 0; y < WORLD_Y / 4; y++) {
-            PoliceMap[x][y] = STem[x][y];
+            z = cover[y << 1][x << 1];
+            if (cover[y << 1][(x << 1) + 1] > z) {
+                z = cover[y << 1][(x << 1) + 1];
+            }
+            if (cover[(y << 1) + 1][x << 1] > z) {
+                z = cover[(y << 1) + 1][x << 1];
+            }
+            if (cover[(y << 1) + 1][(x << 1) + 1] > z) {
+                z = cover[(y << 1) + 1][(x << 1) + 1];
+            }
+            quarter[x][y] = (Byte)z;
         }
     }
 }
 
-/* Smooth the Fire Station effect map */
-static void SmoothFSMap(void) {
-    int x, y, edge;
+/* Mark the half cells in a box, clipped to the map */
+static void MarkHalfCells(int x0, int y0, int x1, int y1, int mark) {
+    int x, y;
 
-    /* Quarter size map */
-    for (x = 0; x < WORLD_X / 4; x++) {
-        for (y = 0; y < WORLD_Y / 4; y++) {
-            edge = 0;
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 > WORLD_X / 2 - 1) {
+        x1 = WORLD_X / 2 - 1;
+    }
+    if (y1 > WORLD_Y / 2 - 1) {
+        y1 = WORLD_Y / 2 - 1;
+    }
 
-            /* Add up surrounding cells */
+    for (x = x0; x <= x1; x++) {
+        for (y = y0; y <= y1; y++) {
+            ScanMark[x][y] |= (Byte)mark;
+        }
+    }
+}
+
+/* Total the land value and pollution maps as they stand */
+static void SumScanMaps(void) {
+    int x, y;
+
+    LVTotal = 0;
+    LVCount = 0;
+    PolTotal = 0;
+    PolCount = 0;
+    for (y = 0; y < WORLD_Y / 2; y++) {
+        for (x = 0; x < WORLD_X / 2; x++) {
+            if (LandValueMem[y][x]) {
+                LVTotal += LandValueMem[y][x];
+                LVCount++;
+            }
+            if (PollutionMem[y][x]) {
+                PolTotal += PollutionMem[y][x];
+                PolCount++;
+            }
+        }
+    }
+}
+
+/* Total the terrain of one quarter cell and mark its smoothing kernel */
+static void AddTerrain(int qx, int qy) {
+    int x, y;
+
+    Qtem[qx][qy] = (Byte)(TerrainRaw[qx << 1][qy << 1] + TerrainRaw[(qx << 1) + 1][qy << 1] +
+                          TerrainRaw[qx << 1][(qy << 1) + 1] +
+                          TerrainRaw[(qx << 1) + 1][(qy << 1) + 1]);
+
+    for (x = qx - 1; x <= qx + 1; x++) {
+        for (y = qy - 1; y <= qy + 1; y++) {
+            if (x >= 0 && x < WORLD_X / 4 && y >= 0 && y < WORLD_Y / 4) {
+                TerrainMark[x][y] = 1;
+            }
+        }
+    }
+}
+
+/* Smooth the raw pollution twice into PollutionMem, for the marked cells
+ * only, keeping the running total */
+static void SmoothPollution(void) {
+    int x, y, z;
+
+    for (x = 0; x < WORLD_X / 2; x++) {
+        for (y = 0; y < WORLD_Y / 2; y++) {
+            if (!(ScanMark[x][y] & MARK_SMOOTH1)) {
+                continue;
+            }
+            ScanMark[x][y] &= ~MARK_SMOOTH1;
+
+            z = 0;
             if (x > 0) {
-                edge += FireStMap[x - 1][y];
+                z += PolRaw[x - 1][y];
             }
-            if (x < (WORLD_X / 4 - 1)) {
-                edge += FireStMap[x + 1][y];
+            if (x < (WORLD_X / 2 - 1)) {
+                z += PolRaw[x + 1][y];
             }
             if (y > 0) {
-                edge += FireStMap[x][y - 1];
+                z += PolRaw[x][y - 1];
             }
-            if (y < (WORLD_Y / 4 - 1)) {
-                edge += FireStMap[x][y + 1];
+            if (y < (WORLD_Y / 2 - 1)) {
+                z += PolRaw[x][y + 1];
             }
-
-            /* Weighted average */
-            edge = (edge >> 2) + FireStMap[x][y];
-            STem[x][y] = (Byte)(edge >> 1);
+            z = (z + PolRaw[x][y]) >> 2;
+            if (z > 255) {
+                z = 255;
+            }
+            PolSmooth[x][y] = (Byte)z;
         }
     }
 
-    /* Copy back to original map */
-    for (x = 0; x < WORLD_X / 4; x++) {
-        for (y = 0; y < WORLD_Y / 4; y++) {
-            FireStMap[x][y] = STem[x][y];
+    for (x = 0; x < WORLD_X / 2; x++) {
+        for (y = 0; y < WORLD_Y / 2; y++) {
+            if (!(ScanMark[x][y] & MARK_SMOOTH2)) {
+                continue;
+            }
+            ScanMark[x][y] &= ~MARK_SMOOTH2;
+
+            z = 0;
+            if (x > 0) {
+                z += PolSmooth[x - 1][y];
+            }
+            if (x < (WORLD_X / 2 - 1)) {
+                z += PolSmooth[x + 1][y];
+            }
+            if (y > 0) {
+                z += PolSmooth[x][y - 1];
+            }
+            if (y < (WORLD_Y / 2 - 1)) {
+                z += PolSmooth[x][y + 1];
+            }
+            z = (z + PolSmooth[x][y]) >> 2;
+            if (z > 255) {
+                z = 255;
+            }
+
+            /* A change here changes the cell's next land value */
+            if (z != PollutionMem[y][x]) {
+                if (PollutionMem[y][x]) {
+                    PolTotal -= PollutionMem[y][x];
+                    PolCount--;
+                }
+                if (z) {
+                    PolTotal += z;
+                    PolCount++;
+                }
+                PollutionMem[y][x] = (Byte)z;
+                ScanMark[x][y] |= MARK_LAND;
+            }
         }
     }
 }
 
-/* Smooth terrain map */
+/* Smooth terrain map, for the marked quarter cells only */
 static void SmoothTerrain(void) {
     int x, y, z;
 
     for (x = 0; x < WORLD_X / 4; x++) {
         for (y = 0; y < WORLD_Y / 4; y++) {
+            if (!TerrainMark[x][y]) {
+                continue;
+            }
+            TerrainMark[x][y] = 0;
             z = 0;
 
             /* Get average of surrounding cells */
@@ -203,8 +413,12 @@ static void SmoothTerrain(void) {
                 z += Qtem[x][y + 1];
             }
 
-            /* Average with central value */
-            TerrainMem[x][y] = (Byte)(((z >> 2) + Qtem[x][y]) >> 1);
+            /* Average with central value; land values read it next scan */
+            z = ((z >> 2) + Qtem[x][y]) >> 1;
+            if (z != TerrainMem[x][y]) {
+                TerrainMem[x][y] = (Byte)z;
+                MarkHalfCells(x << 1, y << 1, (x << 1) + 1, (y << 1) + 1, MARK_LAND);
+            }
         }
     }
 }
@@ -309,14 +523,54 @@ static void DistIntMarket(void) {
     }
 }
 
-/* Fire effect analysis - spread fire station coverage */
+/* Check whether the fire coverage must be spread again. FireAnalysis
+ * changes nothing otherwise. */
+int FireCoverageDue(void) {
+    return (CoverageNeeded & COVER_FIRE) || FireEffect != coverFireEffect;
+}
+
+/* Check whether the police coverage must be spread again */
+int PoliceCoverageDue(void) {
+    return (CoverageNeeded & COVER_POLICE) || PoliceEffect != coverPoliceEffect;
+}
+
+/* Check whether PTLScan has anything to do: a chunk of the map changed,
+ * the city centre moved, or cells still wait for their land value. */
+int LandScanDue(void) {
+    int x, y;
+
+    if (LandScanFull || CCx2 != ptlCCx2 || CCy2 != ptlCCy2) {
+        return 1;
+    }
+    for (y = 0; y < CHUNK_ROWS; y++) {
+        for (x = 0; x < CHUNK_COLS; x++) {
+            if (TileChunks[y][x] & CHUNK_LAND) {
+                return 1;
+            }
+        }
+    }
+    for (x = 0; x < WORLD_X / 2; x++) {
+        for (y = 0; y < WORLD_Y / 2; y++) {
+            if (ScanMark[x][y] & MARK_LAND) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Fire effect analysis - spread fire station coverage. Fire spread calls
+ * this too, so it always reads coverage for the stations as they stand. */
 void FireAnalysis(void) {
     int x, y;
 
-    /* Smooth the fire station map three times to spread coverage */
-    SmoothFSMap();
-    SmoothFSMap();
-    SmoothFSMap();
+    /* Only when a station or the fire budget has changed */
+    if (!FireCoverageDue()) {
+        return;
+    }
+    SpreadCoverage(FIRESTATION, FireEffect, FireCover, FireStMap);
+    coverFireEffect = FireEffect;
+    CoverageNeeded &= ~COVER_FIRE;
 
     /* Copy to fire rate map */
     for (x = 0; x < WORLD_X / 4; x++) {
@@ -336,28 +590,26 @@ void PopDenScan(void) {
     Ytot = 0;
     Ztot = 0;
 
-    /* Scan the map for populated zones */
-    for (x = 0; x < WORLD_X; x++) {
-        for (y = 0; y < WORLD_Y; y++) {
-            z = Map[y][x];
-            if (z & ZONEBIT) {
-                z = z & LOMASK;
-                SMapX = x;
-                SMapY = y;
-                z = GetPDen(z) << 3;
-                if (z > 254) {
-                    z = 254;
-                }
+    /* Scan the zone centres for population */
+    x = 0;
+    y = 0;
+    while (NextPlaneTile(TilePlanes[TILE_PLANE_ZONE], &x, &y)) {
+        z = Map[y][x] & LOMASK;
+        SMapX = x;
+        SMapY = y;
+        z = GetPDen(z) << 3;
+        if (z > 254) {
+            z = 254;
+        }
 
-                /* Add to temporary density map */
-                tem[x >> 1][y >> 1] = (Byte)z;
+        /* Add to temporary density map */
+        tem[x >> 1][y >> 1] = (Byte)z;
 
-                /* Track population center of mass */
-                Xtot += x;
-                Ytot += y;
-                Ztot++;
-            }
-        }
+        /* Track population center of mass */
+        Xtot += x;
+        Ytot += y;
+        Ztot++;
+        x++;
     }
 
     /* Triple-smooth the population density */
@@ -390,68 +642,112 @@ void PopDenScan(void) {
     CCy2 = CCy >> 1;
 }
 
-/* Calculate and scan pollution, terrain, and land value */
+/* Calculate and scan pollution, terrain, and land value. Only the chunks
+ * SetTile has flagged since the last scan are read from the map. The
+ * smoothing passes and land values are then redone for the half cells
+ * whose inputs changed and the cells their kernels reach. The results
+ * are the same as scanning the whole map. */
 void PTLScan(void) {
-    QUAD ptot, LVtot;
     int x, y, z, dis;
-    int Plevel, LVflag, LVnum, pnum, pmax;
+    int cx, cy;
+    int hx0, hy0, hx1, hy1;
+    int Plevel, LVflag, Terrain, pmax;
     int zx, zy, Mx, My;
-
-    /* Initialize terrain map */
-    for (x = 0; x < WORLD_X / 4; x++) {
-        for (y = 0; y < WORLD_Y / 4; y++) {
-            Qtem[x][y] = 0;
-        }
+    int full;
+
+    full = LandScanFull;
+    LandScanFull = 0;
+
+    if (full) {
+        /* The maps may have been filled from elsewhere, so start over */
+        MarkHalfCells(0, 0, WORLD_X / 2 - 1, WORLD_Y / 2 - 1, MARK_ALL);
+        SumScanMaps();
+    } else if (CCx2 != ptlCCx2 || CCy2 != ptlCCy2) {
+        /* Every land value depends on the distance to the centre */
+        MarkHalfCells(0, 0, WORLD_X / 2 - 1, WORLD_Y / 2 - 1, MARK_LAND);
     }
-
-    /* Initialize land value counters */
-    LVtot = 0;
-    LVnum = 0;
-
-    /* Scan the map for pollution and land value */
-    for (x = 0; x < WORLD_X / 2; x++) {
-        for (y = 0; y < WORLD_Y / 2; y++) {
-            Plevel = 0;
-            LVflag = 0;
-
-            /* Each half-cell checks four full cells */
-            zx = x << 1;
-            zy = y << 1;
-
-            for (Mx = zx; Mx <= zx + 1; Mx++) {
-                for (My = zy; My <= zy + 1; My++) {
-                    if (Mx < WORLD_X && My < WORLD_Y) {
-                        int loc = Map[My][Mx] & LOMASK;
-
-                        if (loc) {
-                            if (loc < RUBBLE) {
-                                /* Terrain (trees, water) increases terrain value */
-                                Qtem[x >> 1][y >> 1] += 15;
-                                continue;
+    ptlCCx2 = CCx2;
+    ptlCCy2 = CCy2;
+
+    /* Read the changed chunks of the map */
+    for (cy = 0; cy < CHUNK_ROWS; cy++) {
+        for (cx = 0; cx < CHUNK_COLS; cx++) {
+            if (!full && !(TileChunks[cy][cx] & CHUNK_LAND)) {
+                continue;
+            }
+            TileChunks[cy][cx] &= ~CHUNK_LAND;
+
+            hx0 = cx * CHUNK_SIZE / 2;
+            hy0 = cy * CHUNK_SIZE / 2;
+            hx1 = hx0 + CHUNK_SIZE / 2 < WORLD_X / 2 ? hx0 + CHUNK_SIZE / 2 : WORLD_X / 2;
+            hy1 = hy0 + CHUNK_SIZE / 2 < WORLD_Y / 2 ? hy0 + CHUNK_SIZE / 2 : WORLD_Y / 2;
+
+            for (x = hx0; x < hx1; x++) {
+                for (y = hy0; y < hy1; y++) {
+                    Plevel = 0;
+                    LVflag = 0;
+                    Terrain = 0;
+
+                    /* Each half-cell checks four full cells */
+                    zx = x << 1;
+                    zy = y << 1;
+
+                    for (Mx = zx; Mx <= zx + 1; Mx++) {
+                        for (My = zy; My <= zy + 1; My++) {
+                            int loc = Map[My][Mx] & LOMASK;
+
+                            if (loc) {
+                                if (loc < RUBBLE) {
+                                    /* Terrain (trees, water) increases terrain value */
+                                    Terrain += 15;
+                                    continue;
+                                }
+
+                                /* Get pollution value for this tile */
+                                Plevel += GetPValueLocal(loc);
+
+                                /* If there's development, track it for land value */
+                                if (loc >= ROADBASE) {
+                                    LVflag = 1;
+                                }
                             }
+                        }
+                    }
 
-                            /* Get pollution value for this tile */
-                            Plevel += GetPValueLocal(loc);
+                    /* Cap pollution level at max */
+                    if (Plevel > 255) {
+                        Plevel = 255;
+                    }
 
-                            /* If there's development, track it for land value */
-                            if (loc >= ROADBASE) {
-                                LVflag++;
-                            }
-                        }
+                    if (Plevel != PolRaw[x][y]) {
+                        PolRaw[x][y] = (Byte)Plevel;
+                        MarkHalfCells(x - 1, y - 1, x + 1, y + 1, MARK_SMOOTH1);
+                        MarkHalfCells(x - 2, y - 2, x + 2, y + 2, MARK_SMOOTH2);
+                    }
+                    if (LVflag != Developed[x][y]) {
+                        Developed[x][y] = (Byte)LVflag;
+                        ScanMark[x][y] |= MARK_LAND;
+                    }
+                    if (Terrain != TerrainRaw[x][y] || full) {
+                        TerrainRaw[x][y] = (Byte)Terrain;
+                        AddTerrain(x >> 1, y >> 1);
                     }
                 }
             }
+        }
+    }
 
-            /* Cap pollution level at max */
-            if (Plevel > 255) {
-                Plevel = 255;
+    /* Land values, from the pollution and terrain of the last scan */
+    for (x = 0; x < WORLD_X / 2; x++) {
+        for (y = 0; y < WORLD_Y / 2; y++) {
+            if (!(ScanMark[x][y] & MARK_LAND)) {
+                continue;
             }
-
-            /* Store in temporary array */
-            tem[x][y] = (Byte)Plevel;
+            ScanMark[x][y] &= ~MARK_LAND;
 
             /* Calculate land value if there are developed tiles */
-            if (LVflag) {
+            dis = 0;
+            if (Developed[x][y]) {
                 /* Land value equation */
                 dis = 34 - GetDisCC(x, y);
                 dis = dis << 2;
@@ -470,58 +766,51 @@ void PTLScan(void) {
                 if (dis < 1) {
                     dis = 1;
                 }
+            }
 
-                /* Store land value */
+            /* Store land value, keeping the running total */
+            z = LandValueMem[y][x];
+            if (z != dis) {
+                if (z) {
+                    LVTotal -= z;
+                    LVCount--;
+                }
+                if (dis) {
+                    LVTotal += dis;
+                    LVCount++;
+                }
                 LandValueMem[y][x] = (Byte)dis;
-
-                /* Track for average */
-                LVtot += dis;
-                LVnum++;
-            } else {
-                LandValueMem[y][x] = 0;
             }
         }
     }
 
     /* Calculate land value average */
-    if (LVnum) {
-        LVAverage = (int)(LVtot / LVnum);
+    if (LVCount) {
+        LVAverage = (int)(LVTotal / LVCount);
     } else {
         LVAverage = 0;
     }
 
     /* Smooth the pollution */
-    DoSmooth();
-    DoSmooth2();
+    SmoothPollution();
 
-    /* Find maximum pollution and calculate average */
+    /* Find maximum pollution (for the monster). Every polluted cell takes
+     * part so that ties draw the same random numbers as ever. */
     pmax = 0;
-    pnum = 0;
-    ptot = 0;
-
     for (x = 0; x < WORLD_X / 2; x++) {
         for (y = 0; y < WORLD_Y / 2; y++) {
-            z = tem[x][y];
-            PollutionMem[y][x] = (Byte)z;
-
-            if (z) {
-                /* Add to average pollution */
-                pnum++;
-                ptot += z;
-
-                /* Find location of maximum pollution (for monster) */
-                if ((z > pmax) || ((z == pmax) && (SimRandom(4) == 0))) {
-                    pmax = z;
-                    PolMaxX = x << 1;
-                    PolMaxY = y << 1;
-                }
+            z = PollutionMem[y][x];
+            if (z && ((z > pmax) || ((z == pmax) && (SimRandom(4) == 0)))) {
+                pmax = z;
+                PolMaxX = x << 1;
+                PolMaxY = y << 1;
             }
         }
     }
 
     /* Calculate pollution average */
-    if (pnum) {
-        PollutionAverage = (int)(ptot / pnum);
+    if (PolCount) {
+        PollutionAverage = (int)(PolTotal / PolCount);
     } else {
         PollutionAverage = 0;
     }
@@ -536,10 +825,12 @@ void CrimeScan(void) {
     QUAD totz;
     int x, y, z;
 
-    /* Smooth police station effect map three times */
-    SmoothPSMap();
-    SmoothPSMap();
-    SmoothPSMap();
+    /* Only when a station or the police budget has changed */
+    if (PoliceCoverageDue()) {
+        SpreadCoverage(POLICESTATION, PoliceEffect, PoliceCover, PoliceMap);
+        coverPoliceEffect = PoliceEffect;
+        CoverageNeeded &= ~COVER_POLICE;
+    }
 
     totz = 0;
     numz = 0;
@@ -562,7 +853,7 @@ void CrimeScan(void) {
                 }
 
                 /* Police stations reduce crime */
-                z -= PoliceMap[x >> 2][y >> 2];
+                z -= PoliceCover[y][x];
 
                 /* Ensure crime values are in range 0-250 */
                 if (z > 250) {
@@ -572,7 +863,10 @@ void CrimeScan(void) {
                     z = 0;
                 }
 
-                /* Store crime value */
+                /* Store crime value; high crime lowers land value */
+                if ((CrimeMem[y][x] > 190) != (z > 190)) {
+                    ScanMark[x][y] |= MARK_LAND;
+                }
                 CrimeMem[y][x] = (Byte)z;
 
                 /* Track total for average */
@@ -586,6 +880,9 @@ void CrimeScan(void) {
                 }
             } else {
                 /* No land value = no crime */
+                if (CrimeMem[y][x] > 190) {
+                    ScanMark[x][y] |= MARK_LAND;
+                }
                 CrimeMem[y][x] = 0;
             }
         }
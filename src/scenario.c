@@ -260,6 +260,7 @@ int loadScenario(int scenarioId) {
     Scycle = 0;
     Fcycle = 0;
     Spdcycle = 0;
+    ResetSimTasks();
 
     /* Set higher growth demand to encourage population increase */
     SetValves(900, 800, 700);
@@ -278,19 +279,18 @@ int loadScenario(int scenarioId) {
         int resCount = 0, comCount = 0, indCount = 0;
 
         /* Count residential, commercial, and industrial zones */
-        for (y = 0; y < WORLD_Y; y++) {
-            for (x = 0; x < WORLD_X; x++) {
-                tileValue = Map[y][x] & LOMASK;
-                if (Map[y][x] & ZONEBIT) {
-                    if (tileValue >= RESBASE && tileValue <= LASTRES) {
-                        resCount++;
-                    } else if (tileValue >= COMBASE && tileValue <= LASTCOM) {
-                        comCount++;
-                    } else if (tileValue >= INDBASE && tileValue <= LASTIND) {
-                        indCount++;
-                    }
-                }
+        x = 0;
+        y = 0;
+        while (NextPlaneTile(TilePlanes[TILE_PLANE_ZONE], &x, &y)) {
+            tileValue = Map[y][x] & LOMASK;
+            if (tileValue >= RESBASE && tileValue <= LASTRES) {
+                resCount++;
+            } else if (tileValue >= COMBASE && tileValue <= LASTCOM) {
+                comCount++;
+            } else if (tileValue >= INDBASE && tileValue <= LASTIND) {
+                indCount++;
             }
+            x++;
         }
 
         /* Set higher initial population based on zones for better gameplay */
@@ -20,17 +20,17 @@ Byte TrfDensity[WORLD_Y / 2][WORLD_X / 2];
 Byte PollutionMem[WORLD_Y / 2][WORLD_X / 2];
 Byte LandValueMem[WORLD_Y / 2][WORLD_X / 2];
 Byte CrimeMem[WORLD_Y / 2][WORLD_X / 2];
-short PowerMap[WORLD_Y][WORLD_X];
+BitPlane PowerMap;
 
-/* Quarter-sized maps for effects */
-Byte TerrainMem[WORLD_Y / 4][WORLD_X / 4];
-Byte FireStMap[WORLD_Y / 4][WORLD_X / 4];
-Byte FireRate[WORLD_Y / 4][WORLD_X / 4];
-Byte PoliceMap[WORLD_Y / 4][WORLD_X / 4];
-Byte PoliceMapEffect[WORLD_Y / 4][WORLD_X / 4];
+/* Quarter-sized maps for effects, indexed [x][y] like the scanners use them */
+Byte TerrainMem[WORLD_X / 4][WORLD_Y / 4];
+Byte FireStMap[WORLD_X / 4][WORLD_Y / 4];
+Byte FireRate[WORLD_X / 4][WORLD_Y / 4];
+Byte PoliceMap[WORLD_X / 4][WORLD_Y / 4];
+Byte PoliceMapEffect[WORLD_X / 4][WORLD_Y / 4];
 
 /* Commercial development score */
-short ComRate[WORLD_Y / 4][WORLD_X / 4];
+short ComRate[WORLD_X / 4][WORLD_Y / 4];
 
 /* Runtime simulation state */
 int SimSpeed = SPEED_MEDIUM;
@@ -117,16 +117,21 @@ static int TMapX, TMapY;
 static short CChr;
 static short CChr9;
 
+/* Random number generator state. Kept here rather than in the C library
+   so that it can be saved with the city and replayed exactly. */
+unsigned long RandomState = 12345;
+
 /* Random number generator - Windows compatible */
 void RandomlySeedRand(void) {
     /* Using a fixed seed of 12345 gives more consistent results while still allowing variation */
-    static int fixedSeed = 12345;
-    srand((unsigned int)fixedSeed);
+    RandomState = 12345;
 }
 
 /* Public random number function - available to other modules */
 int SimRandom(int range) {
-    return (rand() % range);
+    /* Same linear congruential step as the reference C library rand() */
+    RandomState = RandomState * 1103515245UL + 12345UL;
+    return (int)((RandomState >> 16) & 0x7fff) % range;
 }
 
 void DoSimInit(void) {
@@ -143,6 +148,9 @@ void DoSimInit(void) {
     oldCityPop = CityPop;
     oldCityClass = CityClass;
 
+    /* Months recorded for the previous city no longer apply */
+    ResetJournal();
+
     /* Clear all the density maps */
     memset(PopDensity, 0, sizeof(PopDensity));
     memset(TrfDensity, 0, sizeof(TrfDensity));
@@ -178,12 +186,14 @@ void DoSimInit(void) {
         }
     }
 
-    /* Clear power map and set to unpowered (0) */
+    /* The maps above were not made by the scanners, so start over */
+    LandScanFull = 1;
+
+    /* Clear power map and the power bit in the map */
+    ClearPowerMap();
     for (y = 0; y < WORLD_Y; y++) {
         for (x = 0; x < WORLD_X; x++) {
-            PowerMap[y][x] = 0; /* Use 0 instead of -1 */
-            /* Also clear the power bit in the map */
-            Map[y][x] &= ~POWERBIT;
+            SetTile(x, y, Map[y][x] & ~POWERBIT);
         }
     }
 
@@ -194,6 +204,7 @@ void DoSimInit(void) {
     Scycle = 0;
     Fcycle = 0;
     Spdcycle = 0;
+    ResetSimTasks();
 
     /* Default settings */
     SimSpeed = SPEED_MEDIUM;
@@ -289,199 +300,301 @@ void SimFrame(void) {
     }
 }
 
-void Simulate(int mod16) {
-    /* Main simulation logic */
+/* Run one simulation step regardless of speed, as the fast speed does.
+   Used when the simulation is driven without the clock. */
+void SimStep(void) {
+    Fcycle = (Fcycle + 1) & 1023;
+    Simulate(Fcycle & 15);
+}
 
-    Scycle = (Scycle + 1) & 1023;
+/* Tasks whose results other tasks read */
+#define TASK_LAND    0x01 /* Pollution and land value */
+#define TASK_DENSITY 0x02 /* Population density */
+#define TASK_TRAFFIC 0x04 /* Traffic decay */
+
+/* A piece of simulation work and when it runs. Simulate() runs the tasks
+   for the current step of the 16-step cycle in table order. A due task
+   runs when its own inputs have changed, as its needed check reports, or
+   when a task it reads from has run since it last ran. A task with
+   neither always runs. */
+typedef struct {
+    int phase;           /* Step of the cycle (Fcycle & 15) */
+    int period;          /* Runs only in cycles where Scycle is a multiple of this */
+    void (*run)(void);
+    int (*needed)(void); /* Returns 1 when the task's own inputs changed */
+    unsigned int id;     /* TASK_ flag, or 0 when no task reads its results */
+    unsigned int after;  /* TASK_ flags of the tasks it reads from */
+} SimTask;
+
+static int SimPhase = 0; /* Step of the cycle being run */
+
+/* Apply the demand valves if they have changed */
+static void AdjustValves(void) {
+    if (ValveFlag) {
+        SetValves(RValve, CValve, IValve);
+        ValveFlag = 0;
+
+        /* Log valves change */
+        addDebugLog("Demand adjusted: R=%d C=%d I=%d", RValve, CValve, IValve);
+    }
+}
 
-    /* Perform different actions based on the cycle position (mod 16) */
-    switch (mod16) {
-    case 0:
-        /* Increment time, check for disasters, process valve changes */
-        DoTimeStuff();
+/* Scan map in 8 different segments (1/8th each step) */
+static void ScanMapSegment(void) {
+    int xs = (SimPhase - 1) * (WORLD_X / 8);
+    int xe = xs + (WORLD_X / 8);
 
-        /* Adjust valves when needed */
-        if (ValveFlag) {
-            SetValves(RValve, CValve, IValve);
-            ValveFlag = 0;
+    MapScan(xs, xe, 0, WORLD_Y);
+}
 
-            /* Log valves change */
-            addDebugLog("Demand adjusted: R=%d C=%d I=%d", RValve, CValve, IValve);
-        }
+/* Tax collection and evaluation */
+static void AssessCity(void) {
+    CollectTax();        /* Collect taxes based on population */
+    CountSpecialTiles(); /* Count special buildings */
+    CityEvaluation();    /* Evaluate city conditions */
+}
 
-        /* DIRECT FIX: Run the power scan at the start of each major cycle
-           to ensure power distribution happens frequently enough */
-        DoPowerScan();
+/* Calculate traffic average */
+static void AverageTraffic(void) {
+    CalcTrafficAverage();
 
-        /* Process tile animations */
-        AnimateTiles();
-        break;
+    /* Log traffic */
+    if (TrafficAverage > 100) {
+        addDebugLog("Traffic level: %d (Heavy)", TrafficAverage);
+    } else if (TrafficAverage > 50) {
+        addDebugLog("Traffic level: %d (Moderate)", TrafficAverage);
+    }
+}
 
-    case 1:
-        /* Clear census before starting a new scan cycle */
-        ClearCensus();
-        /* FALLTHROUGH to start map scanning */
-
-    case 2:
-    case 3:
-    case 4:
-    case 5:
-    case 6:
-    case 7:
-    case 8:
-        /* Scan map in 8 different segments (1/8th each time) */
-        {
-            int xs = (mod16 - 1) * (WORLD_X / 8);
-            int xe = xs + (WORLD_X / 8);
-            MapScan(xs, xe, 0, WORLD_Y);
-        }
-        break;
+/* Update city population more frequently than just at census time */
+static void UpdateCityPop(void) {
+    if (ResPop > 0 || ComPop > 0 || IndPop > 0) {
+        CityPop = ((ResPop) + (ComPop * 8) + (IndPop * 8)) * 20;
+    } else if (CityPop == 0) {
+        CityPop = 100; /* Minimum population display */
+    }
+}
 
-    case 9:
-        /* Process taxes, maintenance, city evaluation if needed */
-        /* ClearCensus is now done in case 1 before map scanning */
+/* Check if population has gone to zero (but not initially) */
+static void CheckPopulationLoss(void) {
+    if (TotalPop > 0 || LastTotalPop == 0) {
+        LastTotalPop = TotalPop;
+    } else if (TotalPop == 0 && LastTotalPop != 0) {
+        /* ToDo: DoShowPicture(POPULATIONLOST_BIT); */
+        LastTotalPop = 0;
 
-        /* Every 4 cycles, take census for graphs */
-        if ((Scycle % CENSUSRATE) == 0) {
-            TakeCensus();
-        }
+        /* Log catastrophic population decline */
+        addGameLog("CRISIS: All citizens have left the city!");
+    }
+}
 
-        /* Every 48 cycles, do tax collection and evaluation */
-        if ((Scycle % TAXFREQ) == 0) {
-            CollectTax();        /* Collect taxes based on population */
-            CountSpecialTiles(); /* Count special buildings */
-            CityEvaluation();    /* Evaluate city conditions */
-        }
-        break;
+/* Update city class based on population */
+static void UpdateCityClass(void) {
+    CityClass = 0; /* Village */
+    if (CityPop > 2000) {
+        CityClass++; /* Town */
+    }
+    if (CityPop > 10000) {
+        CityClass++; /* City */
+    }
+    if (CityPop > 50000) {
+        CityClass++; /* Capital */
+    }
+    if (CityPop > 100000) {
+        CityClass++; /* Metropolis */
+    }
+    if (CityPop > 500000) {
+        CityClass++; /* Megalopolis */
+    }
 
-    case 10:
-        /* Process traffic decrease & other tile updates */
-        DecTrafficMap();
+    /* Log city class - only done when population changes */
+    addDebugLog("City class: %s (Pop: %d)", GetCityClassName(), (int)CityPop);
+}
 
-        /* Calculate traffic average periodically */
-        if ((Scycle % 4) == 0) {
-            CalcTrafficAverage();
+/* Do pollution, terrain, and land value */
+static void ScanPollution(void) {
+    PTLScan();
 
-            /* Log traffic */
-            if (TrafficAverage > 100) {
-                addDebugLog("Traffic level: %d (Heavy)", TrafficAverage);
-            } else if (TrafficAverage > 50) {
-                addDebugLog("Traffic level: %d (Moderate)", TrafficAverage);
-            }
-        }
+    /* Log pollution and land value */
+    addDebugLog("Pollution average: %d", PollutionAverage);
+    addDebugLog("Land value average: %d", LVAverage);
+}
 
-        /* Update city population more frequently than just at census time */
-        if (ResPop > 0 || ComPop > 0 || IndPop > 0) {
-            CityPop = ((ResPop) + (ComPop * 8) + (IndPop * 8)) * 20;
-        } else if (CityPop == 0) {
-            CityPop = 100; /* Minimum population display */
-        }
+/* Do crime map analysis */
+static void ScanCrime(void) {
+    CrimeScan();
 
-        /* Run animations for smoother motion */
-        AnimateTiles();
-        break;
+    /* Log crime level */
+    if (CrimeAverage > 100) {
+        addGameLog("WARNING: Crime level is very high (%d)", CrimeAverage);
+    } else if (CrimeAverage > 50) {
+        addDebugLog("Crime average: %d (Moderate)", CrimeAverage);
+    }
+}
 
-    case 11:
-        /* Process power grid updates */
-        DoPowerScan();
+/* Do population density scan and update fire protection effect. Fire
+   coverage changes only with the stations and the budget. */
+static void ScanPopulation(void) {
+    PopDenScan();
+    FireAnalysis();
+}
 
-        /* Check if population has gone to zero (but not initially) */
-        if (TotalPop > 0 || LastTotalPop == 0) {
-            LastTotalPop = TotalPop;
-        } else if (TotalPop == 0 && LastTotalPop != 0) {
-            /* ToDo: DoShowPicture(POPULATIONLOST_BIT); */
-            LastTotalPop = 0;
+/* Process fire spreading */
+static void SpreadFires(void) {
+    int fires;
 
-            /* Log catastrophic population decline */
-            addGameLog("CRISIS: All citizens have left the city!");
-        }
+    spreadFire();
 
-        /* Update city class based on population */
-        CityClass = 0; /* Village */
-        if (CityPop > 2000) {
-            CityClass++; /* Town */
-        }
-        if (CityPop > 10000) {
-            CityClass++; /* City */
-        }
-        if (CityPop > 50000) {
-            CityClass++; /* Capital */
-        }
-        if (CityPop > 100000) {
-            CityClass++; /* Metropolis */
-        }
-        if (CityPop > 500000) {
-            CityClass++; /* Megalopolis */
-        }
+    /* Log fire information */
+    fires = CountPlaneBits(TilePlanes[TILE_PLANE_FIRE], NULL);
+    if (fires > 0) {
+        addDebugLog("Active fires: %d", fires);
+    }
+}
 
-        /* Log city class - only done when population changes */
-        addDebugLog("City class: %s (Pop: %d)", GetCityClassName(), (int)CityPop);
-        break;
+/* Scenario disasters only run while one is pending */
+static int DisasterPending(void) {
+    return DisasterEvent != 0;
+}
 
-    case 12:
-        /* Process pollution spread (at a reduced rate) */
-        if ((Scycle % 16) == 0) {
-            PTLScan(); /* Do pollution, terrain, and land value */
+static const SimTask SimTasks[] = {
+    /* Increment time, check for disasters, process valve changes */
+    { 0, 1, DoTimeStuff, NULL, 0, 0 },
+    { 0, 1, AdjustValves, NULL, 0, 0 },
+    /* DIRECT FIX: Run the power scan at the start of each major cycle
+       to ensure power distribution happens frequently enough. It is
+       skipped while no tile it reads has changed. */
+    { 0, 1, DoPowerScan, PowerScanDue, 0, 0 },
+    { 0, 1, AnimateTiles, GetAnimationEnabled, 0, 0 },
+    { 0, 1, RequestAutosave, NULL, 0, 0 },      /* Hand this month to the autosave writer */
+    { 0, 1, BeginRecording, NULL, 0, 0 },       /* Start a recording the player asked for */
+    { 0, 1, RecordJournal, NULL, 0, 0 },        /* Keep this month for rewinding */
+    { 0, 1, RecordStats, NULL, 0, 0 },          /* Add the month to the statistics file */
+    { 0, 1, RecordHeatmaps, NULL, 0, 0 },       /* Export the overlays if a series is due */
+
+    /* Clear census before starting a new scan cycle */
+    { 1, 1, ClearCensus, NULL, 0, 0 },
+    { 1, 1, ScanMapSegment, NULL, 0, 0 },
+    { 2, 1, ScanMapSegment, NULL, 0, 0 },
+    { 3, 1, ScanMapSegment, NULL, 0, 0 },
+    { 4, 1, ScanMapSegment, NULL, 0, 0 },
+    { 5, 1, ScanMapSegment, NULL, 0, 0 },
+    { 6, 1, ScanMapSegment, NULL, 0, 0 },
+    { 7, 1, ScanMapSegment, NULL, 0, 0 },
+    { 8, 1, ScanMapSegment, NULL, 0, 0 },
+
+    /* Census for graphs, then taxes and evaluation */
+    { 9, CENSUSRATE, TakeCensus, NULL, 0, 0 },
+    { 9, TAXFREQ, AssessCity, NULL, 0, 0 },
+
+    /* Traffic decay and other tile updates */
+    { 10, 1, DecTrafficMap, NULL, TASK_TRAFFIC, 0 },
+    { 10, 4, AverageTraffic, NULL, 0, TASK_TRAFFIC },
+    { 10, 1, UpdateCityPop, NULL, 0, 0 },
+    { 10, 1, AnimateTiles, GetAnimationEnabled, 0, 0 },
+
+    /* Power grid updates and city size */
+    { 11, 1, DoPowerScan, PowerScanDue, 0, 0 },
+    { 11, 1, CheckPopulationLoss, NULL, 0, 0 },
+    { 11, 1, UpdateCityClass, NULL, 0, 0 },
+
+    /* Pollution spread (at a reduced rate, when the map has changed) and
+       special animations */
+    { 12, 16, ScanPollution, LandScanDue, TASK_LAND, 0 },
+    { 12, 2, UpdateSpecialAnimations, GetAnimationEnabled, 0, 0 },
+    { 12, 1, AnimateTiles, GetAnimationEnabled, 0, 0 },
+
+    /* Crime spread (at a reduced rate), after land value or density has
+       been redone or the police coverage has changed */
+    { 13, 4, ScanCrime, PoliceCoverageDue, 0, TASK_LAND | TASK_DENSITY },
+
+    /* Population density and fire coverage (at a reduced rate) */
+    { 14, 16, ScanPopulation, NULL, TASK_DENSITY, 0 },
+
+    /* Fire spread, scenario disasters and tile animations */
+    { 15, 4, SpreadFires, NULL, 0, 0 },
+    { 15, 1, scenarioDisaster, DisasterPending, 0, 0 },
+    { 15, 1, AnimateTiles, GetAnimationEnabled, 0, 0 }
+};
+
+#define SIM_TASK_COUNT ((int)(sizeof(SimTasks) / sizeof(SimTasks[0])))
+
+/* TASK_ flags of the tasks that have run since each task last ran */
+static unsigned int SimTaskInputs[SIM_TASK_COUNT];
+
+/* Forget which tasks have run, for a city that starts over or is loaded */
+void ResetSimTasks(void) {
+    memset(SimTaskInputs, 0, sizeof(SimTaskInputs));
+}
 
-            /* Log pollution and land value */
-            addDebugLog("Pollution average: %d", PollutionAverage);
-            addDebugLog("Land value average: %d", LVAverage);
-        }
+/* Check whether a due task has work to do */
+static int SimTaskNeeded(int i) {
+    const SimTask *task = &SimTasks[i];
 
-        /* Update special animations (power plants, etc.) - increased frequency for faster
-         * animations */
-        if ((Scycle % 2) == 0) {
-            UpdateSpecialAnimations();
-        }
+    if (task->needed == NULL && task->after == 0) {
+        return 1;
+    }
+    if (SimTaskInputs[i] & task->after) {
+        return 1;
+    }
+    return task->needed != NULL && task->needed();
+}
 
-        /* Process tile animations more frequently for smoother motion */
-        AnimateTiles();
-        break;
+/* First entry of SimTasks for each step of the cycle; the last is the end */
+static int SimPhaseStart[17];
 
-    case 13:
-        /* Process crime spread (at a reduced rate) */
-        if ((Scycle % 4) == 0) {
-            CrimeScan(); /* Do crime map analysis */
+/* Index the task table by step. The table is in step order. */
+static void IndexSimTasks(void) {
+    int phase;
+    int i;
 
-            /* Log crime level */
-            if (CrimeAverage > 100) {
-                addGameLog("WARNING: Crime level is very high (%d)", CrimeAverage);
-            } else if (CrimeAverage > 50) {
-                addDebugLog("Crime average: %d (Moderate)", CrimeAverage);
-            }
+    i = 0;
+    for (phase = 0; phase < 16; phase++) {
+        SimPhaseStart[phase] = i;
+        while (i < SIM_TASK_COUNT && SimTasks[i].phase == phase) {
+            i++;
         }
-        break;
+    }
+    SimPhaseStart[16] = i;
+}
 
-    case 14:
-        /* Process population density (at a reduced rate) */
-        if ((Scycle % 16) == 0) {
-            PopDenScan();   /* Do population density scan */
-            FireAnalysis(); /* Update fire protection effect */
-        }
-        break;
+void Simulate(int mod16) {
+    const SimTask *task;
+    int i, j;
 
-    case 15:
-        /* Process fire analysis and disasters (at a reduced rate) */
-        if ((Scycle % 4) == 0) {
-            /* Process fire spreading */
-            spreadFire();
+    /* Scycle counts whole cycles, so the periods are in cycles */
+    if (mod16 == 0) {
+        Scycle = (Scycle + 1) & 1023;
+    }
 
-            /* Log fire information */
-            if (FirePop > 0) {
-                addDebugLog("Active fires: %d", FirePop);
-            }
-        }
+    if (SimPhaseStart[16] == 0) {
+        IndexSimTasks();
+    }
+
+    BeginPhaseTiming();
 
-        /* Process disasters */
-        if (DisasterEvent) {
-            /* Process scenario-based disasters */
-            scenarioDisaster();
+    /* Run this step's tasks that are due and have work to do */
+    SimPhase = mod16;
+    for (i = SimPhaseStart[mod16]; i < SimPhaseStart[mod16 + 1]; i++) {
+        task = &SimTasks[i];
+        if ((Scycle % task->period) != 0) {
+            continue;
+        }
+        if (!SimTaskNeeded(i)) {
+            continue;
         }
+        task->run();
 
-        /* Process tile animations again at the end of the cycle */
-        AnimateTiles();
-        break;
+        /* Tell the tasks that read this one there is something new */
+        SimTaskInputs[i] = 0;
+        if (task->id != 0) {
+            for (j = 0; j < SIM_TASK_COUNT; j++) {
+                SimTaskInputs[j] |= task->id;
+            }
+        }
     }
+
+    EndPhaseTiming(mod16);
 }
 
 void DoTimeStuff(void) {
@@ -709,9 +822,20 @@ void ClearCensus(void) {
     DebugCensusReset++;
 }
 
+/* Add an entry to the long-term histories */
+static void TakeLongCensus(void) {
+    ResLongHis[LongHistoryHead] = ResPop * 8;
+    ComLongHis[LongHistoryHead] = ComPop * 8;
+    IndLongHis[LongHistoryHead] = IndPop * 8;
+    CrimeLongHis[LongHistoryHead] = CrimeAverage * 8;
+    PollutionLongHis[LongHistoryHead] = PollutionAverage * 8;
+    MoneyLongHis[LongHistoryHead] = (short)(TotalFunds / 100);
+    LongHistoryHead = (LongHistoryHead + 1) % HISTORY_COUNT;
+}
+
 void TakeCensus(void) {
     /* Store city statistics in the history arrays */
-    int i;
+    int last;
     QUAD newCityPop;
 
     /* CRITICAL: Make sure we have valid population counts even if they're small */
@@ -826,30 +950,31 @@ void TakeCensus(void) {
     /* Save current value for next comparison */
     PrevCityPop = (int)CityPop;
 
-    /* Update graph history */
-    for (i = 0; i < HISTLEN / 2 - 1; i++) {
-        ResHis[i] = ResHis[i + 1];
-        ComHis[i] = ComHis[i + 1];
-        IndHis[i] = IndHis[i + 1];
-        CrimeHis[i] = CrimeHis[i + 1];
-        PollutionHis[i] = PollutionHis[i + 1];
-        MoneyHis[i] = MoneyHis[i + 1];
-    }
-
-    /* Update miscellaneous history */
-    for (i = 0; i < MISCHISTLEN / 2 - 1; i++) {
-        MiscHis[i] = MiscHis[i + 1];
+    /* Record current values in history, replacing the oldest entry */
+    ResHis[HistoryHead] = ResPop * 8;
+    ComHis[HistoryHead] = ComPop * 8;
+    IndHis[HistoryHead] = IndPop * 8;
+    CrimeHis[HistoryHead] = CrimeAverage * 8;
+    PollutionHis[HistoryHead] = PollutionAverage * 8;
+    MoneyHis[HistoryHead] = (short)(TotalFunds / 100);
+    HistoryHead = (HistoryHead + 1) % HISTORY_COUNT;
+
+    /* Every LONGCENSUSRATE censuses also make a long-term entry */
+    if ((HistoryHead % LONGCENSUSRATE) == 0) {
+        TakeLongCensus();
     }
 
-    /* Record current values in history */
-    ResHis[HISTLEN / 2 - 1] = ResPop * 8;
-    ComHis[HISTLEN / 2 - 1] = ComPop * 8;
-    IndHis[HISTLEN / 2 - 1] = IndPop * 8;
-    CrimeHis[HISTLEN / 2 - 1] = CrimeAverage * 8;
-    PollutionHis[HISTLEN / 2 - 1] = PollutionAverage * 8;
-    MoneyHis[HISTLEN / 2 - 1] = (short)(TotalFunds / 100);
+    /* Note: MiscHis will be updated in the specific subsystem implementations;
+       until then its newest entry carries forward */
+    last = (MiscHistoryHead + MISC_HISTORY_COUNT - 1) % MISC_HISTORY_COUNT;
+    MiscHis[MiscHistoryHead] = MiscHis[last];
+    MiscHistoryHead = (MiscHistoryHead + 1) % MISC_HISTORY_COUNT;
+}
 
-    /* Note: MiscHis will be updated in the specific subsystem implementations */
+/* Copy a history ring out in order, oldest entry first */
+void ReadHistory(const short *ring, int count, int head, short *out) {
+    memcpy(out, ring + head, (count - head) * sizeof(short));
+    memcpy(out + (count - head), ring, head * sizeof(short));
 }
 
 void MapScan(int x1, int x2, int y1, int y2) {
@@ -902,6 +1027,7 @@ static UINT SimTimerID = 0;
 void SetSimulationSpeed(HWND hwnd, int speed) {
     /* Update the simulation speed */
     SimSpeed = speed;
+    RecordSpeedCommand(speed);
 
     /* Update UI (menu checkmarks) */
     UpdateSimulationMenu(hwnd, speed);
@@ -930,6 +1056,12 @@ void SetSimulationSpeed(HWND hwnd, int speed) {
 
 /* Cleanup simulation timer when program exits */
 void CleanupSimTimer(HWND hwnd) {
+    /* Let the simulation thread finish its step before tearing down */
+    StopSimThread();
+    StopAutosave();
+    StopStats();
+    StopHeatmapSeries();
+
     if (SimTimerID) {
         KillTimer(hwnd, SIM_TIMER_ID);
         SimTimerID = 0;
@@ -273,6 +273,7 @@ typedef long QUAD;
 /* Game simulation rate constants */
 #define SPEEDCYCLE      1024  /* The number of cycles before the speed counter loops from 0-1023 */
 #define CENSUSRATE      4     /* Census update rate (once per 4 passes) */
+#define LONGCENSUSRATE  12    /* Censuses per long-term history entry */
 #define TAXFREQ         48    /* Tax assessment frequency (once per 48 passes) */
 #define VALVEFREQ       16    /* Valve adjustment frequency (once every 16 passes) */
 
@@ -303,6 +304,43 @@ typedef long QUAD;
 #define SPEED_MEDIUM     2
 #define SPEED_FAST       3
 
+/* Bit planes: one bit per tile, PLANE_WORD_BITS tiles to a word */
+#define PLANE_WORD_BITS 32
+#define PLANE_ROW_WORDS ((WORLD_X + PLANE_WORD_BITS - 1) / PLANE_WORD_BITS)
+typedef unsigned long BitPlane[WORLD_Y][PLANE_ROW_WORDS];
+#define PLANE_BIT(x) (1UL << ((x) & (PLANE_WORD_BITS - 1)))
+#define PLANE_TEST(plane, x, y) (((plane)[y][(x) / PLANE_WORD_BITS] & PLANE_BIT(x)) != 0)
+#define PLANE_SET(plane, x, y) ((plane)[y][(x) / PLANE_WORD_BITS] |= PLANE_BIT(x))
+#define PLANE_CLEAR(plane, x, y) ((plane)[y][(x) / PLANE_WORD_BITS] &= ~PLANE_BIT(x))
+
+/* Tile flag planes kept in step with Map by SetTile (planes.c) */
+#define TILE_PLANE_ZONE  0      /* ZONEBIT */
+#define TILE_PLANE_ANIM  1      /* ANIMBIT */
+#define TILE_PLANE_BULL  2      /* BULLBIT */
+#define TILE_PLANE_BURN  3      /* BURNBIT */
+#define TILE_PLANE_COND  4      /* CONDBIT */
+#define TILE_PLANE_POWER 5      /* POWERBIT */
+#define TILE_PLANE_WATER 6      /* RIVER to LASTRIVEDGE */
+#define TILE_PLANE_ROAD  7      /* ROADBASE to LASTROAD */
+#define TILE_PLANE_RAIL  8      /* RAILBASE to LASTRAIL */
+#define TILE_PLANE_HOUSE 9      /* LHTHR to HHTHR, single houses */
+#define TILE_PLANE_FIRE  10     /* FIREBASE to LASTFIRE, burning tiles */
+#define TILE_PLANES      11
+
+/* Map chunks whose tiles have changed, one flag bit per consumer */
+#define CHUNK_SIZE 8
+#define CHUNK_COLS ((WORLD_X + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define CHUNK_ROWS ((WORLD_Y + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define CHUNK_SNAPSHOT(n) (1 << (n))  /* One per snapshot buffer (simthrd.c) */
+#define CHUNK_AUTOSAVE   0x08         /* Autosave shadow copy (savefile.c) */
+#define CHUNK_LAND       0x10         /* Pollution and land value scan (scanner.c) */
+#define CHUNK_ALL        0x1F
+
+/* Station coverage maps that must be worked out again (scanner.c) */
+#define COVER_FIRE   0x01
+#define COVER_POLICE 0x02
+#define COVER_ALL    0x03
+
 /* Structures */
 extern short Map[WORLD_Y][WORLD_X];      /* The main map */
 extern Byte PopDensity[WORLD_Y/2][WORLD_X/2]; /* Population density map (half size) */
@@ -310,17 +348,24 @@ extern Byte TrfDensity[WORLD_Y/2][WORLD_X/2]; /* Traffic density map (half size)
 extern Byte PollutionMem[WORLD_Y/2][WORLD_X/2]; /* Pollution density map (half size) */
 extern Byte LandValueMem[WORLD_Y/2][WORLD_X/2]; /* Land value map (half size) */
 extern Byte CrimeMem[WORLD_Y/2][WORLD_X/2];   /* Crime map (half size) */
-extern short PowerMap[WORLD_Y][WORLD_X];  /* Power connectivity map */
-
-/* Quarter-sized maps for effects */
-extern Byte TerrainMem[WORLD_Y/4][WORLD_X/4];  /* Terrain memory (quarter size) */
-extern Byte FireStMap[WORLD_Y/4][WORLD_X/4];   /* Fire station map (quarter size) */
-extern Byte FireRate[WORLD_Y/4][WORLD_X/4];    /* Fire coverage rate (quarter size) */
-extern Byte PoliceMap[WORLD_Y/4][WORLD_X/4];   /* Police station map (quarter size) */
-extern Byte PoliceMapEffect[WORLD_Y/4][WORLD_X/4]; /* Police station effect (quarter size) */
+extern Byte FireCover[WORLD_Y/2][WORLD_X/2];  /* Fire station coverage (half size) */
+extern Byte PoliceCover[WORLD_Y/2][WORLD_X/2]; /* Police station coverage (half size) */
+extern BitPlane PowerMap;                /* Tiles reached by the power scan */
+extern BitPlane TilePlanes[TILE_PLANES]; /* Map flags, one plane each */
+extern Byte TileChunks[CHUNK_ROWS][CHUNK_COLS]; /* CHUNK_ flags of changed chunks */
+extern int PowerScanNeeded;              /* A tile the power scan reads has changed */
+extern int CoverageNeeded;               /* COVER_ flags of stale coverage maps */
+extern int LandScanFull;                 /* PTLScan must read the whole map again */
+
+/* Quarter-sized maps for effects, indexed [x][y] like the scanners use them */
+extern Byte TerrainMem[WORLD_X / 4][WORLD_Y / 4];  /* Terrain memory (quarter size) */
+extern Byte FireStMap[WORLD_X / 4][WORLD_Y / 4];   /* Fire station map (quarter size) */
+extern Byte FireRate[WORLD_X / 4][WORLD_Y / 4];    /* Fire coverage rate (quarter size) */
+extern Byte PoliceMap[WORLD_X / 4][WORLD_Y / 4];   /* Police station map (quarter size) */
+extern Byte PoliceMapEffect[WORLD_X / 4][WORLD_Y / 4]; /* Police station effect (quarter size) */
 
 /* Commercial development score */
-extern short ComRate[WORLD_Y/4][WORLD_X/4];    /* Commercial score (quarter size) */
+extern short ComRate[WORLD_X / 4][WORLD_Y / 4];    /* Commercial score (quarter size) */
 
 /* Historical data for graphs */
 extern short ResHis[HISTLEN/2];      /* Residential history */
@@ -331,6 +376,23 @@ extern short PollutionHis[HISTLEN/2]; /* Pollution history */
 extern short MoneyHis[HISTLEN/2];    /* Cash flow history */
 extern short MiscHis[MISCHISTLEN/2]; /* Miscellaneous history */
 
+/* The histories are ring buffers: the oldest entry is at the head and the
+   newest just before it, so a census replaces one entry in place */
+#define HISTORY_COUNT (HISTLEN/2)          /* Entries in each census history */
+#define MISC_HISTORY_COUNT (MISCHISTLEN/2) /* Entries in MiscHis */
+extern int HistoryHead;              /* Oldest entry of the census histories */
+extern int MiscHistoryHead;          /* Oldest entry of MiscHis */
+
+/* Long-term history, one entry every LONGCENSUSRATE censuses, so it
+   reaches back twelve times as far as the census history */
+extern short ResLongHis[HISTLEN/2];
+extern short ComLongHis[HISTLEN/2];
+extern short IndLongHis[HISTLEN/2];
+extern short CrimeLongHis[HISTLEN/2];
+extern short PollutionLongHis[HISTLEN/2];
+extern short MoneyLongHis[HISTLEN/2];
+extern int LongHistoryHead;          /* Oldest entry of the long-term histories */
+
 /* Runtime simulation state */
 extern int SimSpeed;     /* 0=pause, 1=slow, 2=med, 3=fast */
 extern int SimSpeedMeta; /* Counter for adjusting sim speed, 0-3 */
@@ -407,11 +469,14 @@ extern int DisasterLevel;   /* Disaster level */
 /* Core simulation functions */
 void DoSimInit(void);
 void SimFrame(void);
+void SimStep(void);             /* One step without speed pacing */
 void Simulate(int mod16);
+void ResetSimTasks(void);
 void DoTimeStuff(void);
 void SetValves(int res, int com, int ind);
 void ClearCensus(void);
 void TakeCensus(void);
+void ReadHistory(const short *ring, int count, int head, short *out); /* Oldest first */
 void MapScan(int x1, int x2, int y1, int y2);
 int GetPValue(int x, int y);
 int TestBounds(int x, int y);
@@ -431,11 +496,22 @@ void CountPowerPlants(void);
 void QueuePowerPlant(int x, int y);
 void FindPowerPlants(void);
 void DoPowerScan(void);
+int PowerScanDue(void);
+void ClearPowerMap(void);
+
+/* Tile flag planes - planes.c */
+void SetTile(int x, int y, short value);
+void RebuildTilePlanes(void);
+int CheckTilePlanes(void);
+int NextPlaneTile(BitPlane plane, int *x, int *y);
+int CountPlaneBits(BitPlane plane, BitPlane mask); /* mask may be NULL */
+int CountPlaneBox(BitPlane plane, int x0, int y0, int x1, int y1); /* Corners included */
 
 /* Traffic-related functions - traffic.c */
 int MakeTraffic(int zoneType);
 void DecTrafficMap(void);
 void CalcTrafficAverage(void);
+extern unsigned long RandomState; /* Random generator state (sim.c) */
 void RandomlySeedRand(void); /* Initialize random number generator */
 int SimRandom(int range);  /* Random number function used by traffic system */
 
@@ -444,6 +520,9 @@ void FireAnalysis(void);    /* Fire station effect analysis */
 void PopDenScan(void);      /* Population density scan */
 void PTLScan(void);         /* Pollution/terrain/land value scan */
 void CrimeScan(void);       /* Crime level scan */
+int FireCoverageDue(void);  /* A fire station or the fire budget changed */
+int PoliceCoverageDue(void); /* A police station or the police budget changed */
+int LandScanDue(void);      /* PTLScan has changed input to read */
 
 /* Evaluation-related functions - evaluation.c */
 void EvalInit(void);           /* Initialize evaluation system */
@@ -483,6 +562,11 @@ void SetRoadPercent(float percent);      /* Set road funding percentage */
 void SetPolicePercent(float percent);    /* Set police funding percentage */
 void SetFirePercent(float percent);      /* Set fire department funding percentage */
 
+/* Funding percentages, as passed to RecordBudgetCommand() */
+#define BUDGET_ROAD   0
+#define BUDGET_POLICE 1
+#define BUDGET_FIRE   2
+
 /* Scenario functions (scenarios.c) */
 int loadScenario(int scenarioId);        /* Load a scenario by ID */
 void scenarioDisaster(void);             /* Process scenario disasters */
@@ -497,7 +581,238 @@ void makeExplosion(int x, int y);        /* Create an explosion */
 void makeMeltdown(void);                 /* Create a nuclear meltdown */
 
 /* File I/O functions (main.c) */
-int loadFile(char *filename);    /* Load city file data */
+#define CITYFILE_LEGACY 1        /* loadFile read an original .cty city */
+#define CITYFILE_NATIVE 2        /* loadFile restored a native save */
+int loadFile(char *filename);    /* Load city file data, returns CITYFILE_* or 0 */
+int saveCity(char *filename);    /* Save the running city in native format */
+
+/* Native save format (savefile.c) */
+#define SAVE_MAGIC      "MNTC"   /* MicropolisNT City */
+#define SAVE_VERSION    4        /* Bump when CityState changes */
+#define SAVE_EXTENSION  "mnc"
+#define SAVE_FLAG_IMPORTED 0x0001 /* Only map and history, converted from a .cty */
+#define SAVE_FLAG_PACKED 0x0002   /* State is PackBits compressed */
+#define LEGACY_CITY_SIZE 27120   /* Size of an original Micropolis city file */
+
+/* Complete simulation state, stored in a native save as a single image */
+typedef struct {
+    /* Maps, row-major in memory order */
+    short map[WORLD_Y][WORLD_X];
+    BitPlane powerMap;
+    Byte popDensity[WORLD_Y / 2][WORLD_X / 2];
+    Byte trfDensity[WORLD_Y / 2][WORLD_X / 2];
+    Byte pollutionMem[WORLD_Y / 2][WORLD_X / 2];
+    Byte landValueMem[WORLD_Y / 2][WORLD_X / 2];
+    Byte crimeMem[WORLD_Y / 2][WORLD_X / 2];
+    Byte terrainMem[WORLD_X / 4][WORLD_Y / 4];
+    Byte fireStMap[WORLD_X / 4][WORLD_Y / 4];
+    Byte fireRate[WORLD_X / 4][WORLD_Y / 4];
+    Byte policeMap[WORLD_X / 4][WORLD_Y / 4];
+    Byte policeMapEffect[WORLD_X / 4][WORLD_Y / 4];
+    short comRate[WORLD_X / 4][WORLD_Y / 4];
+
+    /* History */
+    short resHis[HISTLEN / 2];
+    short comHis[HISTLEN / 2];
+    short indHis[HISTLEN / 2];
+    short crimeHis[HISTLEN / 2];
+    short pollutionHis[HISTLEN / 2];
+    short moneyHis[HISTLEN / 2];
+    short miscHis[MISCHISTLEN / 2];
+    short resLongHis[HISTLEN / 2];
+    short comLongHis[HISTLEN / 2];
+    short indLongHis[HISTLEN / 2];
+    short crimeLongHis[HISTLEN / 2];
+    short pollutionLongHis[HISTLEN / 2];
+    short moneyLongHis[HISTLEN / 2];
+
+    /* Time, money and speed */
+    long cityTime;
+    long cityYear;
+    long cityMonth;
+    QUAD totalFunds;
+    long taxRate;
+    long scycle;
+    long fcycle;
+    long spdcycle;
+    long simSpeed;
+    unsigned long randomState;
+
+    /* Growth valves and budget */
+    short rValve;
+    short cValve;
+    short iValve;
+    short autoBudget;
+    float roadPercent;
+    float policePercent;
+    float firePercent;
+
+    /* Evaluation and census */
+    QUAD cityPop;
+    long cityYes;
+    long cityNo;
+    long cityScore;
+    long deltaCityScore;
+    long cityClass;
+    long gameLevel;
+    long resPop;
+    long comPop;
+    long indPop;
+    long totalPop;
+    long lastTotalPop;
+
+    /* Scenario and disaster timers */
+    short scenarioID;
+    short disasterEvent;
+    short disasterWait;
+    short scoreType;
+    short scoreWait;
+    short disasterLevel;
+} CityState;
+
+/* Header in front of the CityState image */
+typedef struct {
+    char magic[4];               /* SAVE_MAGIC */
+    unsigned short version;      /* SAVE_VERSION */
+    unsigned short headerSize;   /* sizeof(SaveHeader) */
+    unsigned short worldX;       /* WORLD_X */
+    unsigned short worldY;       /* WORLD_Y */
+    unsigned short flags;        /* SAVE_FLAG_* */
+    unsigned short reserved;
+    unsigned long stateSize;     /* sizeof(CityState) */
+    unsigned long checksum;      /* Adler-32 of the state */
+} SaveHeader;
+
+/* A native city file exactly as it sits on disk */
+typedef struct {
+    SaveHeader header;
+    CityState state;
+} CityFile;
+
+/* Largest possible packed image: one control byte per 128 literal bytes */
+#define PACKED_CITY_BOUND (sizeof(CityFile) + sizeof(CityState) / 128 + 1)
+
+void CaptureCityState(CityState *state);       /* Copy the running city */
+int CaptureChangedCityState(CityState *state, unsigned long chunkSize); /* Copy changed chunks */
+void RestoreCityState(const CityState *state); /* Make a saved city the running one */
+void RestoreImportedCity(const CityState *state); /* Map and history only */
+unsigned long CityChecksum(const void *data, unsigned long size);
+void PrepareCityFile(CityFile *file, unsigned short flags); /* Fill in the header */
+int CheckCityFile(const CityFile *file, unsigned long size); /* Validate an image */
+int WriteCityFile(const char *filename, const CityFile *file); /* Write an image */
+unsigned long PackCityFile(const CityFile *file, Byte *out, unsigned long outSize);
+int UnpackCityFile(const Byte *data, unsigned long size, CityFile *file);
+
+/* Memory-mapped city files (citymap.c) */
+typedef struct {
+    HANDLE hFile;
+    HANDLE hMapping;
+    const Byte *data;            /* Start of the read-only view */
+    unsigned long size;          /* Size of the file */
+} MappedFile;
+
+int MapCityFile(const char *filename, MappedFile *mf); /* Map a file read-only */
+void UnmapCityFile(MappedFile *mf);                    /* Release a mapping */
+int ConvertLegacyCity(const Byte *data, unsigned long size, CityState *state);
+const CityFile *OpenCityView(const char *filename, MappedFile *mf); /* Native view of any city */
+int StartHeadlessCity(const char *filename, const CityState *fresh); /* Load without windows */
+
+/* Background autosave (autosave.c) */
+extern int AutosaveEnabled;         /* Autosave once a game month */
+void RequestAutosave(void);         /* Queue a save of the running city */
+void StopAutosave(void);            /* Finish writing and stop the writer */
+
+/* Rewind journal (journal.c) */
+void RecordJournal(void);           /* Record the month just started */
+void ResetJournal(void);            /* Forget all recorded months */
+int GetJournalRange(long *first, long *last); /* Months that can be rewound to */
+int RewindJournal(long cityTime);   /* Restore the city as it was at a month */
+Byte *PutVarint(Byte *p, unsigned long v); /* 7-bit variable-length integers */
+const Byte *GetVarint(const Byte *p, const Byte *end, unsigned long *v);
+
+/* Command recording and replay (replay.c) */
+#define REPLAY_EXTENSION "mnr"
+void RequestRecording(void);        /* Start recording at the next month */
+void BeginRecording(void);          /* Called by the simulation each month */
+int StopRecording(void);            /* Returns 1 if there is a recording to write */
+void CancelRecording(void);         /* Drop a recording in progress */
+int IsRecording(void);
+int WriteRecording(const char *filename);
+void RecordToolCommand(int tool, int x, int y);
+void RecordStrokeCommand(int tool, int x0, int y0, int x1, int y1, int shape);
+void RecordSpeedCommand(int speed);
+void RecordRewindCommand(long cityTime);
+void RecordBudgetCommand(int which, float percent);
+int RunReplay(const char *filename); /* Headless replay; returns 1 on a match */
+
+/* Golden-state regression check (golden.c) */
+int RunGoldenCheck(int record);     /* Headless; returns 1 if all cities match */
+
+/* Simulation kernel benchmarks (bench.c) */
+int RunBenchmarks(void);           /* Headless; writes bench.log */
+
+/* City statistics recorder (stats.c) */
+#define STATS_EXTENSION "mns"
+int StartStats(const char *filename); /* Add a row every month to a new file */
+void StopStats(void);              /* Write the last rows and close the file */
+int IsRecordingStats(void);
+void RecordStats(void);            /* Called by the simulation each month */
+void BeginPhaseTiming(void);       /* Called around each simulation phase */
+void EndPhaseTiming(int phase);
+int RunStatsBatch(const char *filename, int years); /* Headless long run */
+
+/* Overlay heatmap export (heatmap.c) */
+#define HEATMAP_EXTENSION "mnh"
+#define HEATMAP_RAW 0                  /* Chosen overlays in one file, as held */
+#define HEATMAP_PGM 1                  /* One 8-bit PGM image per overlay */
+#define HEATMAP_LAYERS 8               /* Population, traffic, pollution, land
+                                          value, crime, police, fire, comrate */
+#define HEATMAP_ALL_LAYERS ((1 << HEATMAP_LAYERS) - 1)
+int ExportHeatmaps(const char *filename, unsigned int layers, int format);
+int StartHeatmapSeries(const char *folder, unsigned int layers, int format, int months);
+void StopHeatmapSeries(void);
+void RecordHeatmaps(void);         /* Called by the simulation each month */
+int RunHeatmapBatch(const char *filename, int years, int months); /* Headless */
+
+/* Headless map renderer (render.c) */
+extern DWORD RenderPalette[256];   /* Tileset colours as 0x00RRGGBB */
+int LoadRenderTileset(const char *filename); /* Read a tileset BMP, no GDI */
+int RenderMap(const short *map, int left, int top, int cols, int rows, int tileSize,
+              Byte *pixels, long pitch); /* Palette indices, 1-64 pixels a tile */
+int WriteRenderBMP(const char *filename, const Byte *pixels, int width, int height, long pitch);
+int RunThumbnailBatch(const char *filename, int years, int tileSize); /* Headless */
+
+/* Overview map functions (minimap.c) */
+extern HWND hwndMiniMap;            /* Overview window handle */
+LRESULT CALLBACK miniMapWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+void BuildTileColors(HBITMAP hbmTileset); /* Average tile colours from a tileset */
+void UpdateMiniMap(void);           /* Replot changed tiles in the overview */
+
+/* Simulation thread (simthrd.c) */
+#define WM_SIM_MESSAGE (WM_USER + 1) /* wParam=caption, lParam=malloc'd text */
+#define WM_LOG_REFRESH (WM_USER + 2) /* Log text changed on the simulation thread */
+
+/* Copy of the map state published by the simulation for drawing */
+typedef struct {
+    short map[WORLD_Y][WORLD_X];
+    BitPlane powerMap;
+    Byte popDensity[WORLD_Y / 2][WORLD_X / 2];
+    Byte trfDensity[WORLD_Y / 2][WORLD_X / 2];
+    Byte pollutionMem[WORLD_Y / 2][WORLD_X / 2];
+    Byte landValueMem[WORLD_Y / 2][WORLD_X / 2];
+    Byte crimeMem[WORLD_Y / 2][WORLD_X / 2];
+    long chunkSerial[CHUNK_ROWS][CHUNK_COLS]; /* Publish that last copied each chunk */
+    int fcycle;                     /* Fcycle when the snapshot was taken */
+    long serial;                    /* Increases with every publish */
+} MapSnapshot;
+
+int StartSimThread(void);           /* Start stepping the simulation */
+void StopSimThread(void);           /* Stop the simulation thread */
+void LockSimulation(void);          /* UI thread: take the simulation state */
+void UnlockSimulation(void);        /* Publish changes and release the state */
+int OnSimThread(void);              /* Is the caller the simulation thread */
+const MapSnapshot *AcquireSnapshot(void); /* Newest published snapshot (UI thread) */
+void ShowSimMessage(const char *text, const char *caption); /* Thread-safe MessageBox */
 
 /* Animation functions (animation.c) */
 void AnimateTiles(void);            /* Process animations for the entire map */
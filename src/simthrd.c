@@ -0,0 +1,233 @@
+/* simthrd.c - Simulation thread and map snapshots for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * The simulation runs on its own thread so that a slow Simulate() phase
+ * never stalls painting or input. After every step the simulation copies
+ * Map and the overlay arrays into one of three snapshot buffers and hands
+ * it to the UI thread with a single interlocked exchange, so drawing never
+ * takes a lock. Code on the UI thread that changes simulation state must
+ * bracket it with LockSimulation()/UnlockSimulation().
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* Simulation step interval - same pace as the old simulation timer */
+#define SIM_THREAD_INTERVAL 50
+
+/* Triple buffering: back (writer), middle (ready), front (renderer) */
+#define SNAP_COUNT 3
+#define SNAP_NEW 0x10 /* Set in the middle index when it holds an unread snapshot */
+
+/* External log functions */
+extern void addDebugLog(const char *format, ...);
+
+/* External variables */
+extern HWND hwndMain;
+
+static MapSnapshot Snapshots[SNAP_COUNT];
+static int snapBack = 0;             /* Owned by whoever holds SimLock */
+static volatile LONG snapMiddle = 1; /* Exchanged between the two threads */
+static int snapFront = 2;            /* Owned by the UI thread */
+static long snapSerial = 0;          /* Publish counter, guarded by SimLock */
+
+static CRITICAL_SECTION SimLock;
+static int simLockReady = 0;
+static HANDLE hSimThread = NULL;
+static DWORD simThreadId = 0;
+static volatile LONG simThreadQuit = 0;
+
+/* Copy the map chunks SetTile has changed since this back buffer was last
+ * filled, then swap the back buffer into the middle slot. Each copied chunk
+ * is stamped with the new serial so readers can skip chunks that have not
+ * changed since a snapshot they already saw. Caller must hold SimLock. */
+static void PublishSnapshot(void) {
+    MapSnapshot *snap;
+    int chunkFlag;
+    int cx, cy;
+    int x, y;
+    int top, bottom;
+
+    snap = &Snapshots[snapBack];
+    chunkFlag = CHUNK_SNAPSHOT(snapBack);
+    snapSerial++;
+
+    for (cy = 0; cy < CHUNK_ROWS; cy++) {
+        top = cy * CHUNK_SIZE;
+        bottom = top + CHUNK_SIZE < WORLD_Y ? top + CHUNK_SIZE : WORLD_Y;
+
+        for (cx = 0; cx < CHUNK_COLS; cx++) {
+            if (!(TileChunks[cy][cx] & chunkFlag)) {
+                continue;
+            }
+            TileChunks[cy][cx] &= ~chunkFlag;
+            snap->chunkSerial[cy][cx] = snapSerial;
+
+            x = cx * CHUNK_SIZE;
+            for (y = top; y < bottom; y++) {
+                memcpy(&snap->map[y][x], &Map[y][x], CHUNK_SIZE * sizeof(short));
+            }
+        }
+    }
+
+    /* The power map is one bit a tile, 1600 bytes in all */
+    if (memcmp(snap->powerMap, PowerMap, sizeof(PowerMap)) != 0) {
+        memcpy(snap->powerMap, PowerMap, sizeof(PowerMap));
+    }
+
+    /* The half-size overlays are only 3000 bytes each */
+    if (memcmp(snap->popDensity, PopDensity, sizeof(PopDensity)) != 0) {
+        memcpy(snap->popDensity, PopDensity, sizeof(PopDensity));
+    }
+    if (memcmp(snap->trfDensity, TrfDensity, sizeof(TrfDensity)) != 0) {
+        memcpy(snap->trfDensity, TrfDensity, sizeof(TrfDensity));
+    }
+    if (memcmp(snap->pollutionMem, PollutionMem, sizeof(PollutionMem)) != 0) {
+        memcpy(snap->pollutionMem, PollutionMem, sizeof(PollutionMem));
+    }
+    if (memcmp(snap->landValueMem, LandValueMem, sizeof(LandValueMem)) != 0) {
+        memcpy(snap->landValueMem, LandValueMem, sizeof(LandValueMem));
+    }
+    if (memcmp(snap->crimeMem, CrimeMem, sizeof(CrimeMem)) != 0) {
+        memcpy(snap->crimeMem, CrimeMem, sizeof(CrimeMem));
+    }
+
+    snap->fcycle = Fcycle;
+    snap->serial = snapSerial;
+
+    /* Hand the finished buffer over and take back whichever one was waiting */
+    snapBack = (int)(InterlockedExchange(&snapMiddle, snapBack | SNAP_NEW) & ~SNAP_NEW);
+}
+
+/* Return the newest published snapshot. UI thread only. */
+const MapSnapshot *AcquireSnapshot(void) {
+    if (snapMiddle & SNAP_NEW) {
+        snapFront = (int)(InterlockedExchange(&snapMiddle, snapFront) & ~SNAP_NEW);
+    }
+    return &Snapshots[snapFront];
+}
+
+/* Take exclusive access to the simulation state (UI thread) */
+void LockSimulation(void) {
+    if (simLockReady) {
+        EnterCriticalSection(&SimLock);
+    }
+}
+
+/* Publish the changes made under the lock and release it */
+void UnlockSimulation(void) {
+    if (simLockReady) {
+        PublishSnapshot();
+        LeaveCriticalSection(&SimLock);
+    }
+}
+
+/* Check if the caller is running on the simulation thread */
+int OnSimThread(void) {
+    return hSimThread != NULL && GetCurrentThreadId() == simThreadId;
+}
+
+/* Show a message box for the simulation. When called from the simulation
+ * thread the text is posted to the main window instead, since a modal box
+ * owned by another thread would deadlock against LockSimulation(). */
+void ShowSimMessage(const char *text, const char *caption) {
+    char *copy;
+
+    /* Replaying without windows: nobody to show it to */
+    if (hwndMain == NULL) {
+        addDebugLog("%s: %s", caption, text);
+        return;
+    }
+
+    if (!OnSimThread()) {
+        MessageBox(hwndMain, text, caption, MB_ICONEXCLAMATION | MB_OK);
+        return;
+    }
+
+    copy = (char *)malloc(lstrlen(text) + 1);
+    if (copy == NULL) {
+        return;
+    }
+    lstrcpy(copy, text);
+
+    /* The caption must be a string literal; the text is freed by the receiver */
+    if (!PostMessage(hwndMain, WM_SIM_MESSAGE, (WPARAM)caption, (LPARAM)copy)) {
+        free(copy);
+    }
+}
+
+/* Simulation thread - steps the simulation at the old timer pace */
+static DWORD WINAPI SimThreadProc(LPVOID param) {
+    int lastFcycle;
+
+    while (!simThreadQuit) {
+        Sleep(SIM_THREAD_INTERVAL);
+
+        EnterCriticalSection(&SimLock);
+
+        lastFcycle = Fcycle;
+        SimFrame();
+
+        /* Only publish when a simulation step actually ran */
+        if (Fcycle != lastFcycle) {
+            PublishSnapshot();
+        }
+
+        LeaveCriticalSection(&SimLock);
+    }
+
+    return 0;
+}
+
+/* Create the simulation lock and start the simulation thread */
+int StartSimThread(void) {
+    if (hSimThread != NULL) {
+        return 1;
+    }
+
+    if (!simLockReady) {
+        InitializeCriticalSection(&SimLock);
+        simLockReady = 1;
+    }
+
+    /* Make sure the renderer starts from the current map */
+    EnterCriticalSection(&SimLock);
+    PublishSnapshot();
+    LeaveCriticalSection(&SimLock);
+
+    simThreadQuit = 0;
+    hSimThread = CreateThread(NULL, 0, SimThreadProc, NULL, 0, &simThreadId);
+    if (hSimThread == NULL) {
+        OutputDebugString("Failed to create simulation thread\n");
+        return 0;
+    }
+
+    /* Keep input and painting ahead of the simulation */
+    SetThreadPriority(hSimThread, THREAD_PRIORITY_BELOW_NORMAL);
+    return 1;
+}
+
+/* Stop the simulation thread and wait for it to finish its current step */
+void StopSimThread(void) {
+    MSG msg;
+
+    if (hSimThread == NULL) {
+        return;
+    }
+
+    /* Wait for the step in progress to finish, however long it takes, so
+       nothing is torn down under it. Messages the thread sends to our
+       windows meanwhile are still delivered, or it could never finish. */
+    InterlockedExchange(&simThreadQuit, 1);
+    while (MsgWaitForMultipleObjects(1, &hSimThread, FALSE, INFINITE, QS_SENDMESSAGE) ==
+           WAIT_OBJECT_0 + 1) {
+        PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE);
+    }
+    CloseHandle(hSimThread);
+    hSimThread = NULL;
+    simThreadId = 0;
+}
@@ -0,0 +1,367 @@
+/* stats.c - City statistics recorder for MicropolisNT
+ * Based on original Micropolis code from MicropolisLegacy project
+ *
+ * While a statistics file is open, the simulation adds a row at the start
+ * of every game month: population, funds, growth valves, the city-wide
+ * averages, powered zones, the score and the time spent in each of the
+ * sixteen simulation phases. Rows are gathered column by column into
+ * chunks of STATS_CHUNK_ROWS. A full chunk is handed to a low-priority
+ * writer thread, which encodes it and appends it to the file, so the
+ * simulation only waits if the writer falls a whole chunk behind.
+ *
+ * File layout: a StatsHeader, the column names as NUL-terminated strings,
+ * then the chunks. Each chunk is a StatsChunkHeader followed by every
+ * column in turn, each value stored as the zigzag-encoded difference from
+ * the row before (the first row from zero) in a 7-bit variable-length
+ * integer. A chunk can be decoded on its own; a column that holds steady
+ * costs one byte a row.
+ */
+
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "gdifix.h"
+
+/* External log functions */
+extern void addGameLog(const char *format, ...);
+extern void addDebugLog(const char *format, ...);
+
+/* External variables */
+extern char progPathName[MAX_PATH];
+
+#define STATS_MAGIC "MNTS"
+#define STATS_VERSION 1
+#define STATS_CHUNK_ROWS 256
+
+/* Columns, in file order */
+#define COL_CITY_TIME 0
+#define COL_RES_POP 1
+#define COL_COM_POP 2
+#define COL_IND_POP 3
+#define COL_CITY_POP 4
+#define COL_FUNDS 5
+#define COL_RVALVE 6
+#define COL_CVALVE 7
+#define COL_IVALVE 8
+#define COL_TRAFFIC 9
+#define COL_POLLUTION 10
+#define COL_CRIME 11
+#define COL_LAND_VALUE 12
+#define COL_POWERED 13
+#define COL_UNPOWERED 14
+#define COL_SCORE 15
+#define COL_PHASE 16          /* Sixteen columns of microseconds per phase */
+#define STATS_COLUMNS (COL_PHASE + 16)
+
+static const char *ColumnNames[STATS_COLUMNS] = {
+    "CityTime", "ResPop", "ComPop", "IndPop", "CityPop", "TotalFunds", "RValve", "CValve",
+    "IValve", "TrafficAverage", "PollutionAverage", "CrimeAverage", "LVAverage", "PwrdZCnt",
+    "UnpwrdZCnt", "CityScore", "Phase0us", "Phase1us", "Phase2us", "Phase3us", "Phase4us",
+    "Phase5us", "Phase6us", "Phase7us", "Phase8us", "Phase9us", "Phase10us", "Phase11us",
+    "Phase12us", "Phase13us", "Phase14us", "Phase15us"
+};
+
+typedef struct {
+    char magic[4];               /* STATS_MAGIC */
+    unsigned short version;      /* STATS_VERSION */
+    unsigned short columns;      /* STATS_COLUMNS */
+    unsigned long chunkRows;     /* Most rows in a chunk */
+} StatsHeader;
+
+typedef struct {
+    unsigned long rows;          /* Rows in this chunk */
+    unsigned long bytes;         /* Encoded size of the columns that follow */
+} StatsChunkHeader;
+
+/* Two chunks: one being filled by the simulation, one being written */
+static long chunkValues[2][STATS_COLUMNS][STATS_CHUNK_ROWS];
+static int chunkRows[2];
+static int fillChunk = 0;
+
+static Byte encodeBuffer[sizeof(StatsChunkHeader) + STATS_COLUMNS * STATS_CHUNK_ROWS * 5];
+
+static HANDLE hStatsFile = INVALID_HANDLE_VALUE;
+static HANDLE hWriterThread = NULL;
+static HANDLE hWriteEvent = NULL;
+static HANDLE hIdleEvent = NULL;
+static volatile LONG writerBusy = 0;  /* Writer owns the other chunk */
+static volatile LONG writerQuit = 0;
+static volatile LONG writeFailed = 0;
+
+/* Phase timing since the last row */
+static double timerTicksPerUs;
+static LARGE_INTEGER phaseStart;
+static double phaseTicks[16];
+
+static CityState batchStart;     /* The game as it was before a batch run */
+
+/* Encode a chunk into encodeBuffer. Returns the size. */
+static unsigned long EncodeChunk(int chunk) {
+    StatsChunkHeader *header;
+    Byte *p;
+    long prev;
+    long delta;
+    int col;
+    int row;
+
+    header = (StatsChunkHeader *)encodeBuffer;
+    p = encodeBuffer + sizeof(StatsChunkHeader);
+
+    for (col = 0; col < STATS_COLUMNS; col++) {
+        prev = 0;
+        for (row = 0; row < chunkRows[chunk]; row++) {
+            delta = chunkValues[chunk][col][row] - prev;
+            prev = chunkValues[chunk][col][row];
+            p = PutVarint(p, delta < 0 ? ((unsigned long)~delta << 1) | 1
+                                       : (unsigned long)delta << 1);
+        }
+    }
+
+    header->rows = (unsigned long)chunkRows[chunk];
+    header->bytes = (unsigned long)(p - encodeBuffer) - sizeof(StatsChunkHeader);
+    return (unsigned long)(p - encodeBuffer);
+}
+
+/* Encode a chunk and append it to the file */
+static void WriteChunk(int chunk) {
+    unsigned long size;
+    DWORD written;
+
+    if (chunkRows[chunk] == 0) {
+        return;
+    }
+
+    size = EncodeChunk(chunk);
+    if (!WriteFile(hStatsFile, encodeBuffer, size, &written, NULL) || written != size) {
+        InterlockedExchange(&writeFailed, 1);
+    }
+    chunkRows[chunk] = 0;
+}
+
+/* Writer thread - writes each chunk it is handed */
+static DWORD WINAPI StatsThreadProc(LPVOID param) {
+    while (WaitForSingleObject(hWriteEvent, INFINITE) == WAIT_OBJECT_0 && !writerQuit) {
+        WriteChunk(1 - fillChunk);
+        InterlockedExchange(&writerBusy, 0);
+        SetEvent(hIdleEvent);
+    }
+
+    return 0;
+}
+
+/* Wait for the writer to finish the chunk it holds */
+static void WaitForWriter(void) {
+    while (writerBusy) {
+        WaitForSingleObject(hIdleEvent, 1000);
+    }
+}
+
+/* Stop the writer thread */
+static void StopStatsThread(void) {
+    if (hWriterThread == NULL) {
+        return;
+    }
+
+    WaitForWriter();
+    InterlockedExchange(&writerQuit, 1);
+    SetEvent(hWriteEvent);
+    WaitForSingleObject(hWriterThread, 5000);
+
+    CloseHandle(hWriterThread);
+    CloseHandle(hWriteEvent);
+    CloseHandle(hIdleEvent);
+    hWriterThread = NULL;
+    hWriteEvent = NULL;
+    hIdleEvent = NULL;
+}
+
+/* Open a statistics file and start adding rows from the next month.
+ * Caller must hold the simulation lock. Returns 0 if the file cannot be
+ * created. */
+int StartStats(const char *filename) {
+    StatsHeader header;
+    LARGE_INTEGER freq;
+    DWORD written;
+    DWORD threadId;
+    int ok;
+    int i;
+
+    StopStats();
+
+    if (!QueryPerformanceFrequency(&freq) || freq.QuadPart == 0) {
+        return 0;
+    }
+    timerTicksPerUs = (double)freq.QuadPart / 1000000.0;
+
+    hStatsFile = CreateFile(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hStatsFile == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    memcpy(header.magic, STATS_MAGIC, 4);
+    header.version = STATS_VERSION;
+    header.columns = STATS_COLUMNS;
+    header.chunkRows = STATS_CHUNK_ROWS;
+    ok = WriteFile(hStatsFile, &header, sizeof(header), &written, NULL) &&
+         written == sizeof(header);
+    for (i = 0; ok && i < STATS_COLUMNS; i++) {
+        ok = WriteFile(hStatsFile, ColumnNames[i], lstrlen(ColumnNames[i]) + 1, &written, NULL);
+    }
+
+    hWriteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    hIdleEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    writerBusy = 0;
+    writerQuit = 0;
+    writeFailed = 0;
+    if (ok && hWriteEvent != NULL && hIdleEvent != NULL) {
+        hWriterThread = CreateThread(NULL, 0, StatsThreadProc, NULL, 0, &threadId);
+    }
+    if (hWriterThread == NULL) {
+        if (hWriteEvent) {
+            CloseHandle(hWriteEvent);
+        }
+        if (hIdleEvent) {
+            CloseHandle(hIdleEvent);
+        }
+        hWriteEvent = NULL;
+        hIdleEvent = NULL;
+        CloseHandle(hStatsFile);
+        hStatsFile = INVALID_HANDLE_VALUE;
+        return 0;
+    }
+    SetThreadPriority(hWriterThread, THREAD_PRIORITY_LOWEST);
+
+    chunkRows[0] = 0;
+    chunkRows[1] = 0;
+    fillChunk = 0;
+    memset(phaseTicks, 0, sizeof(phaseTicks));
+    return 1;
+}
+
+/* Write out the rows gathered so far and close the file. Caller must hold
+ * the simulation lock. */
+void StopStats(void) {
+    if (hStatsFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    StopStatsThread();
+    WriteChunk(fillChunk);
+    CloseHandle(hStatsFile);
+    hStatsFile = INVALID_HANDLE_VALUE;
+
+    if (writeFailed) {
+        addGameLog("Statistics file could not be written in full");
+    }
+}
+
+/* Check if a statistics file is open */
+int IsRecordingStats(void) {
+    return hStatsFile != INVALID_HANDLE_VALUE;
+}
+
+/* Called by the simulation before each phase */
+void BeginPhaseTiming(void) {
+    if (hStatsFile != INVALID_HANDLE_VALUE) {
+        QueryPerformanceCounter(&phaseStart);
+    }
+}
+
+/* Called by the simulation after each phase */
+void EndPhaseTiming(int phase) {
+    LARGE_INTEGER now;
+
+    if (hStatsFile != INVALID_HANDLE_VALUE) {
+        QueryPerformanceCounter(&now);
+        phaseTicks[phase & 15] += (double)(now.QuadPart - phaseStart.QuadPart);
+    }
+}
+
+/* Called by the simulation at the start of each month. Adds a row and
+ * hands the chunk to the writer when it is full. */
+void RecordStats(void) {
+    long *row[STATS_COLUMNS];
+    int n;
+    int i;
+
+    if (hStatsFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    n = chunkRows[fillChunk];
+    for (i = 0; i < STATS_COLUMNS; i++) {
+        row[i] = &chunkValues[fillChunk][i][n];
+    }
+
+    *row[COL_CITY_TIME] = CityTime;
+    *row[COL_RES_POP] = ResPop;
+    *row[COL_COM_POP] = ComPop;
+    *row[COL_IND_POP] = IndPop;
+    *row[COL_CITY_POP] = CityPop;
+    *row[COL_FUNDS] = TotalFunds;
+    *row[COL_RVALVE] = RValve;
+    *row[COL_CVALVE] = CValve;
+    *row[COL_IVALVE] = IValve;
+    *row[COL_TRAFFIC] = TrafficAverage;
+    *row[COL_POLLUTION] = PollutionAverage;
+    *row[COL_CRIME] = CrimeAverage;
+    *row[COL_LAND_VALUE] = LVAverage;
+    *row[COL_POWERED] = PwrdZCnt;
+    *row[COL_UNPOWERED] = UnpwrdZCnt;
+    *row[COL_SCORE] = CityScore;
+    for (i = 0; i < 16; i++) {
+        *row[COL_PHASE + i] = (long)(phaseTicks[i] / timerTicksPerUs);
+        phaseTicks[i] = 0.0;
+    }
+
+    if (++chunkRows[fillChunk] < STATS_CHUNK_ROWS) {
+        return;
+    }
+
+    /* Swap chunks; only waits if the writer is a whole chunk behind */
+    WaitForWriter();
+    fillChunk = 1 - fillChunk;
+    InterlockedExchange(&writerBusy, 1);
+    SetEvent(hWriteEvent);
+}
+
+/* Run a city for a number of game years without windows, writing its
+ * statistics to <city>.mns next to the program. Returns 1 on success. */
+int RunStatsBatch(const char *filename, int years) {
+    char statsPath[MAX_PATH];
+    const char *base;
+    const char *p;
+    char *dot;
+    long steps;
+    long i;
+
+    base = filename;
+    for (p = filename; *p; p++) {
+        if (*p == '\\' || *p == '/' || *p == ':') {
+            base = p + 1;
+        }
+    }
+    wsprintf(statsPath, "%s\\%s", progPathName, base);
+    dot = strrchr(statsPath, '.');
+    if (dot && dot > strrchr(statsPath, '\\')) {
+        *dot = '\0';
+    }
+    lstrcat(statsPath, "." STATS_EXTENSION);
+
+    AutosaveEnabled = 0;
+    CaptureCityState(&batchStart);
+    if (!StartHeadlessCity(filename, &batchStart) || !StartStats(statsPath)) {
+        return 0;
+    }
+
+    steps = (long)years * 12L * 16L;
+    for (i = 0; i < steps; i++) {
+        SimStep();
+    }
+
+    StopStats();
+    return !writeFailed;
+}
@@ -27,6 +27,9 @@ extern short RValve, CValve, IValve;
 /* External reference to main window handle */
 extern HWND hwndMain;
 
+/* Repaint part of the map view (main.c) */
+extern void InvalidateMapTiles(int left, int top, int right, int bottom);
+
 /* External reference to Map array */
 extern short Map[WORLD_Y][WORLD_X];
 
@@ -197,7 +200,7 @@ int ConnectTile(int x, int y, short *tilePtr, int command) {
             tile &= LOMASK;
             if (tile >= RUBBLE && tile <= LASTRUBBLE) {
                 Spend(1);
-                *tilePtr = DIRT;
+                SetTile(x, y, DIRT);
             }
         }
     }
@@ -586,7 +589,7 @@ void put3x3Rubble(int x, int y) {
             if (TestBounds(xx, yy)) {
                 /* Clear the zone bit but preserve other flags */
                 mask = Map[yy][xx] & ~ZONEBIT;
-                Map[yy][xx] = mask;
+                SetTile(xx, yy, mask);
             }
         }
     }
@@ -597,7 +600,7 @@ void put3x3Rubble(int x, int y) {
             if (TestBounds(xx, yy)) {
                 zz = Map[yy][xx] & LOMASK;
                 if ((zz != RADTILE) && (zz != 0)) {
-                    Map[yy][xx] = SOMETINYEXP | ANIMBIT | BULLBIT;
+                    SetTile(xx, yy, SOMETINYEXP | ANIMBIT | BULLBIT);
                 }
             }
         }
@@ -616,7 +619,7 @@ void put4x4Rubble(int x, int y) {
             if (TestBounds(xx, yy)) {
                 /* Clear the zone bit but preserve other flags */
                 mask = Map[yy][xx] & ~ZONEBIT;
-                Map[yy][xx] = mask;
+                SetTile(xx, yy, mask);
             }
         }
     }
@@ -627,7 +630,7 @@ void put4x4Rubble(int x, int y) {
             if (TestBounds(xx, yy)) {
                 zz = Map[yy][xx] & LOMASK;
                 if ((zz != RADTILE) && (zz != 0)) {
-                    Map[yy][xx] = SOMETINYEXP | ANIMBIT | BULLBIT;
+                    SetTile(xx, yy, SOMETINYEXP | ANIMBIT | BULLBIT);
                 }
             }
         }
@@ -646,7 +649,7 @@ void put6x6Rubble(int x, int y) {
             if (TestBounds(xx, yy)) {
                 /* Clear the zone bit but preserve other flags */
                 mask = Map[yy][xx] & ~ZONEBIT;
-                Map[yy][xx] = mask;
+                SetTile(xx, yy, mask);
             }
         }
     }
@@ -657,7 +660,7 @@ void put6x6Rubble(int x, int y) {
             if (TestBounds(xx, yy)) {
                 zz = Map[yy][xx] & LOMASK;
                 if ((zz != RADTILE) && (zz != 0)) {
-                    Map[yy][xx] = SOMETINYEXP | ANIMBIT | BULLBIT;
+                    SetTile(xx, yy, SOMETINYEXP | ANIMBIT | BULLBIT);
                 }
             }
         }
@@ -722,7 +725,7 @@ int LayDoze(int x, int y, short *tilePtr) {
         default:
             /* Unknown zone type - convert to rubble instead of just clearing */
             Spend(1);
-            *tilePtr = RUBBLE | BULLBIT;
+            SetTile(x, y, RUBBLE | BULLBIT);
             return 1;
         }
     }
@@ -766,13 +769,13 @@ int LayDoze(int x, int y, short *tilePtr) {
     if (tile == HANDBALL || tile == LHBALL || tile == HBRIDGE || tile == VBRIDGE || tile == BRWH ||
         tile == BRWV) {
         Spend(5);
-        *tilePtr = RIVER;
+        SetTile(x, y, RIVER);
         return 1;
     }
 
     /* General bulldozing of other tiles */
     Spend(1);
-    *tilePtr = DIRT;
+    SetTile(x, y, DIRT);
     return 1;
 }
 
@@ -792,9 +795,9 @@ int LayRoad(int x, int y, short *tilePtr) {
         Spend(cost);
         if (((y > 0) && (Map[y - 1][x] & LOMASK) == VRAIL) ||
             ((y < WORLD_Y - 1) && (Map[y + 1][x] & LOMASK) == VRAIL)) {
-            *tilePtr = VRAILROAD | BULLBIT;
+            SetTile(x, y, VRAILROAD | BULLBIT);
         } else {
-            *tilePtr = HBRIDGE | BULLBIT;
+            SetTile(x, y, HBRIDGE | BULLBIT);
         }
         return 1;
     }
@@ -811,10 +814,10 @@ int LayRoad(int x, int y, short *tilePtr) {
             (Map[y-1][x] & LOMASK) >= POWERBASE && (Map[y-1][x] & LOMASK) <= LASTPOWER &&
             (Map[y+1][x] & LOMASK) >= POWERBASE && (Map[y+1][x] & LOMASK) <= LASTPOWER) {
             /* Vertical power line needs horizontal road crossing */
-            *tilePtr = HROADPOWER | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, HROADPOWER | CONDBIT | BULLBIT | BURNBIT);
         } else {
             /* Horizontal power line needs vertical road crossing */
-            *tilePtr = VROADPOWER | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, VROADPOWER | CONDBIT | BULLBIT | BURNBIT);
         }
         return 1;
     }
@@ -828,7 +831,7 @@ int LayRoad(int x, int y, short *tilePtr) {
         }
 
         Spend(cost);
-        *tilePtr = ROADS | BULLBIT | BURNBIT;
+        SetTile(x, y, ROADS | BULLBIT | BURNBIT);
         return 1;
     }
 
@@ -850,7 +853,7 @@ int LayRail(int x, int y, short *tilePtr) {
         }
 
         Spend(cost);
-        *tilePtr = HRAIL | BULLBIT;
+        SetTile(x, y, HRAIL | BULLBIT);
         return 1;
     }
     
@@ -866,10 +869,10 @@ int LayRail(int x, int y, short *tilePtr) {
             (Map[y-1][x] & LOMASK) >= POWERBASE && (Map[y-1][x] & LOMASK) <= LASTPOWER &&
             (Map[y+1][x] & LOMASK) >= POWERBASE && (Map[y+1][x] & LOMASK) <= LASTPOWER) {
             /* Vertical power line needs horizontal rail crossing */
-            *tilePtr = RAILHPOWERV | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, RAILHPOWERV | CONDBIT | BULLBIT | BURNBIT);
         } else {
             /* Horizontal power line needs vertical rail crossing */
-            *tilePtr = RAILVPOWERH | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, RAILVPOWERH | CONDBIT | BULLBIT | BURNBIT);
         }
         return 1;
     }
@@ -883,7 +886,7 @@ int LayRail(int x, int y, short *tilePtr) {
         }
 
         Spend(cost);
-        *tilePtr = RAILBASE | BULLBIT | BURNBIT;
+        SetTile(x, y, RAILBASE | BULLBIT | BURNBIT);
         return 1;
     }
 
@@ -937,14 +940,14 @@ int LayWire(int x, int y, short *tilePtr) {
 
         if (connectMask != 0) {
             /* Use the proper tile from the wire table */
-            *tilePtr = WireTable[connectMask & 15] | CONDBIT | BULLBIT;
+            SetTile(x, y, WireTable[connectMask & 15] | CONDBIT | BULLBIT);
         } else if ((x > 0 && x < WORLD_X - 1) && 
                   (Map[y][x-1] & CONDBIT) && (Map[y][x+1] & CONDBIT)) {
             /* Horizontal connection needed */
-            *tilePtr = HPOWER | CONDBIT | BULLBIT;
+            SetTile(x, y, HPOWER | CONDBIT | BULLBIT);
         } else {
             /* Default to vertical power line for underwater */
-            *tilePtr = VPOWER | CONDBIT | BULLBIT; 
+            SetTile(x, y, VPOWER | CONDBIT | BULLBIT); 
         }
         return 1;
     }
@@ -961,10 +964,10 @@ int LayWire(int x, int y, short *tilePtr) {
             (Map[y][x-1] & LOMASK) >= ROADBASE && (Map[y][x-1] & LOMASK) <= LASTROAD &&
             (Map[y][x+1] & LOMASK) >= ROADBASE && (Map[y][x+1] & LOMASK) <= LASTROAD) {
             /* Horizontal road needs vertical power line crossing */
-            *tilePtr = VROADPOWER | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, VROADPOWER | CONDBIT | BULLBIT | BURNBIT);
         } else {
             /* Vertical road needs horizontal power line crossing */
-            *tilePtr = HROADPOWER | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, HROADPOWER | CONDBIT | BULLBIT | BURNBIT);
         }
         return 1;
     }
@@ -981,10 +984,10 @@ int LayWire(int x, int y, short *tilePtr) {
             (Map[y][x-1] & LOMASK) >= RAILBASE && (Map[y][x-1] & LOMASK) <= LASTRAIL &&
             (Map[y][x+1] & LOMASK) >= RAILBASE && (Map[y][x+1] & LOMASK) <= LASTRAIL) {
             /* Horizontal rail needs vertical power line crossing */
-            *tilePtr = RAILVPOWERH | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, RAILVPOWERH | CONDBIT | BULLBIT | BURNBIT);
         } else {
             /* Vertical rail needs horizontal power line crossing */
-            *tilePtr = RAILHPOWERV | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, RAILHPOWERV | CONDBIT | BULLBIT | BURNBIT);
         }
         return 1;
     }
@@ -1031,17 +1034,17 @@ int LayWire(int x, int y, short *tilePtr) {
         /* If we have connections, choose the appropriate power line tile */
         if (connectMask != 0) {
             /* Use the proper tile from the wire table */
-            *tilePtr = WireTable[connectMask & 15] | CONDBIT | BULLBIT | BURNBIT;
+            SetTile(x, y, WireTable[connectMask & 15] | CONDBIT | BULLBIT | BURNBIT);
         } else {
             /* Special case for vertical alignment - if this is a second vertical tile, 
                use VPOWER instead of LHPOWER to avoid the upside-down L issue */
             if (y > 0 && (Map[y-1][x] & LOMASK) == VPOWER) {
-                *tilePtr = VPOWER | CONDBIT | BULLBIT | BURNBIT;
+                SetTile(x, y, VPOWER | CONDBIT | BULLBIT | BURNBIT);
             } else if (y < WORLD_Y - 1 && (Map[y+1][x] & LOMASK) == VPOWER) {
-                *tilePtr = VPOWER | CONDBIT | BULLBIT | BURNBIT;
+                SetTile(x, y, VPOWER | CONDBIT | BULLBIT | BURNBIT);
             } else {
                 /* Default to LHPOWER (horizontal power line) */
-                *tilePtr = LHPOWER | CONDBIT | BULLBIT | BURNBIT;
+                SetTile(x, y, LHPOWER | CONDBIT | BULLBIT | BURNBIT);
             }
         }
         return 1;
@@ -1088,6 +1091,13 @@ short NormalizeRoad(short tile) {
     return tile;
 }
 
+/* Is this (normalized) tile one of the road, rail and power crossings? */
+static int IsCrossingTile(short tile) {
+    return tile == HROADPOWER || tile == VROADPOWER ||
+           tile == RAILHPOWERV || tile == RAILVPOWERH ||
+           tile == HRAILROAD || tile == VRAILROAD;
+}
+
 /* Fix a single tile - update its connections 
  * Closely follows MicropolisJS's fixSingle implementation
  */
@@ -1163,7 +1173,7 @@ void FixSingle(int x, int y) {
 
         /* Update the road tile with proper connections */
         tile = RoadTable[adjTile];
-        Map[y][x] = (Map[y][x] & MASKBITS) | tile | BULLBIT | BURNBIT;
+        SetTile(x, y, (Map[y][x] & MASKBITS) | tile | BULLBIT | BURNBIT);
         return;
     }
 
@@ -1215,7 +1225,7 @@ void FixSingle(int x, int y) {
 
         /* Update the rail tile with proper connections */
         tile = RailTable[adjTile];
-        Map[y][x] = (Map[y][x] & MASKBITS) | tile | BULLBIT | BURNBIT;
+        SetTile(x, y, (Map[y][x] & MASKBITS) | tile | BULLBIT | BURNBIT);
         return;
     }
 
@@ -1267,25 +1277,25 @@ void FixSingle(int x, int y) {
 
         /* Update the wire tile with proper connections */
         tile = WireTable[adjTile];
-        Map[y][x] = (Map[y][x] & MASKBITS) | tile | BULLBIT | BURNBIT | CONDBIT;
+        SetTile(x, y, (Map[y][x] & MASKBITS) | tile | BULLBIT | BURNBIT | CONDBIT);
         return;
     }
     
     /* Handle the special crossing tiles */
-    if (tile == HROADPOWER || tile == VROADPOWER || 
-        tile == RAILHPOWERV || tile == RAILVPOWERH ||
-        tile == HRAILROAD || tile == VRAILROAD) {
-        /* These special tiles should trigger updates for surrounding tiles */
-        if (y > 0) {
+    if (IsCrossingTile(tile)) {
+        /* These special tiles should trigger updates for surrounding tiles.
+         * A crossing is never changed by a fix, so neighbouring crossings are
+         * passed over rather than bouncing the update back and forth. */
+        if (y > 0 && !IsCrossingTile(NormalizeRoad(Map[y - 1][x] & LOMASK))) {
             FixSingle(x, y - 1);
         }
-        if (x < WORLD_X - 1) {
+        if (x < WORLD_X - 1 && !IsCrossingTile(NormalizeRoad(Map[y][x + 1] & LOMASK))) {
             FixSingle(x + 1, y);
         }
-        if (y < WORLD_Y - 1) {
+        if (y < WORLD_Y - 1 && !IsCrossingTile(NormalizeRoad(Map[y + 1][x] & LOMASK))) {
             FixSingle(x, y + 1);
         }
-        if (x > 0) {
+        if (x > 0 && !IsCrossingTile(NormalizeRoad(Map[y][x - 1] & LOMASK))) {
             FixSingle(x - 1, y);
         }
         return;
@@ -2220,14 +2230,14 @@ int DoBulldozer(int mapX, int mapY) {
                tile == BRWH || tile == BRWV) {
         /* Water-related structures cost $5 */
         Spend(5);
-        Map[mapY][mapX] = RIVER; /* Convert back to water */
+        SetTile(mapX, mapY, RIVER); /* Convert back to water */
     } else if (tile == RADTILE) {
         /* Can't bulldoze radiation */
         return TOOLRESULT_FAILED;
     } else {
         /* All other tiles cost $1 */
         Spend(1);
-        Map[mapY][mapX] = DIRT;
+        SetTile(mapX, mapY, DIRT);
     }
 
     /* Fix neighboring tiles after bulldozing */
@@ -2380,7 +2390,7 @@ int DoPark(int mapX, int mapY) {
     randval = SimRandom(4);
 
     /* Set the tile to a random park tile */
-    Map[mapY][mapX] = (randval + TILE_WOODS) | BURNBIT | BULLBIT;
+    SetTile(mapX, mapY, (randval + TILE_WOODS) | BURNBIT | BULLBIT);
 
     return TOOLRESULT_OK;
 }
@@ -2410,7 +2420,7 @@ int PlaceZone(int mapX, int mapY, int baseValue, int totalCost) {
             for (dx = -1; dx <= 1; dx++) {
                 short tile = Map[mapY + dy][mapX + dx] & LOMASK;
                 if (tile != DIRT && (tile == RUBBLE || (tile >= TINYEXP && tile <= LASTTINYEXP))) {
-                    Map[mapY + dy][mapX + dx] = DIRT;
+                    SetTile(mapX + dx, mapY + dy, DIRT);
                 }
             }
         }
@@ -2425,10 +2435,10 @@ int PlaceZone(int mapX, int mapY, int baseValue, int totalCost) {
         for (dx = -1; dx <= 1; dx++) {
             if (dx == 0 && dy == 0) {
                 /* Center tile gets ZONEBIT, CONDBIT, and BULLBIT */
-                Map[mapY][mapX] = baseValue + 4 | ZONEBIT | BULLBIT | CONDBIT;
+                SetTile(mapX, mapY, baseValue + 4 | ZONEBIT | BULLBIT | CONDBIT);
             } else {
                 /* All other tiles in the zone get CONDBIT too for proper power distribution */
-                Map[mapY + dy][mapX + dx] = baseValue + index | BULLBIT | CONDBIT;
+                SetTile(mapX + dx, mapY + dy, baseValue + index | BULLBIT | CONDBIT);
             }
             index++;
         }
@@ -2499,7 +2509,7 @@ int Place4x4Building(int mapX, int mapY, int baseValue, int centerTile, int tota
             for (dx = -1; dx <= 2; dx++) {
                 short tile = Map[mapY + dy][mapX + dx] & LOMASK;
                 if (tile != DIRT && (tile == RUBBLE || (tile >= TINYEXP && tile <= LASTTINYEXP))) {
-                    Map[mapY + dy][mapX + dx] = DIRT;
+                    SetTile(mapX + dx, mapY + dy, DIRT);
                 }
             }
         }
@@ -2515,13 +2525,13 @@ int Place4x4Building(int mapX, int mapY, int baseValue, int centerTile, int tota
         for (dx = -1; dx <= 2; dx++) {
             if (dx == 0 && dy == 0) {
                 /* Center tile gets ZONEBIT */
-                Map[mapY][mapX] = centerTile | ZONEBIT | BULLBIT;
+                SetTile(mapX, mapY, centerTile | ZONEBIT | BULLBIT);
             } else {
                 /* Skip the center index (5) */
                 if (index == 5) {
                     index++;
                 }
-                Map[mapY + dy][mapX + dx] = baseValue + index | BULLBIT;
+                SetTile(mapX + dx, mapY + dy, baseValue + index | BULLBIT);
             }
             index++;
         }
@@ -2586,7 +2596,7 @@ int Place6x6Building(int mapX, int mapY, int baseValue, int centerTile, int tota
             for (dx = -2; dx <= 3; dx++) {
                 short tile = Map[mapY + dy][mapX + dx] & LOMASK;
                 if (tile != DIRT && (tile == RUBBLE || (tile >= TINYEXP && tile <= LASTTINYEXP))) {
-                    Map[mapY + dy][mapX + dx] = DIRT;
+                    SetTile(mapX + dx, mapY + dy, DIRT);
                 }
             }
         }
@@ -2602,13 +2612,13 @@ int Place6x6Building(int mapX, int mapY, int baseValue, int centerTile, int tota
         for (dx = -2; dx <= 3; dx++) {
             if (dx == 0 && dy == 0) {
                 /* Center tile gets ZONEBIT */
-                Map[mapY][mapX] = centerTile | ZONEBIT | BULLBIT;
+                SetTile(mapX, mapY, centerTile | ZONEBIT | BULLBIT);
             } else {
                 /* Skip the center index (14) */
                 if (index == 14) {
                     index++;
                 }
-                Map[mapY + dy][mapX + dx] = baseValue + index | BULLBIT;
+                SetTile(mapX + dx, mapY + dy, baseValue + index | BULLBIT);
             }
             index++;
         }
@@ -2677,11 +2687,22 @@ const char *GetZoneName(short tile) {
     return "Clear Land";
 }
 
-/* Apply the query tool - shows information about the tile */
+/* Half-size cells either side of the query point for the nearby readings */
+#define QUERY_RADIUS 4
+
+/* Text of the last query, waiting to be shown once the simulation lock is
+ * released, since a modal box would hold the simulation up */
+static char queryText[256];
+static int queryPending = 0;
+
+/* Apply the query tool - builds the information about the tile */
 int DoQuery(int mapX, int mapY) {
     short tile;
-    char message[256];
     const char *zoneName;
+    int x0, y0, x1, y1;
+    int x, y;
+    QUAD cells, developed;
+    QUAD landTotal, pollutionTotal, crimeTotal, trafficTotal;
 
     /* Check bounds */
     if (mapX < 0 || mapX >= WORLD_X || mapY < 0 || mapY >= WORLD_Y) {
@@ -2693,20 +2714,74 @@ int DoQuery(int mapX, int mapY) {
     /* Get zone name from tile */
     zoneName = GetZoneName(tile);
 
+    /* Neighbourhood readings over the half-size cells within 8 tiles,
+       clipped to the map. Land value is averaged over developed cells. */
+    x0 = (mapX >> 1) - QUERY_RADIUS;
+    y0 = (mapY >> 1) - QUERY_RADIUS;
+    x1 = (mapX >> 1) + QUERY_RADIUS;
+    y1 = (mapY >> 1) + QUERY_RADIUS;
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 > WORLD_X / 2 - 1) {
+        x1 = WORLD_X / 2 - 1;
+    }
+    if (y1 > WORLD_Y / 2 - 1) {
+        y1 = WORLD_Y / 2 - 1;
+    }
+    developed = 0;
+    landTotal = 0;
+    pollutionTotal = 0;
+    crimeTotal = 0;
+    trafficTotal = 0;
+    for (y = y0; y <= y1; y++) {
+        for (x = x0; x <= x1; x++) {
+            if (LandValueMem[y][x]) {
+                landTotal += LandValueMem[y][x];
+                developed++;
+            }
+            pollutionTotal += PollutionMem[y][x];
+            crimeTotal += CrimeMem[y][x];
+            trafficTotal += TrfDensity[y][x];
+        }
+    }
+    cells = (QUAD)(x1 - x0 + 1) * (y1 - y0 + 1);
+
     /* Prepare message */
-    wsprintf(message, "Location: %d, %d\nTile Type: %s\nHas Power: %s", mapX, mapY, zoneName,
-             (tile & POWERBIT) ? "Yes" : "No");
+    wsprintf(queryText,
+             "Location: %d, %d\nTile Type: %s\nHas Power: %s\n\n"
+             "Nearby land value: %d\nNearby pollution: %d\nNearby crime: %d\n"
+             "Nearby traffic: %d",
+             mapX, mapY, zoneName, (tile & POWERBIT) ? "Yes" : "No",
+             developed ? (int)(landTotal / developed) : 0, (int)(pollutionTotal / cells),
+             (int)(crimeTotal / cells), (int)(trafficTotal / cells));
 
-    /* Display the message box with information */
-    MessageBox(hwndMain, message, "Zone Info", MB_OK | MB_ICONINFORMATION);
+    queryPending = 1;
 
     return TOOLRESULT_OK;
 }
 
+/* Return the text of a query made since the last call, or NULL */
+const char *TakeQueryText(void) {
+    if (!queryPending) {
+        return NULL;
+    }
+    queryPending = 0;
+    return queryText;
+}
+
 /* Apply the current tool at the given coordinates */
 int ApplyTool(int mapX, int mapY) {
     int result = TOOLRESULT_FAILED;
 
+    /* Queries change nothing and need a window to answer in */
+    if (currentTool != queryState) {
+        RecordToolCommand(currentTool, mapX, mapY);
+    }
+
     switch (currentTool) {
     case bulldozerState:
         result = DoBulldozer(mapX, mapY);
@@ -2780,12 +2855,260 @@ int ApplyTool(int mapX, int mapY) {
     /* Store the result for later display */
     toolResult = result;
 
-    /* Force redraw of map */
-    InvalidateRect(hwndMain, NULL, FALSE);
+    /* Force redraw of map, unless replaying without windows */
+    if (hwndMain) {
+        InvalidateRect(hwndMain, NULL, FALSE);
+    }
 
     return result;
 }
 
+/* Strokes: roads, rails and wires laid along a dragged line or around a
+ * dragged rectangle in one go. The whole stroke is priced before anything
+ * is built, every tile is laid, and only then are the connections worked
+ * out, once for each laid tile and its neighbours. */
+
+/* Longest stroke: the outline of the whole map */
+#define STROKE_MAX (2 * (WORLD_X + WORLD_Y))
+
+static short strokeX[STROKE_MAX];
+static short strokeY[STROKE_MAX];
+static BitPlane strokeFix;
+
+/* Is this a tool that can be dragged into a stroke? */
+int IsStrokeTool(int toolType) {
+    return toolType == roadState || toolType == railState || toolType == wireState;
+}
+
+/* Keep a stroke end on the map */
+static void ClampToMap(int *x, int *y) {
+    if (*x < 0) {
+        *x = 0;
+    } else if (*x > WORLD_X - 1) {
+        *x = WORLD_X - 1;
+    }
+    if (*y < 0) {
+        *y = 0;
+    } else if (*y > WORLD_Y - 1) {
+        *y = WORLD_Y - 1;
+    }
+}
+
+/* The box with two corners at the stroke's ends */
+static void StrokeBox(int x0, int y0, int x1, int y1, int *left, int *top, int *right,
+                      int *bottom) {
+    *left = x0 < x1 ? x0 : x1;
+    *right = x0 < x1 ? x1 : x0;
+    *top = y0 < y1 ? y0 : y1;
+    *bottom = y0 < y1 ? y1 : y0;
+}
+
+/* List the tiles of a stroke, each once. A line runs across from the start
+ * and then up or down to the end; a rectangle is the outline of the box
+ * with the two ends at opposite corners. Returns the number of tiles. */
+static int BuildStroke(int x0, int y0, int x1, int y1, int shape) {
+    int left, right, top, bottom;
+    int count;
+    int step;
+    int x, y;
+
+    count = 0;
+    if (shape == STROKE_RECT) {
+        StrokeBox(x0, y0, x1, y1, &left, &top, &right, &bottom);
+
+        for (x = left; x <= right; x++) {
+            strokeX[count] = (short)x;
+            strokeY[count++] = (short)top;
+        }
+        for (y = top + 1; y <= bottom; y++) {
+            strokeX[count] = (short)right;
+            strokeY[count++] = (short)y;
+        }
+        if (bottom > top) {
+            for (x = right - 1; x >= left; x--) {
+                strokeX[count] = (short)x;
+                strokeY[count++] = (short)bottom;
+            }
+        }
+        if (right > left) {
+            for (y = bottom - 1; y > top; y--) {
+                strokeX[count] = (short)left;
+                strokeY[count++] = (short)y;
+            }
+        }
+        return count;
+    }
+
+    step = x1 >= x0 ? 1 : -1;
+    for (x = x0; x != x1 + step; x += step) {
+        strokeX[count] = (short)x;
+        strokeY[count++] = (short)y0;
+    }
+    step = y1 >= y0 ? 1 : -1;
+    for (y = y0 + step; y != y1 + step; y += step) {
+        strokeX[count] = (short)x1;
+        strokeY[count++] = (short)y;
+    }
+    return count;
+}
+
+/* What the tool would charge for one tile, as LayRoad, LayRail and LayWire
+ * price it. Returns -1 if the tile must be bulldozed first and 0 if the
+ * tool would leave it alone. */
+static int StrokeTileCost(int toolType, int x, int y) {
+    short tile;
+    int water, tiny;
+
+    tile = Map[y][x] & LOMASK;
+    water = tile == RIVER || tile == REDGE || tile == CHANNEL;
+    tiny = tile == DIRT || (tile >= TINYEXP && tile <= LASTTINYEXP);
+
+    switch (toolType) {
+    case roadState:
+        if (water) {
+            return BRIDGE_COST;
+        }
+        if (tiny || (tile >= POWERBASE && tile <= LASTPOWER)) {
+            return ROAD_COST;
+        }
+        if ((tile >= ROADBASE && tile <= LASTROAD) || (tile >= RAILBASE && tile <= LASTRAIL)) {
+            return 0;
+        }
+        return -1;
+
+    case railState:
+        if (water) {
+            return TUNNEL_COST;
+        }
+        if (tiny || (tile >= POWERBASE && tile <= LASTPOWER)) {
+            return RAIL_COST;
+        }
+        if ((tile >= ROADBASE && tile <= LASTROAD) || (tile >= RAILBASE && tile <= LASTRAIL)) {
+            return 0;
+        }
+        return -1;
+
+    case wireState:
+        if (water) {
+            return UNDERWATER_WIRE_COST;
+        }
+        if (tiny || (tile >= ROADBASE && tile <= LASTROAD) ||
+            (tile >= RAILBASE && tile <= LASTRAIL)) {
+            return WIRE_COST;
+        }
+        if (tile >= POWERBASE && tile <= LASTPOWER) {
+            return 0;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+/* Apply the current tool along a stroke from (x0, y0) to (x1, y1). Tiles
+ * that need bulldozing are skipped. Nothing is built unless the funds
+ * cover the whole stroke. */
+int ApplyToolStroke(int x0, int y0, int x1, int y1, int shape) {
+    int count;
+    int total;
+    int blocked;
+    int laid;
+    int cost;
+    int ok;
+    int left, right, top, bottom;
+    int x, y;
+    int i;
+
+    if (!IsStrokeTool(currentTool)) {
+        return TOOLRESULT_FAILED;
+    }
+
+    ClampToMap(&x0, &y0);
+    ClampToMap(&x1, &y1);
+    RecordStrokeCommand(currentTool, x0, y0, x1, y1, shape);
+
+    count = BuildStroke(x0, y0, x1, y1, shape);
+
+    /* Price the whole stroke first */
+    total = 0;
+    blocked = 0;
+    for (i = 0; i < count; i++) {
+        cost = StrokeTileCost(currentTool, strokeX[i], strokeY[i]);
+        if (cost < 0) {
+            blocked++;
+        } else {
+            total += cost;
+        }
+    }
+    if (!CheckFunds(total)) {
+        toolResult = TOOLRESULT_NO_MONEY;
+        return toolResult;
+    }
+
+    /* Lay every tile, then fix each laid tile and its neighbours once */
+    memset(strokeFix, 0, sizeof(strokeFix));
+    laid = 0;
+    for (i = 0; i < count; i++) {
+        x = strokeX[i];
+        y = strokeY[i];
+        if (StrokeTileCost(currentTool, x, y) <= 0) {
+            continue;
+        }
+
+        if (currentTool == roadState) {
+            ok = LayRoad(x, y, &Map[y][x]);
+        } else if (currentTool == railState) {
+            ok = LayRail(x, y, &Map[y][x]);
+        } else {
+            ok = LayWire(x, y, &Map[y][x]);
+        }
+        if (!ok) {
+            continue;
+        }
+
+        laid++;
+        PLANE_SET(strokeFix, x, y);
+        if (x > 0) {
+            PLANE_SET(strokeFix, x - 1, y);
+        }
+        if (x < WORLD_X - 1) {
+            PLANE_SET(strokeFix, x + 1, y);
+        }
+        if (y > 0) {
+            PLANE_SET(strokeFix, x, y - 1);
+        }
+        if (y < WORLD_Y - 1) {
+            PLANE_SET(strokeFix, x, y + 1);
+        }
+    }
+
+    /* The stroke's box with a tile's margin holds every tile to fix */
+    StrokeBox(x0, y0, x1, y1, &left, &top, &right, &bottom);
+    left = left > 0 ? left - 1 : 0;
+    top = top > 0 ? top - 1 : 0;
+    right = right < WORLD_X - 1 ? right + 1 : WORLD_X - 1;
+    bottom = bottom < WORLD_Y - 1 ? bottom + 1 : WORLD_Y - 1;
+
+    if (laid > 0) {
+        for (y = top; y <= bottom; y++) {
+            for (x = left; x <= right; x++) {
+                if (PLANE_TEST(strokeFix, x, y)) {
+                    FixSingle(x, y);
+                }
+            }
+        }
+        toolResult = TOOLRESULT_OK;
+    } else {
+        toolResult = blocked ? TOOLRESULT_NEED_BULLDOZE : TOOLRESULT_FAILED;
+    }
+
+    /* Repaint the stroke and its neighbours, unless replaying without windows */
+    if (hwndMain && laid > 0) {
+        InvalidateMapTiles(left, top, right, bottom);
+    }
+
+    return toolResult;
+}
+
 /* Get the current tool */
 int GetCurrentTool(void) {
     return currentTool;
@@ -2912,6 +3235,50 @@ void DrawToolHover(HDC hdc, int mapX, int mapY, int toolType, int xOffset, int y
     lastMouseMapY = mapY;
 }
 
+/* Outline a box of tiles, corners included, with the current pen */
+static void OutlineTiles(HDC hdc, int left, int top, int right, int bottom, int xOffset,
+                         int yOffset) {
+    Rectangle(hdc, left * TILE_SIZE - xOffset, top * TILE_SIZE - yOffset,
+              (right + 1) * TILE_SIZE - xOffset, (bottom + 1) * TILE_SIZE - yOffset);
+}
+
+/* Draw the path a stroke being dragged would take */
+void DrawToolStroke(HDC hdc, int x0, int y0, int x1, int y1, int shape, int xOffset,
+                    int yOffset) {
+    int left, top, right, bottom;
+    HPEN hPen;
+    HPEN hOldPen;
+    HBRUSH hOldBrush;
+
+    ClampToMap(&x0, &y0);
+    ClampToMap(&x1, &y1);
+
+    hPen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
+    if (!hPen) {
+        return;
+    }
+
+    hOldPen = SelectObject(hdc, hPen);
+    hOldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+
+    if (shape == STROKE_RECT) {
+        StrokeBox(x0, y0, x1, y1, &left, &top, &right, &bottom);
+        OutlineTiles(hdc, left, top, right, bottom, xOffset, yOffset);
+    } else {
+        /* Across along the start row, then along the end column */
+        StrokeBox(x0, y0, x1, y0, &left, &top, &right, &bottom);
+        OutlineTiles(hdc, left, top, right, bottom, xOffset, yOffset);
+        if (y1 != y0) {
+            StrokeBox(x1, y0, x1, y1, &left, &top, &right, &bottom);
+            OutlineTiles(hdc, left, top, right, bottom, xOffset, yOffset);
+        }
+    }
+
+    SelectObject(hdc, hOldPen);
+    SelectObject(hdc, hOldBrush);
+    DeleteObject(hPen);
+}
+
 /* Convert screen coordinates to map coordinates */
 void ScreenToMap(int screenX, int screenY, int *mapX, int *mapY, int xOffset, int yOffset) {
     /*
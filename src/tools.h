@@ -40,6 +40,10 @@ extern int isToolActive;
 #define TOOL_SIZE_4X4           4  /* 4x4 building tools (stadium, power plant, etc.) */
 #define TOOL_SIZE_6X6           6  /* 6x6 building tools (airport) */
 
+/* Stroke shapes for ApplyToolStroke */
+#define STROKE_LINE             0  /* Across, then up or down */
+#define STROKE_RECT             1  /* Outline of the box between the ends */
+
 /* Functions for tool management */
 void CreateToolbar(HWND hwndParent, int x, int y, int width, int height);
 void SelectTool(int toolType);
@@ -54,6 +58,10 @@ void CleanupToolbarBitmaps(void);
 void ScreenToMap(int screenX, int screenY, int *mapX, int *mapY, int xOffset, int yOffset);
 int HandleToolMouse(int mouseX, int mouseY, int xOffset, int yOffset);
 void DrawToolHover(HDC hdc, int mapX, int mapY, int toolType, int xOffset, int yOffset);
+int IsStrokeTool(int toolType);
+int ApplyToolStroke(int x0, int y0, int x1, int y1, int shape);
+void DrawToolStroke(HDC hdc, int x0, int y0, int x1, int y1, int shape, int xOffset,
+                    int yOffset);
 void UpdateToolbar(void);
 
 /* Individual tool functions */
@@ -73,5 +81,6 @@ int DoStadium(int mapX, int mapY);
 int DoSeaport(int mapX, int mapY);
 int DoAirport(int mapX, int mapY);
 int DoQuery(int mapX, int mapY);
+const char *TakeQueryText(void);
 
 #endif /* _TOOLS_H */
\ No newline at end of file
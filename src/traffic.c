@@ -336,10 +336,10 @@ void DecTrafficMap(void) {
                                     /* If this is a heavy traffic tile, convert back to normal road
                                      */
                                     if (tile >= HTRFBASE) {
-                                        Map[mapY][mapX] = (tile - HTRFBASE + ROADBASE) & ~ANIMBIT;
+                                        SetTile(mapX, mapY, (tile - HTRFBASE + ROADBASE) & ~ANIMBIT);
                                     } else {
                                         /* Otherwise just clear animation bit */
-                                        Map[mapY][mapX] &= ~ANIMBIT;
+                                        SetTile(mapX, mapY, Map[mapY][mapX] & ~ANIMBIT);
                                     }
                                 }
                             }
@@ -385,17 +385,17 @@ void CalcTrafficAverage(void) {
                                 /* Heavy traffic */
                                 if (TrfDensity[y][x] > 40) {
                                     /* Set animation bit and add HTRFBASE offset */
-                                    Map[mapY][mapX] = (tile - ROADBASE + HTRFBASE) | ANIMBIT;
+                                    SetTile(mapX, mapY, (tile - ROADBASE + HTRFBASE) | ANIMBIT);
                                 }
                                 /* Light traffic - randomly animate some tiles */
                                 else if (TrfDensity[y][x] > 10 && ((Fcycle & 3) == 0)) {
                                     /* Set animation bit but keep at ROADBASE */
-                                    Map[mapY][mapX] |= ANIMBIT;
+                                    SetTile(mapX, mapY, Map[mapY][mapX] | ANIMBIT);
                                 }
                                 /* No traffic or very light - clear animation */
                                 else {
                                     /* Clear animation bit */
-                                    Map[mapY][mapX] &= ~ANIMBIT;
+                                    SetTile(mapX, mapY, Map[mapY][mapX] & ~ANIMBIT);
                                 }
                             }
                         }
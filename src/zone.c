@@ -29,6 +29,13 @@
 static int RZPop; /* Residential zone population */
 static int CZPop; /* Commercial zone population */
 static int IZPop; /* Industrial zone population */
+
+/* Zone populations by tile number, built from the formulas below the first
+   time one is asked for */
+static short ResPopTable[TILE_COUNT];
+static short ComPopTable[TILE_COUNT];
+static short IndPopTable[TILE_COUNT];
+static int zonePopTablesReady = 0;
 /* ComRate is declared in simulation.h as quarter size */
 
 /* Forward declarations */
@@ -50,7 +57,7 @@ static void DoComIn(int pop, int x, int y);
 static void DoIndIn(int pop, int x, int y);
 
 /* Calculate population in a residential zone */
-int calcResPop(int zone) {
+static int ResPopFormula(int zone) {
     int pop;
 
     /* Check if in residential range */
@@ -94,7 +101,7 @@ int calcResPop(int zone) {
 }
 
 /* Calculate population in a commercial zone */
-int calcComPop(int zone) {
+static int ComPopFormula(int zone) {
     int pop;
 
     /* Check if in commercial range */
@@ -131,7 +138,7 @@ int calcComPop(int zone) {
 }
 
 /* Calculate population in an industrial zone */
-int calcIndPop(int zone) {
+static int IndPopFormula(int zone) {
     int pop;
 
     /* Check if in industrial range */
@@ -171,6 +178,51 @@ int calcIndPop(int zone) {
 
     return 0;
 }
+
+/* Work out every tile's population once */
+static void BuildZonePopTables(void) {
+    int zone;
+
+    for (zone = 0; zone < TILE_COUNT; zone++) {
+        ResPopTable[zone] = (short)ResPopFormula(zone);
+        ComPopTable[zone] = (short)ComPopFormula(zone);
+        IndPopTable[zone] = (short)IndPopFormula(zone);
+    }
+    zonePopTablesReady = 1;
+}
+
+/* Residential population of a zone centre tile, 0 for any other tile */
+int calcResPop(int zone) {
+    if (zone < 0 || zone >= TILE_COUNT) {
+        return 0;
+    }
+    if (!zonePopTablesReady) {
+        BuildZonePopTables();
+    }
+    return ResPopTable[zone];
+}
+
+/* Commercial population of a zone centre tile, 0 for any other tile */
+int calcComPop(int zone) {
+    if (zone < 0 || zone >= TILE_COUNT) {
+        return 0;
+    }
+    if (!zonePopTablesReady) {
+        BuildZonePopTables();
+    }
+    return ComPopTable[zone];
+}
+
+/* Industrial population of a zone centre tile, 0 for any other tile */
+int calcIndPop(int zone) {
+    if (zone < 0 || zone >= TILE_COUNT) {
+        return 0;
+    }
+    if (!zonePopTablesReady) {
+        BuildZonePopTables();
+    }
+    return IndPopTable[zone];
+}
 static void IncROG(int x, int y);
 static void DoResOut(int pop, int value, int x, int y);
 static void DoComOut(int pop, int x, int y);
@@ -184,7 +236,7 @@ static void SetZPower(int x, int y);
 
 /* Random between 0 and range-1 */
 static int ZoneRandom(int range) {
-    return rand() % range;
+    return SimRandom(range);
 }
 
 /* Main zone processing function - based on original Micropolis code */
@@ -611,7 +663,7 @@ static void DoResIn(int pop, int value, int x, int y) {
         /* Low-value residential building: 0, 1, 2 */
         /* Increased chance of growth */
         if (ZoneRandom(3) || (RValve > 300 && ZoneRandom(2))) {
-            Map[y][x] = (Map[y][x] & ALLBITS) | (RESBASE + base + growthRate);
+            SetTile(x, y, (Map[y][x] & ALLBITS) | (RESBASE + base + growthRate));
             IncROG(x, y);
 
             /* Debug the growth */
@@ -634,7 +686,7 @@ static void DoResIn(int pop, int value, int x, int y) {
             deltaValue = 2;
         }
 
-        Map[y][x] = (Map[y][x] & ALLBITS) | (RESBASE + base + deltaValue);
+        SetTile(x, y, (Map[y][x] & ALLBITS) | (RESBASE + base + deltaValue));
 
         /* Increased chance of growth */
         if (ZoneRandom(12) < 3 || (RValve > 400 && ZoneRandom(10) < 3)) {
@@ -650,7 +702,7 @@ static void DoResIn(int pop, int value, int x, int y) {
         }
     } else {
         /* Big residential building: 6, 7, 8 */
-        Map[y][x] = (Map[y][x] & ALLBITS) | (RESBASE + base);
+        SetTile(x, y, (Map[y][x] & ALLBITS) | (RESBASE + base));
 
         /* Increased chance of growth */
         if ((value > 120 && ZoneRandom(8) < 2) || (RValve > 500 && ZoneRandom(10) < 3)) {
@@ -753,10 +805,10 @@ static void DoResOut(int pop, int value, int x, int y) {
 
     if (pop > 16) {
         /* Turn to small house */
-        Map[y][x] = (Map[y][x] & ALLBITS) | (RESBASE + base - 1);
+        SetTile(x, y, (Map[y][x] & ALLBITS) | (RESBASE + base - 1));
     } else if ((base > 0) && (ZoneRandom(4) == 0)) {
         /* Gradually decay */
-        Map[y][x] = (Map[y][x] & ALLBITS) | (RESBASE + base - 1);
+        SetTile(x, y, (Map[y][x] & ALLBITS) | (RESBASE + base - 1));
     }
 
     /* Check for complete ruin */
@@ -770,7 +822,7 @@ static void DoResOut(int pop, int value, int x, int y) {
 
             z2 = Map[y][x] & LOMASK;
             if ((z2 < COMBASE) || (z2 > LASTIND)) {
-                Map[y][x] = z1;
+                SetTile(x, y, z1);
             }
         }
     }
@@ -788,7 +840,7 @@ static void DoComOut(int pop, int x, int y) {
 
     if ((base > 0) && (ZoneRandom(8) == 0)) {
         /* Gradually decay */
-        Map[y][x] = (Map[y][x] & ALLBITS) | (COMBASE + base - 1);
+        SetTile(x, y, (Map[y][x] & ALLBITS) | (COMBASE + base - 1));
     }
 }
 
@@ -804,7 +856,7 @@ static void DoIndOut(int pop, int x, int y) {
 
     if ((base > 0) && (ZoneRandom(8) == 0)) {
         /* Gradually decay */
-        Map[y][x] = (Map[y][x] & ALLBITS) | (INDBASE + base - 1);
+        SetTile(x, y, (Map[y][x] & ALLBITS) | (INDBASE + base - 1));
     }
 }
 
@@ -900,7 +952,7 @@ static int ZonePlop(int xpos, int ypos, int base) {
     }
 
     /* Update zone center with the zone bit and power */
-    Map[ypos][xpos] = (Map[ypos][xpos] & MASKBITS) | BNCNBIT | base | CONDBIT | BURNBIT | BULLBIT;
+    SetTile(xpos, ypos, (Map[ypos][xpos] & MASKBITS) | BNCNBIT | base | CONDBIT | BURNBIT | BULLBIT);
 
     /* Set the 3x3 zone around center */
     for (dy = -1; dy <= 1; dy++) {
@@ -915,8 +967,8 @@ static int ZonePlop(int xpos, int ypos, int base) {
 
                     if ((z < ROADS) || (z > LASTRAIL)) {
                         if (Map[y][x] & BULLBIT) {
-                            Map[y][x] = (Map[y][x] & MASKBITS) | (base + BSIZE + ZoneRandom(2)) |
-                                        CONDBIT | BURNBIT | BULLBIT;
+                            SetTile(x, y, (Map[y][x] & MASKBITS) | (base + BSIZE + ZoneRandom(2)) |
+                                          CONDBIT | BURNBIT | BULLBIT);
                         }
                     }
                 }
@@ -975,7 +1027,7 @@ static int EvalRes(int x, int y) {
 static int EvalCom(int x, int y) {
     int value;
 
-    value = ComRate[y >> 1][x >> 1];
+    value = ComRate[x >> 2][y >> 2];
 
     /* Reduced minimum requirement */
     if (value < 1) {
@@ -1024,31 +1076,7 @@ static int EvalInd(int x, int y) {
 
 /* Count population of free houses */
 static int DoFreePop(int x, int y) {
-    int count;
-    int xx;
-    int yy;
-    int xxx;
-    int yyy;
-    short z;
-
-    count = 0;
-
-    for (yy = -1; yy <= 1; yy++) {
-        for (xx = -1; xx <= 1; xx++) {
-            xxx = x + xx;
-            yyy = y + yy;
-
-            if (xxx >= 0 && xxx < WORLD_X && yyy >= 0 && yyy < WORLD_Y) {
-                z = Map[yyy][xxx] & LOMASK;
-
-                if (z >= LHTHR && z <= HHTHR) {
-                    count++;
-                }
-            }
-        }
-    }
-
-    return count;
+    return CountPlaneBox(TilePlanes[TILE_PLANE_HOUSE], x - 1, y - 1, x + 1, y + 1);
 }
 
 /* Set zone power status - simplified for reliability */
@@ -1062,14 +1090,14 @@ static void SetZPower(int x, int y) {
 
     if (z == NUCLEAR || z == POWERPLANT) {
         /* Power plants are always powered */
-        Map[y][x] |= POWERBIT;
+        SetTile(x, y, Map[y][x] | POWERBIT);
         PwrdZCnt++;
         return;
     }
 
     /* Check if already powered according to PowerMap */
-    if (PowerMap[y][x] == 1) {
-        Map[y][x] |= POWERBIT;
+    if (PLANE_TEST(PowerMap, x, y)) {
+        SetTile(x, y, Map[y][x] | POWERBIT);
         powered = 1;
     }
     /* If not already powered, check surrounding tiles */
@@ -1100,11 +1128,11 @@ static void SetZPower(int x, int y) {
 
         /* Update the power bit based on our check */
         if (powered) {
-            Map[y][x] |= POWERBIT;
-            PowerMap[y][x] = 1;
+            SetTile(x, y, Map[y][x] | POWERBIT);
+            PLANE_SET(PowerMap, x, y);
         } else {
-            Map[y][x] &= ~POWERBIT;
-            PowerMap[y][x] = 0;
+            SetTile(x, y, Map[y][x] & ~POWERBIT);
+            PLANE_CLEAR(PowerMap, x, y);
         }
     }
 